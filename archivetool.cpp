@@ -0,0 +1,126 @@
+#include "gamearchive.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+static void usage() {
+    cout << "Usage: archivetool convert <gamelog.txt> <archive>" << endl;
+    cout << "       archivetool dump <archive> [first game, negative counts from the end] [count]" << endl;
+    cout << "       archivetool info <archive>" << endl;
+}
+
+/**
+ * Appends the games of a text log written by the old Server::saveLog, one "player move time" line per
+ * ply with a blank line after each game
+ */
+static int convert(const string &logPath, const string &archivePath) {
+    ifstream inputFile(logPath.c_str());
+    if (!inputFile.is_open()) {
+        cout << "Couldn't open file: " << logPath << endl;
+        return 1;
+    }
+    GameArchiveWriter writer;
+    if (!writer.open(archivePath)) {
+        return 1;
+    }
+    long long converted = 0;
+    ArchivedGame game;
+    string line;
+    while (true) {
+        bool more = (bool) getline(inputFile, line);
+        istringstream lineStream(line);
+        char player;
+        string move;
+        double time;
+        if (more && lineStream >> player >> move >> time) {
+            if (game.moves.empty()) {
+                game.startPlayer = player == 'X' ? ReversiBoard::BLACK : ReversiBoard::WHITE;
+            }
+            game.moves.push_back(parseSquare(move));
+            game.times.push_back(time);
+            continue;
+        }
+        if (!game.moves.empty()) {
+            game.computeDiscs();
+            writer.append(game);
+            converted++;
+            game = ArchivedGame();
+        }
+        if (!more) {
+            break;
+        }
+    }
+    cout << "Converted " << converted << " games, the archive now holds " << writer.size() << endl;
+    return writer.close() ? 0 : 1;
+}
+
+static int dump(const string &archivePath, long long first, long long count) {
+    GameArchiveReader reader;
+    if (!reader.open(archivePath)) {
+        return 1;
+    }
+    if (first < 0) {
+        first += reader.size();
+    }
+    ArchivedGame game;
+    for (long long i = max(0LL, first); i < reader.size() && i < first + count; i++) {
+        if (!reader.read(i, game)) {
+            cout << "Game " << i << " is corrupt" << endl;
+            continue;
+        }
+        int player = game.startPlayer;
+        for (size_t ply = 0; ply < game.moves.size(); ply++) {
+            double time = ply < game.times.size() ? game.times[ply] : 0.0;
+            cout << (player == ReversiBoard::BLACK ? 'X' : 'O') << ' ' << squareToString(game.moves[ply]) << ' '
+                 << time << endl;
+            player = 1 - player;
+        }
+        cout << endl;
+    }
+    return 0;
+}
+
+static int info(const string &archivePath) {
+    GameArchiveReader reader;
+    if (!reader.open(archivePath)) {
+        return 1;
+    }
+    long long corrupt = 0, plies = 0;
+    ArchivedGame game;
+    for (long long i = 0; i < reader.size(); i++) {
+        if (reader.read(i, game)) {
+            plies += game.moves.size();
+        } else {
+            corrupt++;
+        }
+    }
+    cout << "Games\t" << reader.size() << endl;
+    cout << "Plies\t" << plies << endl;
+    cout << "Blocks\t" << reader.blockOffsets().size() << endl;
+    cout << "Bytes\t" << reader.endOffset() << endl;
+    cout << "Corrupt\t" << corrupt << endl;
+    return corrupt == 0 ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        usage();
+        return 1;
+    }
+    string command(argv[1]);
+    if (command == "convert" && argc == 4) {
+        return convert(argv[2], argv[3]);
+    } else if (command == "dump") {
+        long long first = argc > 3 ? atoll(argv[3]) : 0;
+        long long count = argc > 4 ? atoll(argv[4]) : (argc > 3 ? 1 : -1ULL >> 1);
+        return dump(argv[2], first, count);
+    } else if (command == "info") {
+        return info(argv[2]);
+    }
+    usage();
+    return 1;
+}
@@ -0,0 +1,256 @@
+#include "batch.h"
+#include "interleavedsearch.h"
+#include "profiler.h"
+#include "reversicompetitionagent.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static const int DEFAULT_BATCH_DEPTH = 4;
+
+BatchOptions::BatchOptions(): threads(max(1, (int) thread::hardware_concurrency())), depth(0), timeLimit(0.0),
+        interleave(1), tableBits(20) {
+    engine.name = "batch";
+}
+
+bool BatchOptions::parse(const string &key, const string &value) {
+    if (key == "threads") {
+        threads = max(1, atoi(value.c_str()));
+    } else if (key == "depth") {
+        depth = max(1, atoi(value.c_str()));
+    } else if (key == "time") {
+        timeLimit = atof(value.c_str());
+    } else if (key == "interleave") {
+        interleave = max(1, atoi(value.c_str()));
+    } else if (key == "table") {
+        tableBits = min(30, max(10, atoi(value.c_str())));
+    } else if (key == "input") {
+        inputPath = value;
+    } else if (key == "output") {
+        outputPath = value;
+    } else if (key == "engine") {
+        return EngineConfig::parseAlphaBeta(value, engine);
+    } else {
+        cout << "Unknown batch option: " << key << endl;
+        return false;
+    }
+    return true;
+}
+
+BatchAnalyser::BatchAnalyser(const BatchOptions &options, ostream &output): options(options), output(output),
+        inputDone(false), nextToWrite(0), window(options.threads * max(64LL, 2LL * options.interleave)) {
+}
+
+long long BatchAnalyser::run(istream &input) {
+    vector<thread> workers;
+    for (int i = 0; i < options.threads; i++) {
+        workers.push_back(thread(options.interleave > 1 ? &BatchAnalyser::interleavedWorker : &BatchAnalyser::worker,
+                                 this));
+    }
+
+    long long index = 0;
+    string line;
+    while (getline(input, line)) {
+        if (line.empty() || line[0] == '#' || line.find_first_not_of(" \t\r") == string::npos) {
+            continue;
+        }
+        unique_lock<mutex> lock(queueMutex);
+        spaceAvailable.wait(lock, [this, index] { return index - nextToWrite < window; });
+        jobs.push_back(make_pair(index++, line));
+        jobAvailable.notify_one();
+    }
+    {
+        lock_guard<mutex> lock(queueMutex);
+        inputDone = true;
+    }
+    jobAvailable.notify_all();
+
+    for (thread &worker: workers) {
+        worker.join();
+    }
+    output.flush();
+    return index;
+}
+
+void BatchAnalyser::worker() {
+    while (true) {
+        pair<long long, string> job;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            jobAvailable.wait(lock, [this] { return !jobs.empty() || inputDone; });
+            if (jobs.empty()) {
+                return;
+            }
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        Position position;
+        string result;
+        if (Position::parse(job.second, position)) {
+            result = analyse(position, options);
+        } else {
+            result = "invalid " + job.second;
+        }
+        complete(job.first, result);
+    }
+}
+
+void BatchAnalyser::interleavedWorker() {
+    TranspositionTable table((size_t) 1 << options.tableBits);
+    EngineConfig config = options.engine;
+    config.depth = options.depth;
+    InterleavedSearch search(config, table, options.interleave);
+    map<long long, Position> inFlight;
+    while (true) {
+        vector<pair<long long, string> > invalid;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            // Only a thread with nothing to search waits for input
+            if (search.inFlight() == 0) {
+                jobAvailable.wait(lock, [this] { return !jobs.empty() || inputDone; });
+            }
+            while (search.inFlight() < search.width() && !jobs.empty()) {
+                pair<long long, string> job = jobs.front();
+                jobs.pop_front();
+                Position position;
+                if (Position::parse(job.second, position)) {
+                    search.add(job.first, position);
+                    inFlight[job.first] = position;
+                } else {
+                    invalid.push_back(make_pair(job.first, "invalid " + job.second));
+                }
+            }
+        }
+        for (const pair<long long, string> &result: invalid) {
+            complete(result.first, result.second);
+        }
+
+        long long index;
+        SearchInfo info;
+        if (search.next(index, info)) {
+            complete(index, resultLine(inFlight[index], info.move, info.value, info.depth, info.nodes,
+                                       info.seconds * 1e3));
+            inFlight.erase(index);
+        } else if (invalid.empty()) {
+            lock_guard<mutex> lock(queueMutex);
+            if (jobs.empty() && inputDone) {
+                return;
+            }
+        }
+    }
+}
+
+void BatchAnalyser::complete(long long index, const string &result) {
+    lock_guard<mutex> lock(queueMutex);
+    finished[index] = result;
+    // Write out the run of consecutive results that is now complete
+    map<long long, string>::iterator next;
+    bool wrote = false;
+    while ((next = finished.find(nextToWrite)) != finished.end()) {
+        output << next->second << '\n';
+        finished.erase(next);
+        nextToWrite++;
+        wrote = true;
+    }
+    if (wrote) {
+        output.flush();
+        spaceAvailable.notify_one();
+    }
+}
+
+string BatchAnalyser::analyse(const Position &position, const BatchOptions &options) {
+    chrono::time_point<chrono::steady_clock> start = chrono::steady_clock::now();
+    ReversiBoard board = position.board;
+    ullint moves = board.legalMoves(position.player);
+    int empties = popCount(board.blankBoard());
+
+    Node node(0.0, SQUARE_PASS);
+    int depthReached = 0;
+    long long nodes = 0;
+    if (moves) {
+        EngineConfig config = options.engine;
+        int firstDepth = options.timeLimit > 0.0 ? 1 : options.depth;
+        int lastDepth = EngineConfig::lastDepth(options.depth, empties);
+        double previousSeconds = 0.0, lastSeconds = 0.0;
+        for (int depth = min(firstDepth, lastDepth); depth <= lastDepth; depth++) {
+            chrono::time_point<chrono::steady_clock> iterationStart = chrono::steady_clock::now();
+            config.depth = depth;
+            ReversiCompetitionAgent agent(board, position.player, config);
+            node = agent.search();
+            nodes += agent.nodes();
+            depthReached = depth;
+
+            previousSeconds = lastSeconds;
+            lastSeconds = chrono::duration<double>(chrono::steady_clock::now() - iterationStart).count();
+            double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            // Each iteration costs about as much more than the last as the last did over the one before
+            double growth = previousSeconds > 0.0 ? max(2.0, lastSeconds / previousSeconds) : 4.0;
+            if (options.timeLimit > 0.0 && elapsed + lastSeconds * growth > options.timeLimit) {
+                break;
+            }
+        }
+    }
+
+    double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return resultLine(position, node.move, node.value, depthReached, nodes, milliseconds);
+}
+
+string BatchAnalyser::resultLine(const Position &position, Square move, double value, int depth, long long nodes,
+                                 double milliseconds) {
+    ostringstream ss;
+    ss << position.toString() << ' ' << squareToString(move) << ' ' << value << ' ' << depth << ' ' << nodes << ' '
+       << milliseconds;
+    return ss.str();
+}
+
+int runBatch(int argc, char *argv[]) {
+    BatchOptions options;
+    for (int i = 0; i < argc; i++) {
+        string argument(argv[i]);
+        size_t separator = argument.find('=');
+        if (separator == string::npos) {
+            cout << "Expected key=value, got: " << argument << endl;
+            return 1;
+        }
+        if (!options.parse(argument.substr(0, separator), argument.substr(separator + 1))) {
+            return 1;
+        }
+    }
+    if (options.interleave > 1 && options.timeLimit > 0.0) {
+        cout << "interleave needs a fixed depth, not a time limit" << endl;
+        return 1;
+    }
+    if (options.depth == 0) {
+        // Under a time limit the depth only caps the iterations
+        options.depth = options.timeLimit > 0.0 ? NO_OF_SQUARES : DEFAULT_BATCH_DEPTH;
+    }
+
+    ifstream inputFile;
+    ofstream outputFile;
+    if (!options.inputPath.empty()) {
+        inputFile.open(options.inputPath.c_str());
+        if (!inputFile.is_open()) {
+            cout << "Couldn't open file: " << options.inputPath << endl;
+            return 1;
+        }
+    }
+    if (!options.outputPath.empty()) {
+        outputFile.open(options.outputPath.c_str());
+        if (!outputFile.is_open()) {
+            cout << "Couldn't open file: " << options.outputPath << endl;
+            return 1;
+        }
+    }
+    BatchAnalyser analyser(options, options.outputPath.empty() ? cout : outputFile);
+    analyser.run(options.inputPath.empty() ? cin : inputFile);
+    PROFILE_REPORT(cerr);
+    return 0;
+}
@@ -0,0 +1,91 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "engineconfig.h"
+#include "position.h"
+
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+
+using namespace std;
+
+/**
+ * Options of "agent batch key=value ..."
+ */
+class BatchOptions {
+public:
+    EngineConfig engine;
+    int threads;
+    // Fixed search depth, or the deepest iteration when searching under a time limit. 0 picks 4 without
+    // a time limit and no cap with one.
+    int depth;
+    // Seconds per position, 0 searches every position to depth
+    double timeLimit;
+    // Fixed depth only: positions each thread keeps in flight with InterleavedSearch, 1 for the plain search
+    int interleave;
+    // log2 of the transposition table entries of each thread when interleaving
+    int tableBits;
+    string inputPath;
+    string outputPath;
+
+    BatchOptions();
+
+    bool parse(const string &key, const string &value);
+};
+
+/**
+ * Analyses a stream of positions on a pool of worker threads. Workers take the next position as they
+ * become free, so expensive positions do not hold up the others, and results are written in input
+ * order as soon as every earlier position is done.
+ */
+class BatchAnalyser {
+public:
+    BatchAnalyser(const BatchOptions &options, ostream &output);
+
+    /**
+     * Reads positions in the Position::parse format, one per line, until the end of input.
+     * Blank lines and # comments are skipped. Returns the number of positions analysed.
+     */
+    long long run(istream &input);
+
+    /**
+     * One result line: the position, best move, value, depth reached, nodes and milliseconds
+     */
+    static string analyse(const Position &position, const BatchOptions &options);
+
+    static string resultLine(const Position &position, Square move, double value, int depth, long long nodes,
+                             double milliseconds);
+
+private:
+    const BatchOptions &options;
+    ostream &output;
+
+    mutex queueMutex;
+    condition_variable jobAvailable;
+    condition_variable spaceAvailable;
+    deque<pair<long long, string> > jobs;
+    bool inputDone;
+    // Results that finished ahead of an earlier position
+    map<long long, string> finished;
+    long long nextToWrite;
+    // Positions read but not yet written are capped so a slow position cannot grow the buffer without bound
+    long long window;
+
+    void worker();
+
+    // worker() for interleave > 1
+    void interleavedWorker();
+
+    void complete(long long index, const string &result);
+};
+
+/**
+ * Entry point for "agent batch key=value ...", returns the process exit code
+ */
+int runBatch(int argc, char *argv[]);
+
+#endif // BATCH_H
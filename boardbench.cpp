@@ -0,0 +1,414 @@
+#include "boardfeatures.h"
+#include "position.h"
+#include "reversicommon.h"
+#include "transpositiontable.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace reversi;
+using namespace std;
+
+// A sample repeats the corpus until it has taken at least this long, so timer resolution does not matter
+static const double MIN_SAMPLE_SECONDS = 0.002;
+
+/**
+ * Options of "boardbench key=value ..."
+ */
+class BenchOptions {
+public:
+    // Position::parse lines; without a file the corpus comes from random games
+    string positionsPath;
+    int positions;
+    int samples;
+    int warmup;
+    // Only primitives whose name contains this
+    string filter;
+    // Results as tab separated values, for scripts and for baseline=
+    string reportPath;
+    // An earlier report to compare with, and the median slowdown that counts as a regression
+    string baselinePath;
+    double tolerance;
+
+    BenchOptions(): positions(4096), samples(25), warmup(3), tolerance(0.10) {
+    }
+
+    bool parse(const string &key, const string &value) {
+        if (key == "positions") {
+            if (atoi(value.c_str()) > 0) {
+                positions = atoi(value.c_str());
+            } else {
+                positionsPath = value;
+            }
+        } else if (key == "samples") {
+            samples = max(1, atoi(value.c_str()));
+        } else if (key == "warmup") {
+            warmup = max(0, atoi(value.c_str()));
+        } else if (key == "filter") {
+            filter = value;
+        } else if (key == "report") {
+            reportPath = value;
+        } else if (key == "baseline") {
+            baselinePath = value;
+        } else if (key == "tolerance") {
+            tolerance = atof(value.c_str());
+        } else {
+            cout << "Unknown boardbench option: " << key << endl;
+            return false;
+        }
+        return true;
+    }
+};
+
+/**
+ * The corpus in both representations. Grids are played on and taken back during the make/unmake
+ * benchmark, so every pass sees the same positions.
+ */
+class Corpus {
+public:
+    vector<Position> positions;
+    vector<vector<vector<char> > > grids;
+    vector<char> gridPlayers;
+
+    void add(const Position &position) {
+        positions.push_back(position);
+        string text = position.toString();
+        vector<vector<char> > grid(BOARD_SIZE, vector<char>(BOARD_SIZE));
+        for (int square = 0; square < NO_OF_SQUARES; square++) {
+            grid[squareRow(square)][squareColumn(square)] = text[square];
+        }
+        grids.push_back(grid);
+        gridPlayers.push_back(position.player == ReversiBoard::BLACK ? 'X' : 'O');
+    }
+
+    size_t size() const {
+        return positions.size();
+    }
+};
+
+class Result {
+public:
+    string backend;
+    string primitive;
+    // Nanoseconds per call over the samples
+    double median;
+    double p10;
+    double p90;
+    double min;
+    // Calls per pass over the corpus
+    long long calls;
+};
+
+static double percentile(const vector<double> &sorted, double fraction) {
+    double index = fraction * (sorted.size() - 1);
+    size_t below = (size_t) index;
+    size_t above = min(below + 1, sorted.size() - 1);
+    return sorted[below] + (sorted[above] - sorted[below]) * (index - below);
+}
+
+// Results fold into this so the compiler cannot drop the calls
+static ullint sink = 0;
+
+/**
+ * Times pass, which runs the primitive over the whole corpus and returns the number of calls it made
+ */
+template <typename Pass>
+static void bench(const BenchOptions &options, const string &backend, const string &primitive, Pass pass,
+                  vector<Result> &results) {
+    if (!options.filter.empty() && primitive.find(options.filter) == string::npos) {
+        return;
+    }
+    // The warm-up passes also find how many passes make a sample long enough to time
+    long long calls = 0;
+    int repeat = 1;
+    for (int i = 0; i < max(1, options.warmup); i++) {
+        chrono::time_point<chrono::steady_clock> start = chrono::steady_clock::now();
+        for (int r = 0; r < repeat; r++) {
+            calls = pass();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        while (seconds * 2 < MIN_SAMPLE_SECONDS) {
+            repeat *= 2;
+            seconds *= 2;
+        }
+    }
+
+    vector<double> samples;
+    for (int i = 0; i < options.samples; i++) {
+        chrono::time_point<chrono::steady_clock> start = chrono::steady_clock::now();
+        for (int r = 0; r < repeat; r++) {
+            pass();
+        }
+        chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+        samples.push_back(elapsed.count() / ((double) repeat * max(1LL, calls)));
+    }
+    sort(samples.begin(), samples.end());
+
+    Result result;
+    result.backend = backend;
+    result.primitive = primitive;
+    result.median = percentile(samples, 0.5);
+    result.p10 = percentile(samples, 0.1);
+    result.p90 = percentile(samples, 0.9);
+    result.min = samples.front();
+    result.calls = calls;
+    results.push_back(result);
+    cout << setw(10) << left << backend << setw(18) << primitive << right << fixed << setprecision(2)
+         << setw(10) << result.median << setw(10) << result.p10 << setw(10) << result.p90 << setw(10) << result.min
+         << setw(10) << calls << endl;
+}
+
+static void benchBitboard(const BenchOptions &options, Corpus &corpus, vector<Result> &results) {
+    vector<Position> &positions = corpus.positions;
+    bench(options, "bitboard", "legalMoves", [&]() {
+        for (Position &position: positions) {
+            sink += position.board.legalMoves(position.player);
+        }
+        return (long long) positions.size();
+    }, results);
+    bench(options, "bitboard", "flips", [&]() {
+        long long calls = 0;
+        for (Position &position: positions) {
+            ullint moves = position.board.legalMoves(position.player);
+            while (moves) {
+                sink += position.board.flips(position.player, popFirstSquare(moves));
+                calls++;
+            }
+        }
+        return calls;
+    }, results);
+    bench(options, "bitboard", "makeUndo", [&]() {
+        long long calls = 0;
+        for (Position &position: positions) {
+            ullint moves = position.board.legalMoves(position.player);
+            while (moves) {
+                Square move = popFirstSquare(moves);
+                ullint flipped = position.board.makeMove(position.player, move);
+                sink += position.board.pieces[0];
+                position.board.undoMove(position.player, move, flipped);
+                calls++;
+            }
+        }
+        return calls;
+    }, results);
+    bench(options, "bitboard", "stability", [&]() {
+        for (Position &position: positions) {
+            sink += position.board.numberOfStablePieces(position.player);
+        }
+        return (long long) positions.size();
+    }, results);
+    bench(options, "bitboard", "discCount", [&]() {
+        for (Position &position: positions) {
+            sink += position.board.numberOfPieces(ReversiBoard::BLACK) - position.board.numberOfPieces(ReversiBoard::WHITE);
+        }
+        return (long long) positions.size();
+    }, results);
+    bench(options, "bitboard", "mobility", [&]() {
+        for (Position &position: positions) {
+            sink += features::mobility(position.board.pieces[position.player], position.board.pieces[1 - position.player]);
+        }
+        return (long long) positions.size();
+    }, results);
+    bench(options, "bitboard", "frontier", [&]() {
+        for (Position &position: positions) {
+            sink += features::frontier(position.board.pieces[position.player], position.board.pieces[1 - position.player]);
+        }
+        return (long long) positions.size();
+    }, results);
+    bench(options, "bitboard", "weights", [&]() {
+        // The positional weights of the char grid evaluation, over set bits
+        for (Position &position: positions) {
+            int score = 0;
+            for (int side = 0; side < 2; side++) {
+                ullint discs = position.board.pieces[side];
+                while (discs) {
+                    Square square = popFirstSquare(discs);
+                    int weight = POS_WEIGHTS_HW[squareRow(square)][squareColumn(square)];
+                    score += side == ReversiBoard::BLACK ? weight : -weight;
+                }
+            }
+            sink += score;
+        }
+        return (long long) positions.size();
+    }, results);
+    bench(options, "bitboard", "hash", [&]() {
+        for (Position &position: positions) {
+            sink += TranspositionTable::hash(position.board, position.player, SQUARE_PASS, position.player);
+        }
+        return (long long) positions.size();
+    }, results);
+    bench(options, "bitboard", "canonicalKey", [&]() {
+        for (Position &position: positions) {
+            sink += position.board.canonicalKey(position.player).player;
+        }
+        return (long long) positions.size();
+    }, results);
+}
+
+static void benchGrid(const BenchOptions &options, Corpus &corpus, vector<Result> &results) {
+    vector<vector<vector<char> > > &grids = corpus.grids;
+    vector<char> &players = corpus.gridPlayers;
+    bench(options, "grid", "legalMoves", [&]() {
+        for (size_t i = 0; i < grids.size(); i++) {
+            sink += ReversiCommon::validMoves(grids[i], players[i]).size();
+        }
+        return (long long) grids.size();
+    }, results);
+    bench(options, "grid", "makeUndo", [&]() {
+        long long calls = 0;
+        for (size_t i = 0; i < grids.size(); i++) {
+            char player = players[i];
+            vector<ReversiCommon::Move> moves = ReversiCommon::validMoves(grids[i], player);
+            for (ReversiCommon::Move &move: moves) {
+                map<int, vector<int> > flips = ReversiCommon::makeMove(move, grids[i], player);
+                sink += flips.size();
+                ReversiCommon::undoMove(move, grids[i], player, flips);
+                calls++;
+            }
+        }
+        return calls;
+    }, results);
+    bench(options, "grid", "stability", [&]() {
+        for (size_t i = 0; i < grids.size(); i++) {
+            ReversiCommon::DiscsAndStableDiscs counts = ReversiCommon::numberOfDiscsAndStableDiscs(grids[i]);
+            sink += counts.numberOfStableDiscs[players[i]];
+        }
+        return (long long) grids.size();
+    }, results);
+    bench(options, "grid", "discCount", [&]() {
+        for (size_t i = 0; i < grids.size(); i++) {
+            int difference = 0;
+            for (int row = 0; row < BOARD_SIZE; row++) {
+                for (int column = 0; column < BOARD_SIZE; column++) {
+                    difference += grids[i][row][column] == 'X' ? 1 : grids[i][row][column] == 'O' ? -1 : 0;
+                }
+            }
+            sink += difference;
+        }
+        return (long long) grids.size();
+    }, results);
+    bench(options, "grid", "weights", [&]() {
+        for (size_t i = 0; i < grids.size(); i++) {
+            sink += ReversiCommon::evaluateScoreHW(grids[i]);
+        }
+        return (long long) grids.size();
+    }, results);
+    bench(options, "grid", "hash", [&]() {
+        // The grid has no hash of its own: the engine converts it to a bitboard first
+        for (size_t i = 0; i < grids.size(); i++) {
+            ReversiBoard board(grids[i]);
+            int player = players[i] == 'X' ? ReversiBoard::BLACK : ReversiBoard::WHITE;
+            sink += TranspositionTable::hash(board, player, SQUARE_PASS, player);
+        }
+        return (long long) grids.size();
+    }, results);
+}
+
+static bool writeReport(const string &path, const vector<Result> &results) {
+    ofstream output(path.c_str());
+    if (!output.is_open()) {
+        cout << "Couldn't open file: " << path << endl;
+        return false;
+    }
+    output << "backend\tprimitive\tmedian_ns\tp10_ns\tp90_ns\tmin_ns\tcalls" << endl;
+    output << fixed << setprecision(3);
+    for (const Result &result: results) {
+        output << result.backend << '\t' << result.primitive << '\t' << result.median << '\t' << result.p10 << '\t'
+               << result.p90 << '\t' << result.min << '\t' << result.calls << endl;
+    }
+    return true;
+}
+
+/**
+ * Prints the primitives whose median got slower than the baseline by more than the tolerance and returns
+ * how many there are, -1 if the baseline cannot be read
+ */
+static int compareBaseline(const BenchOptions &options, const vector<Result> &results) {
+    ifstream input(options.baselinePath.c_str());
+    if (!input.is_open()) {
+        cout << "Couldn't open file: " << options.baselinePath << endl;
+        return -1;
+    }
+    map<string, double> baseline;
+    string line;
+    getline(input, line);
+    while (getline(input, line)) {
+        size_t first = line.find('\t');
+        size_t second = line.find('\t', first + 1);
+        if (first == string::npos || second == string::npos) {
+            continue;
+        }
+        baseline[line.substr(0, second)] = atof(line.c_str() + second + 1);
+    }
+
+    int regressions = 0;
+    cout << endl << "Against " << options.baselinePath << ":" << endl;
+    for (const Result &result: results) {
+        map<string, double>::iterator old = baseline.find(result.backend + '\t' + result.primitive);
+        if (old == baseline.end() || old->second <= 0.0) {
+            continue;
+        }
+        double change = result.median / old->second - 1.0;
+        bool regressed = change > options.tolerance;
+        regressions += regressed;
+        cout << setw(10) << left << result.backend << setw(18) << result.primitive << right << showpos << fixed
+             << setprecision(1) << setw(8) << change * 100.0 << '%' << noshowpos
+             << (regressed ? "  slower" : "") << endl;
+    }
+    return regressions;
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions options;
+    for (int i = 1; i < argc; i++) {
+        string argument(argv[i]);
+        size_t separator = argument.find('=');
+        if (separator == string::npos) {
+            cout << "Expected key=value, got: " << argument << endl;
+            return 1;
+        }
+        if (!options.parse(argument.substr(0, separator), argument.substr(separator + 1))) {
+            return 1;
+        }
+    }
+
+    vector<Position> positions;
+    if (!options.positionsPath.empty()) {
+        if (!Position::loadPositions(options.positionsPath, positions)) {
+            return 1;
+        }
+    } else {
+        positions = Position::randomGamePositions(options.positions, 1);
+    }
+    Corpus corpus;
+    for (const Position &position: positions) {
+        corpus.add(position);
+    }
+
+    cout << corpus.size() << " positions, " << options.samples << " samples, nanoseconds per call" << endl;
+    cout << setw(10) << left << "backend" << setw(18) << "primitive" << right << setw(10) << "median"
+         << setw(10) << "p10" << setw(10) << "p90" << setw(10) << "min" << setw(10) << "calls" << endl;
+    vector<Result> results;
+    benchBitboard(options, corpus, results);
+    benchGrid(options, corpus, results);
+    // Printed so the sink stays live
+    cout << "(checksum " << sink << ")" << endl;
+
+    if (!options.reportPath.empty() && !writeReport(options.reportPath, results)) {
+        return 1;
+    }
+    if (!options.baselinePath.empty()) {
+        int regressions = compareBaseline(options, results);
+        if (regressions != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
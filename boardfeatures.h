@@ -0,0 +1,144 @@
+#ifndef BOARDFEATURES_H
+#define BOARDFEATURES_H
+
+#include "reversiboard.h"
+
+using namespace std;
+
+/**
+ * Branch-free evaluation features of a position seen from one side, taking the raw bitboards so any
+ * evaluator can use them. Counts are for player unless the name says otherwise.
+ */
+namespace features {
+    // b2, g2, b7 and g7
+    static const ullint X_SQUARES = 0x0042000000004200ULL;
+    // The edge squares next to the corners
+    static const ullint C_SQUARES = 0x4281000000008142ULL;
+    static const ullint EDGES = BoardGeometry<BOARD_SIZE>::EDGES;
+    // a1-d4, e1-h4, a5-d8 and e5-h8
+    static const ullint QUADRANTS[4] = {
+        0xF0F0F0F000000000ULL, 0x0F0F0F0F00000000ULL, 0x00000000F0F0F0F0ULL, 0x000000000F0F0F0FULL
+    };
+
+    /**
+     * Squares next to any of the given ones
+     */
+    inline ullint neighbours(ullint squares) {
+        return shiftDown(squares) | shiftDownLeft(squares) | shiftDownRight(squares) | shiftLeft(squares)
+            | shiftRight(squares) | shiftUp(squares) | shiftUpLeft(squares) | shiftUpRight(squares);
+    }
+
+    inline int mobility(ullint player, ullint opponent) {
+        return popCount(generateMoves(player, opponent));
+    }
+
+    /**
+     * Empty squares next to an opponent disc, the moves the player may get later
+     */
+    inline int potentialMobility(ullint player, ullint opponent) {
+        return popCount(neighbours(opponent) & ~(player | opponent));
+    }
+
+    /**
+     * The player's discs next to an empty square, which give the opponent moves
+     */
+    inline int frontier(ullint player, ullint opponent) {
+        return popCount(player & neighbours(~(player | opponent)));
+    }
+
+    inline int corners(ullint player) {
+        return popCount(player & ReversiBoard::CORNERS);
+    }
+
+    inline int edges(ullint player) {
+        return popCount(player & EDGES);
+    }
+
+    /**
+     * X-squares held by the player while the corner next to them is still empty
+     */
+    inline int xSquareExposure(ullint player, ullint opponent) {
+        ullint emptyCorners = ReversiBoard::CORNERS & ~(player | opponent);
+        return popCount(player & X_SQUARES & neighbours(emptyCorners));
+    }
+
+    /**
+     * C-squares held by the player while the corner next to them is still empty
+     */
+    inline int cSquareExposure(ullint player, ullint opponent) {
+        ullint emptyCorners = ReversiBoard::CORNERS & ~(player | opponent);
+        return popCount(player & C_SQUARES & neighbours(emptyCorners));
+    }
+
+    /**
+     * Bit i is set when quadrant i has an odd number of empty squares; the side to move would like
+     * to get the last move in each of them
+     */
+    inline int parity(ullint player, ullint opponent) {
+        ullint empty = ~(player | opponent);
+        return (popCount(empty & QUADRANTS[0]) & 1) | (popCount(empty & QUADRANTS[1]) & 1) << 1
+            | (popCount(empty & QUADRANTS[2]) & 1) << 2 | (popCount(empty & QUADRANTS[3]) & 1) << 3;
+    }
+
+    inline int oddRegions(ullint player, ullint opponent) {
+        return popCount(parity(player, opponent));
+    }
+
+    /**
+     * The competition agent's evaluation: moveWeight, the weight of the square of the move that led to the
+     * position, times the disc, stable disc and mobility ratios of player over the opponent, every count taken
+     * as at least 1
+     */
+    inline double competitionEvaluation(ReversiBoard &board, int player, ullint playerMoves, double moveWeight) {
+        int opponent = 1 - player;
+        double mobilityRatio = max(1.0, (double) popCount(playerMoves))
+                               / max(1.0, (double) mobility(board.pieces[opponent], board.pieces[player]));
+        double discRatio = max(1.0, (double) board.numberOfPieces(player))
+                           / max(1.0, (double) board.numberOfPieces(opponent));
+        double stableDiscRatio = max(1.0, (double) board.numberOfStablePieces(player))
+                                 / max(1.0, (double) board.numberOfStablePieces(opponent));
+        return moveWeight * discRatio * stableDiscRatio * mobilityRatio;
+    }
+};
+
+/**
+ * All features of a position at once, for evaluators and training tools that want the full set
+ */
+class BoardFeatures {
+public:
+    int mobility;
+    int opponentMobility;
+    int potentialMobility;
+    int opponentPotentialMobility;
+    int frontier;
+    int opponentFrontier;
+    int corners;
+    int opponentCorners;
+    int edges;
+    int opponentEdges;
+    int xSquares;
+    int opponentXSquares;
+    int cSquares;
+    int opponentCSquares;
+    int oddRegions;
+
+    BoardFeatures(ullint player, ullint opponent):
+            mobility(features::mobility(player, opponent)),
+            opponentMobility(features::mobility(opponent, player)),
+            potentialMobility(features::potentialMobility(player, opponent)),
+            opponentPotentialMobility(features::potentialMobility(opponent, player)),
+            frontier(features::frontier(player, opponent)),
+            opponentFrontier(features::frontier(opponent, player)),
+            corners(features::corners(player)),
+            opponentCorners(features::corners(opponent)),
+            edges(features::edges(player)),
+            opponentEdges(features::edges(opponent)),
+            xSquares(features::xSquareExposure(player, opponent)),
+            opponentXSquares(features::xSquareExposure(opponent, player)),
+            cSquares(features::cSquareExposure(player, opponent)),
+            opponentCSquares(features::cSquareExposure(opponent, player)),
+            oddRegions(features::oddRegions(player, opponent)) {
+    }
+};
+
+#endif // BOARDFEATURES_H
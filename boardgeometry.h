@@ -0,0 +1,122 @@
+#ifndef BOARDGEOMETRY_H
+#define BOARDGEOMETRY_H
+
+#include <cstdint>
+#include <type_traits>
+
+using namespace std;
+
+// Side of the standard board, which ReversiBoard and the agents play on
+constexpr int BOARD_SIZE = 8;
+
+/**
+ * Bitboard layout of an N x N board. Square s = row * N + column (a1 = 0) is bit SQUARES - 1 - s, as on the
+ * 8x8 board, so the masks below reproduce the standard constants for N = 8. Boards of up to 64 squares use
+ * 64 bit words, larger ones 128 bit words.
+ */
+template <int N>
+struct BoardGeometry {
+    static_assert(N >= 4 && N % 2 == 0 && N * N <= 128, "board sizes from 4x4 to 10x10, even sides only");
+
+    typedef typename conditional<(N * N <= 64), uint64_t, unsigned __int128>::type Bits;
+
+    static constexpr int SIZE = N;
+    static constexpr int SQUARES = N * N;
+
+    static constexpr int square(int row, int column) {
+        return row * N + column;
+    }
+
+    static constexpr Bits bit(int square) {
+        return Bits(1) << (SQUARES - 1 - square);
+    }
+
+    static constexpr Bits column(int column) {
+        Bits mask = 0;
+        for (int row = 0; row < N; row++) {
+            mask |= bit(square(row, column));
+        }
+        return mask;
+    }
+
+    static constexpr Bits row(int row) {
+        Bits mask = 0;
+        for (int column = 0; column < N; column++) {
+            mask |= bit(square(row, column));
+        }
+        return mask;
+    }
+
+    static int popCount(Bits bits) {
+        if constexpr (sizeof(Bits) == 8) {
+            return __builtin_popcountll(bits);
+        } else {
+            return __builtin_popcountll((uint64_t) bits) + __builtin_popcountll((uint64_t) (bits >> 64));
+        }
+    }
+
+    /**
+     * Lowest square index present in bits, which must not be empty
+     */
+    static int firstSquare(Bits bits) {
+        if constexpr (sizeof(Bits) == 8) {
+            return __builtin_clzll(bits) - (64 - SQUARES);
+        } else {
+            uint64_t high = (uint64_t) (bits >> 64);
+            int zeros = high ? __builtin_clzll(high) : 64 + __builtin_clzll((uint64_t) bits);
+            return zeros - (128 - SQUARES);
+        }
+    }
+
+    /**
+     * Square under one of the 8 symmetries of the board: columns mirrored if transform & 1, then rows
+     * if transform & 2, then rows and columns swapped if transform & 4, as for ReversiBoard::transformed
+     */
+    static constexpr int transformSquare(int square, int transform) {
+        int row = square / N, column = square % N;
+        if (transform & 1) {
+            column = N - 1 - column;
+        }
+        if (transform & 2) {
+            row = N - 1 - row;
+        }
+        return transform & 4 ? column * N + row : row * N + column;
+    }
+
+    static constexpr int inverseTransform(int transform) {
+        // b1 lies on no symmetry axis, only the inverse brings it back
+        for (int inverse = 0; inverse < 8; inverse++) {
+            if (transformSquare(transformSquare(1, transform), inverse) == 1) {
+                return inverse;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * Moves every square of bits, one at a time. Meant for the few positions near the root, the 8x8 board
+     * has the delta swap version in ReversiBoard.
+     */
+    static Bits transform(Bits bits, int transform) {
+        Bits result = 0;
+        while (bits) {
+            int square = firstSquare(bits);
+            bits ^= bit(square);
+            result |= bit(transformSquare(square, transform));
+        }
+        return result;
+    }
+
+    static constexpr Bits ALL = SQUARES == 8 * sizeof(Bits) ? ~Bits(0) : (Bits(1) << SQUARES) - 1;
+    // Column a and the last column
+    static constexpr Bits LEFT_COLUMN = column(0);
+    static constexpr Bits RIGHT_COLUMN = column(N - 1);
+    static constexpr Bits EDGES = row(0) | row(N - 1) | column(0) | column(N - 1);
+    static constexpr Bits CORNERS = bit(square(0, 0)) | bit(square(0, N - 1)) | bit(square(N - 1, 0))
+                                    | bit(square(N - 1, N - 1));
+    // Black on the top left and bottom right of the four centre squares, white on the other two
+    static constexpr Bits INITIAL_BLACK = bit(square(N / 2 - 1, N / 2 - 1)) | bit(square(N / 2, N / 2));
+    static constexpr Bits INITIAL_WHITE = bit(square(N / 2 - 1, N / 2)) | bit(square(N / 2, N / 2 - 1));
+};
+
+#endif // BOARDGEOMETRY_H
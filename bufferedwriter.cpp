@@ -0,0 +1,93 @@
+#include "bufferedwriter.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+BufferedWriter::BufferedWriter(size_t capacity): fd(-1), buffer(new char[capacity]), capacity(capacity), used(0),
+        flushed(0), failed(false) {
+}
+
+BufferedWriter::~BufferedWriter() {
+    close();
+    delete[] buffer;
+}
+
+bool BufferedWriter::open(const string &path, bool append) {
+    close();
+    int flags = O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC);
+    fd = ::open(path.c_str(), flags, 0644);
+    used = 0;
+    flushed = 0;
+    failed = fd < 0;
+    if (fd >= 0 && append) {
+        flushed = lseek(fd, 0, SEEK_END);
+    }
+    return fd >= 0;
+}
+
+bool BufferedWriter::isOpen() const {
+    return fd >= 0;
+}
+
+long long BufferedWriter::position() const {
+    return flushed + used;
+}
+
+void BufferedWriter::writeThrough(const char *data, size_t length) {
+    while (length > 0 && fd >= 0) {
+        ssize_t written = ::write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            failed = true;
+            return;
+        }
+        data += written;
+        length -= written;
+        flushed += written;
+    }
+}
+
+bool BufferedWriter::flush() {
+    if (used > 0) {
+        writeThrough(buffer, used);
+        used = 0;
+    }
+    return !failed;
+}
+
+bool BufferedWriter::writeAt(long long offset, const char *data, size_t length) {
+    if (!flush() || fd < 0) {
+        return false;
+    }
+    while (length > 0) {
+        ssize_t written = pwrite(fd, data, length, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            failed = true;
+            return false;
+        }
+        data += written;
+        length -= written;
+        offset += written;
+    }
+    return true;
+}
+
+bool BufferedWriter::close() {
+    if (fd < 0) {
+        return !failed;
+    }
+    flush();
+    if (::close(fd) != 0) {
+        failed = true;
+    }
+    fd = -1;
+    return !failed;
+}
@@ -0,0 +1,88 @@
+#ifndef BUFFEREDWRITER_H
+#define BUFFEREDWRITER_H
+
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+/**
+ * Append-only file writer with a large user-space buffer and allocation-free integer formatting
+ */
+class BufferedWriter {
+public:
+    static const size_t DEFAULT_CAPACITY = 1 << 20;
+
+    BufferedWriter(size_t capacity = DEFAULT_CAPACITY);
+    ~BufferedWriter();
+
+    bool open(const string &path, bool append = false);
+
+    bool isOpen() const;
+
+    void write(const char *data, size_t length) {
+        if (used + length > capacity) {
+            flush();
+            if (length > capacity) {
+                writeThrough(data, length);
+                return;
+            }
+        }
+        memcpy(buffer + used, data, length);
+        used += length;
+    }
+
+    void put(char ch) {
+        if (used == capacity) {
+            flush();
+        }
+        buffer[used++] = ch;
+    }
+
+    void writeInt(long long value) {
+        char digits[24];
+        char *end = digits + sizeof(digits);
+        char *start = end;
+        unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long) value : (unsigned long long) value;
+        do {
+            *--start = (char) ('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude);
+        if (value < 0) {
+            *--start = '-';
+        }
+        write(start, end - start);
+    }
+
+    /**
+     * Bytes handed to the writer so far, buffered or not
+     */
+    long long position() const;
+
+    /**
+     * Overwrites bytes that were already written, e.g. a header reserved up front
+     */
+    bool writeAt(long long offset, const char *data, size_t length);
+
+    bool flush();
+
+    /**
+     * Flushes and closes the file, returning false if any write failed
+     */
+    bool close();
+
+private:
+    int fd;
+    char *buffer;
+    size_t capacity;
+    size_t used;
+    long long flushed;
+    bool failed;
+
+    void writeThrough(const char *data, size_t length);
+
+    BufferedWriter(const BufferedWriter &);
+    BufferedWriter &operator=(const BufferedWriter &);
+};
+
+#endif // BUFFEREDWRITER_H
@@ -0,0 +1,217 @@
+#include "bufferedwriter.h"
+#include "endgame.h"
+#include "engineconfig.h"
+#include "reversicompetitionagent.h"
+#include "trainingdata.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Settings of a generation run, given as key=value arguments
+ */
+class DataGenOptions {
+public:
+    string outputPath;
+    int games;
+    int threads;
+    // Uniformly random plies played before the agent takes over
+    int randomPlies;
+    // Positions with this many empty squares or fewer are solved exactly
+    int solveEmpties;
+    unsigned int seed;
+    EngineConfig engine;
+
+    DataGenOptions(): outputPath("positions.bin"), games(1000), threads(max(1, (int) thread::hardware_concurrency())),
+            randomPlies(8), solveEmpties(14), seed(1) {
+        engine.name = "datagen";
+        engine.depth = 2;
+    }
+
+    bool parse(const string &key, const string &value) {
+        if (key == "out") {
+            outputPath = value;
+        } else if (key == "games") {
+            games = atoi(value.c_str());
+        } else if (key == "threads") {
+            threads = max(1, atoi(value.c_str()));
+        } else if (key == "random") {
+            randomPlies = atoi(value.c_str());
+        } else if (key == "solve") {
+            solveEmpties = atoi(value.c_str());
+        } else if (key == "seed") {
+            seed = strtoul(value.c_str(), NULL, 10);
+        } else if (key == "engine") {
+            return EngineConfig::parseAlphaBeta(value, engine);
+        } else {
+            cout << "Unknown datagen option: " << key << endl;
+            return false;
+        }
+        return true;
+    }
+};
+
+struct PositionKeyHash {
+    size_t operator()(const pair<ullint, ullint> &key) const {
+        return (size_t) ((key.first * 0x9E3779B97F4A7C15ULL) ^ (key.second + (key.second >> 29)));
+    }
+};
+
+class DataGenerator {
+public:
+    DataGenerator(const DataGenOptions &options): options(options), nextGame(0), positions(0), duplicates(0),
+            solverNodes(0) {
+    }
+
+    bool run() {
+        if (!output.open(options.outputPath)) {
+            cout << "Couldn't open file: " << options.outputPath << endl;
+            return false;
+        }
+        uint8_t header[trainingdata::HEADER_SIZE];
+        trainingdata::writeHeader(header);
+        output.write((const char *) header, sizeof(header));
+
+        chrono::time_point<chrono::steady_clock> start = chrono::steady_clock::now();
+        vector<thread> workers;
+        for (int i = 0; i < options.threads; i++) {
+            workers.push_back(thread(&DataGenerator::worker, this));
+        }
+        for (thread &worker: workers) {
+            worker.join();
+        }
+        chrono::duration<double> duration = chrono::steady_clock::now() - start;
+
+        cout << "Games\t" << options.games << endl;
+        cout << "Positions\t" << positions << endl;
+        cout << "Duplicates\t" << duplicates << endl;
+        cout << "SolverNodes\t" << solverNodes << endl;
+        cout << "Seconds\t" << duration.count() << endl;
+        return output.close();
+    }
+
+private:
+    const DataGenOptions &options;
+    atomic<int> nextGame;
+    mutex outputMutex;
+    BufferedWriter output;
+    unordered_set<pair<ullint, ullint>, PositionKeyHash> seen;
+    long long positions;
+    long long duplicates;
+    atomic<long long> solverNodes;
+
+    void worker() {
+        vector<TrainingPosition> game;
+        for (int index = nextGame++; index < options.games; index = nextGame++) {
+            playGame(index, game);
+            record(game);
+        }
+    }
+
+    /**
+     * Plays one game and fills in the positions the agent searched, labelled with the exact result
+     */
+    void playGame(int index, vector<TrainingPosition> &game) {
+        mt19937 random(options.seed * 1000003u + index);
+        EndgameSolver solver;
+        ReversiBoard board;
+        int player = ReversiBoard::BLACK;
+        vector<int> sides;
+        game.clear();
+
+        bool passed = false;
+        int ply = 0;
+        int result;
+        while (true) {
+            ullint moves = board.legalMoves(player);
+            int empties = popCount(~(board.pieces[0] | board.pieces[1]));
+            if (!moves) {
+                if (passed) {
+                    result = board.numberOfPieces(player) - board.numberOfPieces(1 - player);
+                    break;
+                }
+                passed = true;
+                player = 1 - player;
+                continue;
+            }
+            passed = false;
+
+            if (ply < options.randomPlies) {
+                int skip = uniform_int_distribution<int>(0, popCount(moves) - 1)(random);
+                while (skip-- > 0) {
+                    popFirstSquare(moves);
+                }
+                board.makeMove(player, firstSquare(moves));
+                player = 1 - player;
+                ply++;
+                continue;
+            }
+
+            ReversiCompetitionAgent agent(board, player, options.engine);
+            Node node = agent.search();
+            game.push_back(TrainingPosition(board.pieces[player], board.pieces[1 - player], node.value, 0));
+            sides.push_back(player);
+            if (empties <= options.solveEmpties) {
+                result = solver.solve(board, player);
+                solverNodes += solver.nodes();
+                break;
+            }
+
+            Square move = node.move;
+            if (move >= NO_OF_SQUARES || !(moves & squareBit(move))) {
+                move = firstSquare(moves);
+            }
+            board.makeMove(player, move);
+            player = 1 - player;
+            ply++;
+        }
+
+        for (size_t i = 0; i < game.size(); i++) {
+            game[i].result = sides[i] == player ? result : -result;
+        }
+    }
+
+    void record(const vector<TrainingPosition> &game) {
+        lock_guard<mutex> lock(outputMutex);
+        uint8_t packed[trainingdata::RECORD_SIZE];
+        for (const TrainingPosition &position: game) {
+            // Mirrored positions carry the same information, only the first of them is kept
+            CanonicalKey key = ReversiBoard(position.player, position.opponent).canonicalKey(ReversiBoard::BLACK);
+            if (!seen.insert(make_pair(key.player, key.opponent)).second) {
+                duplicates++;
+                continue;
+            }
+            trainingdata::pack(position, packed);
+            output.write((const char *) packed, sizeof(packed));
+            positions++;
+        }
+    }
+};
+
+int main(int argc, char *argv[]) {
+    DataGenOptions options;
+    for (int i = 1; i < argc; i++) {
+        string argument(argv[i]);
+        size_t separator = argument.find('=');
+        if (separator == string::npos) {
+            cout << "Usage: datagen [out=positions.bin] [games=1000] [threads=N] [random=8] [solve=14] [seed=1]"
+                 << " [engine=depth=2,...]" << endl;
+            return 1;
+        }
+        if (!options.parse(argument.substr(0, separator), argument.substr(separator + 1))) {
+            return 1;
+        }
+    }
+    cout << "Generating positions from " << options.games << " games on " << options.threads << " threads" << endl;
+    DataGenerator generator(options);
+    return generator.run() ? 0 : 1;
+}
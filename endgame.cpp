@@ -0,0 +1,101 @@
+#include "endgame.h"
+
+#include <algorithm>
+#include <climits>
+
+using namespace std;
+
+// Below this many empties move ordering costs more than the cutoffs it buys
+static const int ORDERING_EMPTIES = 7;
+
+EndgameSolver::EndgameSolver(): nodeCount(0) {
+}
+
+long long EndgameSolver::nodes() const {
+    return nodeCount;
+}
+
+int EndgameSolver::solve(const ReversiBoard &position, int player) {
+    board = position;
+    return negamax(player, -NO_OF_SQUARES - 1, NO_OF_SQUARES + 1, false);
+}
+
+Square EndgameSolver::bestMove(const ReversiBoard &position, int player, int &value) {
+    board = position;
+    ullint moves = board.legalMoves(player);
+    if (!moves) {
+        value = -negamax(1 - player, -NO_OF_SQUARES - 1, NO_OF_SQUARES + 1, true);
+        return SQUARE_PASS;
+    }
+    Square squares[NO_OF_SQUARES];
+    int count = orderMoves(player, moves, squares);
+    Square best = squares[0];
+    int alpha = -NO_OF_SQUARES - 1;
+    for (int i = 0; i < count; i++) {
+        ullint flipped = board.makeMove(player, squares[i]);
+        int score = -negamax(1 - player, -NO_OF_SQUARES - 1, -alpha, false);
+        board.undoMove(player, squares[i], flipped);
+        if (score > alpha) {
+            alpha = score;
+            best = squares[i];
+        }
+    }
+    value = alpha;
+    return best;
+}
+
+int EndgameSolver::finalScore(int player) {
+    return board.numberOfPieces(player) - board.numberOfPieces(1 - player);
+}
+
+int EndgameSolver::orderMoves(int player, ullint moves, Square squares[]) {
+    int count = 0;
+    while (moves) {
+        squares[count++] = popFirstSquare(moves);
+    }
+    int empties = popCount(~(board.pieces[0] | board.pieces[1]));
+    if (empties < ORDERING_EMPTIES) {
+        return count;
+    }
+    // Fastest first: replies that leave the opponent the fewest moves tend to be best and cut earliest
+    int mobility[NO_OF_SQUARES];
+    for (int i = 0; i < count; i++) {
+        ullint flipped = board.makeMove(player, squares[i]);
+        mobility[squares[i]] = popCount(board.legalMoves(1 - player));
+        board.undoMove(player, squares[i], flipped);
+    }
+    stable_sort(squares, squares + count, [&mobility](Square a, Square b) {
+        return mobility[a] < mobility[b];
+    });
+    return count;
+}
+
+int EndgameSolver::negamax(int player, int alpha, int beta, bool passed) {
+    nodeCount++;
+    ullint moves = board.legalMoves(player);
+    if (!moves) {
+        if (passed) {
+            return finalScore(player);
+        }
+        return -negamax(1 - player, -beta, -alpha, true);
+    }
+
+    Square squares[NO_OF_SQUARES];
+    int count = orderMoves(player, moves, squares);
+    int best = INT_MIN;
+    for (int i = 0; i < count; i++) {
+        ullint flipped = board.makeMove(player, squares[i]);
+        int score = -negamax(1 - player, -beta, -alpha, false);
+        board.undoMove(player, squares[i], flipped);
+        if (score > best) {
+            best = score;
+            if (score > alpha) {
+                alpha = score;
+                if (alpha >= beta) {
+                    break;
+                }
+            }
+        }
+    }
+    return best;
+}
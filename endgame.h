@@ -0,0 +1,42 @@
+#ifndef ENDGAME_H
+#define ENDGAME_H
+
+#include "reversiboard.h"
+
+using namespace std;
+
+/**
+ * Exact endgame search: plays out every line to the end of the game with alpha-beta on the
+ * final disc difference. Practical up to roughly 16 empty squares.
+ */
+class EndgameSolver {
+public:
+    EndgameSolver();
+
+    /**
+     * Final disc difference, player minus opponent, when both sides play perfectly from here
+     */
+    int solve(const ReversiBoard &position, int player);
+
+    /**
+     * Best move for the player along with its exact value, SQUARE_PASS if the player has to pass
+     */
+    Square bestMove(const ReversiBoard &position, int player, int &value);
+
+    long long nodes() const;
+
+private:
+    ReversiBoard board;
+    long long nodeCount;
+
+    int negamax(int player, int alpha, int beta, bool passed);
+
+    int finalScore(int player);
+
+    /**
+     * Fills squares with the moves in search order, returns how many there are
+     */
+    int orderMoves(int player, ullint moves, Square squares[]);
+};
+
+#endif // ENDGAME_H
@@ -0,0 +1,162 @@
+#include "engineconfig.h"
+#include "nnue.h"
+#include "reversicompetitionagent.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+// Share of the clock that moveTime never hands out, against overruns and the moves it underestimated
+static const double CLOCK_RESERVE = 0.05;
+
+struct DefaultWeights {
+    int weights[BOARD_SIZE][BOARD_SIZE];
+    bool loaded;
+
+    DefaultWeights(): loaded(false) {
+        ifstream weightsFile(DEFAULT_WEIGHTS_PATH);
+        if (weightsFile.is_open()) {
+            weightsFile.close();
+            loaded = EngineConfig::loadWeights(DEFAULT_WEIGHTS_PATH, weights);
+        }
+        if (!loaded) {
+            memcpy(weights, HEURISTIC, sizeof(weights));
+        }
+    }
+};
+
+static const DefaultWeights &loadDefaultWeights() {
+    static const DefaultWeights defaults;
+    return defaults;
+}
+
+EngineConfig::EngineConfig(): name("default"), depth(0), cpuTime(200.0), prune(true), algorithm("alphabeta"),
+        playouts(10000), threads(1), treeNodes(1 << 20) {
+    memcpy(weights, loadDefaultWeights().weights, sizeof(weights));
+    if (loadDefaultWeights().loaded) {
+        weightsPath = DEFAULT_WEIGHTS_PATH;
+    }
+}
+
+const int (*EngineConfig::defaultWeights())[BOARD_SIZE] {
+    return loadDefaultWeights().weights;
+}
+
+bool EngineConfig::parse(const string &spec, EngineConfig &config) {
+    stringstream specStream(spec);
+    string pair;
+    while (getline(specStream, pair, ',')) {
+        if (pair.empty()) {
+            continue;
+        }
+        size_t separator = pair.find('=');
+        if (separator == string::npos) {
+            cout << "Invalid engine option: " << pair << endl;
+            return false;
+        }
+        string key = pair.substr(0, separator);
+        string value = pair.substr(separator + 1);
+        if (key == "name") {
+            config.name = value;
+        } else if (key == "depth") {
+            config.depth = atoi(value.c_str());
+        } else if (key == "time") {
+            config.cpuTime = atof(value.c_str());
+        } else if (key == "prune") {
+            config.prune = value != "0" && value != "false";
+        } else if (key == "weights") {
+            if (!loadWeights(value, config.weights)) {
+                return false;
+            }
+            config.weightsPath = value;
+        } else if (key == "network") {
+            if (!NnueNetwork::load(value)) {
+                return false;
+            }
+            config.networkPath = value;
+        } else if (key == "algorithm") {
+            if (value != "alphabeta" && value != "mcts") {
+                cout << "Unknown algorithm: " << value << endl;
+                return false;
+            }
+            config.algorithm = value;
+        } else if (key == "playouts") {
+            config.playouts = max(1, atoi(value.c_str()));
+        } else if (key == "threads") {
+            config.threads = max(1, atoi(value.c_str()));
+        } else if (key == "tree") {
+            config.treeNodes = max(1024, atoi(value.c_str()));
+        } else {
+            cout << "Unknown engine option: " << key << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool EngineConfig::parseAlphaBeta(const string &spec, EngineConfig &config) {
+    if (!parse(spec, config)) {
+        return false;
+    }
+    if (config.algorithm != "alphabeta") {
+        cout << "Only tournaments and SPRT matches play algorithm=" << config.algorithm << endl;
+        return false;
+    }
+    return true;
+}
+
+bool EngineConfig::loadWeights(const string &path, int weights[BOARD_SIZE][BOARD_SIZE]) {
+    ifstream inputFile(path.c_str());
+    if (!inputFile.is_open()) {
+        cout << "Couldn't open weights file: " << path << endl;
+        return false;
+    }
+    int loaded[NO_OF_SQUARES];
+    int count = 0;
+    string line;
+    while (count < NO_OF_SQUARES && getline(inputFile, line)) {
+        if (!line.empty() && line[0] == '#') {
+            continue;
+        }
+        istringstream lineStream(line);
+        while (count < NO_OF_SQUARES && lineStream >> loaded[count]) {
+            count++;
+        }
+    }
+    if (count != NO_OF_SQUARES) {
+        cout << "Expected " << NO_OF_SQUARES << " weights in " << path << ", found " << count << endl;
+        return false;
+    }
+    memcpy(weights, loaded, sizeof(loaded));
+    return true;
+}
+
+int EngineConfig::lastDepth(int depth, int empties) {
+    return max(1, depth > 0 ? min(depth, empties) : empties);
+}
+
+double EngineConfig::moveTime(double clock, int empties) {
+    // Each side plays about half of the remaining squares
+    int movesLeft = max(2, (empties + 1) / 2);
+    return max(0.0, clock) * (1.0 - CLOCK_RESERVE) / movesLeft;
+}
+
+string EngineConfig::toString() const {
+    ostringstream ss;
+    ss << "name=" << name << ",depth=" << depth << ",time=" << cpuTime << ",prune=" << prune;
+    if (!weightsPath.empty()) {
+        ss << ",weights=" << weightsPath;
+    }
+    if (!networkPath.empty()) {
+        ss << ",network=" << networkPath;
+    }
+    if (algorithm != "alphabeta") {
+        ss << ",algorithm=" << algorithm << ",playouts=" << playouts << ",threads=" << threads << ",tree=" << treeNodes;
+    }
+    return ss.str();
+}
@@ -0,0 +1,76 @@
+#ifndef ENGINECONFIG_H
+#define ENGINECONFIG_H
+
+#include "square.h"
+
+#include <string>
+
+using namespace std;
+
+// Weights file the engine picks up at startup when it exists, see EngineConfig::defaultWeights
+static const char DEFAULT_WEIGHTS_PATH[] = "weights.txt";
+
+/**
+ * Settings that tell one engine apart from another in self-play matches
+ */
+class EngineConfig {
+public:
+    string name;
+    // Cutoff depth of the search, 0 keeps the agent's per-colour default
+    int depth;
+    // Seconds left on the game clock, see moveTime
+    double cpuTime;
+    // Alpha-beta cutoffs, plain minimax when disabled
+    bool prune;
+    // Square weights of the evaluation, the default weights unless loaded from weightsPath
+    int weights[BOARD_SIZE][BOARD_SIZE];
+    string weightsPath;
+    // Network file of `tuner model=nnue`; when set it evaluates instead of the square weights
+    string networkPath;
+    // "alphabeta" for ReversiCompetitionAgent, "mcts" for MctsEngine
+    string algorithm;
+    // MCTS only: playouts per move, search threads and nodes in the tree
+    int playouts;
+    int threads;
+    int treeNodes;
+
+    EngineConfig();
+
+    /**
+     * Parses a comma separated list of key=value pairs, e.g. "name=deep,depth=6".
+     * Returns false and reports the offending key if the spec is invalid.
+     */
+    static bool parse(const string &spec, EngineConfig &config);
+
+    /**
+     * parse() for the tools that only run the alpha-beta search; only tournaments and SPRT matches play
+     * algorithm=mcts, everywhere else it is refused rather than ignored
+     */
+    static bool parseAlphaBeta(const string &spec, EngineConfig &config);
+
+    /**
+     * Reads 64 integers, row by row, from a weights file. Lines starting with # are comments.
+     */
+    static bool loadWeights(const string &path, int weights[BOARD_SIZE][BOARD_SIZE]);
+
+    /**
+     * DEFAULT_WEIGHTS_PATH if it exists and is valid, HEURISTIC otherwise. The file is read once per process.
+     */
+    static const int (*defaultWeights())[BOARD_SIZE];
+
+    /**
+     * Seconds to plan on for one move with clock seconds left for the rest of the game. Spreads the clock
+     * over the moves still to come, keeping a reserve so the last moves are never starved.
+     */
+    static double moveTime(double clock, int empties);
+
+    /**
+     * The deepest iteration worth searching with empties squares left: at most depth, unless that is 0 for no
+     * cap, and at least 1. Searching past the last empty square only repeats the final evaluation.
+     */
+    static int lastDepth(int depth, int empties);
+
+    string toString() const;
+};
+
+#endif // ENGINECONFIG_H
@@ -0,0 +1,56 @@
+#include "boardfeatures.h"
+#include "position.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+static const int POSITIONS = 4096;
+
+/**
+ * Positions from random games, each from the side to move's point of view
+ */
+static vector<ReversiBoard> randomPositions(int count, unsigned int seed) {
+    vector<ReversiBoard> positions;
+    for (const Position &position: Position::randomGamePositions(count, seed)) {
+        positions.push_back(ReversiBoard(position.board.pieces[position.player],
+                                         position.board.pieces[1 - position.player]));
+    }
+    return positions;
+}
+
+template <typename Feature>
+static void bench(const char *name, const vector<ReversiBoard> &positions, int rounds, Feature feature) {
+    long long sum = 0;
+    chrono::time_point<chrono::steady_clock> start = chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (const ReversiBoard &board: positions) {
+            sum += feature(board.pieces[0], board.pieces[1]);
+        }
+    }
+    chrono::duration<double, nano> duration = chrono::steady_clock::now() - start;
+    // The sum keeps the calls from being optimised away
+    cout << name << '\t' << duration.count() / ((double) rounds * positions.size()) << " ns\t(" << sum << ")" << endl;
+}
+
+int main(int argc, char *argv[]) {
+    int rounds = argc > 1 ? atoi(argv[1]) : 2000;
+    vector<ReversiBoard> positions = randomPositions(POSITIONS, 1);
+    cout << "Feature\tTime per call over " << positions.size() << " positions x " << rounds << endl;
+    bench("mobility", positions, rounds, features::mobility);
+    bench("potentialMobility", positions, rounds, features::potentialMobility);
+    bench("frontier", positions, rounds, features::frontier);
+    bench("corners", positions, rounds, [](ullint player, ullint) { return features::corners(player); });
+    bench("edges", positions, rounds, [](ullint player, ullint) { return features::edges(player); });
+    bench("xSquareExposure", positions, rounds, features::xSquareExposure);
+    bench("cSquareExposure", positions, rounds, features::cSquareExposure);
+    bench("parity", positions, rounds, features::parity);
+    bench("BoardFeatures", positions, rounds, [](ullint player, ullint opponent) {
+        BoardFeatures all(player, opponent);
+        return all.mobility + all.opponentMobility + all.frontier + all.potentialMobility + all.oddRegions;
+    });
+    return 0;
+}
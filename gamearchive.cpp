@@ -0,0 +1,354 @@
+#include "gamearchive.h"
+
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+struct Crc32Table {
+    uint32_t entries[256];
+};
+
+static constexpr Crc32Table makeCrc32Table() {
+    Crc32Table table = {};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        table.entries[i] = crc;
+    }
+    return table;
+}
+
+static constexpr Crc32Table CRC32_TABLE = makeCrc32Table();
+
+uint32_t gamearchive::crc32(const uint8_t *data, size_t length) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; i++) {
+        crc = CRC32_TABLE.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+uint16_t gamearchive::quantizeTime(double seconds) {
+    double tenthsOfMillis = seconds * 1e4;
+    if (tenthsOfMillis < 0x8000) {
+        return (uint16_t) max(0.0, round(tenthsOfMillis));
+    }
+    double centiseconds = round(seconds * 100.0);
+    return (uint16_t) (0x8000 | (uint16_t) min(centiseconds, (double) 0x7FFF));
+}
+
+double gamearchive::dequantizeTime(uint16_t quantized) {
+    if (quantized & 0x8000) {
+        return (quantized & 0x7FFF) / 100.0;
+    }
+    return quantized / 1e4;
+}
+
+string gamearchive::indexPath(const string &archivePath) {
+    return archivePath + ".idx";
+}
+
+ArchivedGame::ArchivedGame(): start(), startPlayer(ReversiBoard::BLACK) {
+    discs[0] = discs[1] = 0;
+}
+
+void ArchivedGame::computeDiscs() {
+    ReversiBoard board = start;
+    int player = startPlayer;
+    for (Square move: moves) {
+        board.makeMove(player, move);
+        player = 1 - player;
+    }
+    discs[ReversiBoard::BLACK] = board.numberOfPieces(ReversiBoard::BLACK);
+    discs[ReversiBoard::WHITE] = board.numberOfPieces(ReversiBoard::WHITE);
+}
+
+GameArchiveReader::GameArchiveReader(): data(NULL), length(0), games(0), end(0) {
+}
+
+GameArchiveReader::~GameArchiveReader() {
+    close();
+}
+
+void GameArchiveReader::close() {
+    if (data) {
+        munmap((void *) data, length);
+    }
+    data = NULL;
+    length = 0;
+    offsets.clear();
+    games = 0;
+    end = 0;
+}
+
+size_t GameArchiveReader::recordSize(uint64_t offset) const {
+    if (offset + gamearchive::GAME_HEADER_SIZE > length) {
+        return 0;
+    }
+    const uint8_t *header = data + offset;
+    size_t plies = header[4];
+    uint8_t flags = header[5];
+    size_t size = gamearchive::GAME_HEADER_SIZE + plies;
+    if (flags & gamearchive::FLAG_START_POSITION) {
+        size += gamearchive::START_POSITION_SIZE;
+    }
+    if (flags & gamearchive::FLAG_TIMES) {
+        size += plies * sizeof(uint16_t);
+    }
+    if (offset + size > length) {
+        return 0;
+    }
+    return size;
+}
+
+bool GameArchiveReader::loadIndex(const string &path) {
+    ifstream indexFile(gamearchive::indexPath(path).c_str(), ios::binary);
+    if (!indexFile.is_open()) {
+        return false;
+    }
+    char header[16];
+    uint32_t blockSize = 0;
+    if (!indexFile.read(header, sizeof(header)) || memcmp(header, gamearchive::INDEX_MAGIC, 4) != 0) {
+        return false;
+    }
+    memcpy(&blockSize, header + 4, sizeof(blockSize));
+    if (blockSize != gamearchive::BLOCK_SIZE) {
+        return false;
+    }
+    uint64_t offset;
+    while (indexFile.read((char *) &offset, sizeof(offset))) {
+        // Offsets must point at records, in order, inside the archive
+        if (offset < gamearchive::FILE_HEADER_SIZE || offset >= length
+                || (!offsets.empty() && offset <= offsets.back())) {
+            offsets.clear();
+            return false;
+        }
+        offsets.push_back(offset);
+    }
+    return true;
+}
+
+bool GameArchiveReader::open(const string &path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        cout << "Couldn't open archive: " << path << endl;
+        return false;
+    }
+    length = status.st_size;
+    if (length < gamearchive::FILE_HEADER_SIZE) {
+        ::close(fd);
+        cout << "Not a game archive: " << path << endl;
+        return false;
+    }
+    void *mapped = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        length = 0;
+        cout << "Couldn't map archive: " << path << endl;
+        return false;
+    }
+    data = (const uint8_t *) mapped;
+    if (memcmp(data, gamearchive::MAGIC, 4) != 0) {
+        close();
+        cout << "Not a game archive: " << path << endl;
+        return false;
+    }
+
+    if (!loadIndex(path)) {
+        offsets.clear();
+    }
+    // Walk the records after the last indexed block, which also covers a missing or stale index
+    uint64_t offset = gamearchive::FILE_HEADER_SIZE;
+    games = 0;
+    if (!offsets.empty()) {
+        offset = offsets.back();
+        games = (long long) (offsets.size() - 1) * gamearchive::BLOCK_SIZE;
+    }
+    size_t size;
+    while ((size = recordSize(offset)) != 0) {
+        if (games % gamearchive::BLOCK_SIZE == 0 && games / gamearchive::BLOCK_SIZE == (long long) offsets.size()) {
+            offsets.push_back(offset);
+        }
+        offset += size;
+        games++;
+    }
+    end = offset;
+    return true;
+}
+
+long long GameArchiveReader::size() const {
+    return games;
+}
+
+const vector<uint64_t> &GameArchiveReader::blockOffsets() const {
+    return offsets;
+}
+
+uint64_t GameArchiveReader::endOffset() const {
+    return end;
+}
+
+bool GameArchiveReader::read(long long game, ArchivedGame &archivedGame) const {
+    if (game < 0 || game >= games) {
+        return false;
+    }
+    uint64_t offset = offsets[game / gamearchive::BLOCK_SIZE];
+    for (long long skip = game % gamearchive::BLOCK_SIZE; skip > 0; skip--) {
+        offset += recordSize(offset);
+    }
+    size_t size = recordSize(offset);
+    const uint8_t *record = data + offset;
+    uint32_t checksum;
+    memcpy(&checksum, record, sizeof(checksum));
+    if (size == 0 || gamearchive::crc32(record + 4, size - 4) != checksum) {
+        return false;
+    }
+
+    int plies = record[4];
+    uint8_t flags = record[5];
+    archivedGame.startPlayer = record[6];
+    archivedGame.discs[ReversiBoard::BLACK] = record[7];
+    archivedGame.discs[ReversiBoard::WHITE] = record[8];
+    const uint8_t *cursor = record + gamearchive::GAME_HEADER_SIZE;
+    if (flags & gamearchive::FLAG_START_POSITION) {
+        memcpy(archivedGame.start.pieces, cursor, gamearchive::START_POSITION_SIZE);
+        cursor += gamearchive::START_POSITION_SIZE;
+    } else {
+        archivedGame.start = ReversiBoard();
+    }
+    archivedGame.moves.assign(cursor, cursor + plies);
+    cursor += plies;
+    archivedGame.times.clear();
+    if (flags & gamearchive::FLAG_TIMES) {
+        archivedGame.times.resize(plies);
+        for (int i = 0; i < plies; i++) {
+            uint16_t quantized;
+            memcpy(&quantized, cursor + i * sizeof(uint16_t), sizeof(quantized));
+            archivedGame.times[i] = gamearchive::dequantizeTime(quantized);
+        }
+    }
+    return true;
+}
+
+GameArchiveWriter::GameArchiveWriter(): games(0) {
+}
+
+GameArchiveWriter::~GameArchiveWriter() {
+    close();
+}
+
+bool GameArchiveWriter::open(const string &path) {
+    close();
+    games = 0;
+    vector<uint64_t> offsets;
+    struct stat status;
+    if (stat(path.c_str(), &status) == 0 && status.st_size > 0) {
+        GameArchiveReader reader;
+        if (!reader.open(path)) {
+            return false;
+        }
+        games = reader.size();
+        offsets = reader.blockOffsets();
+        // Drop a record that was cut short, appends must start on a record boundary
+        if ((uint64_t) status.st_size != reader.endOffset() && truncate(path.c_str(), reader.endOffset()) != 0) {
+            cout << "Couldn't truncate archive: " << path << endl;
+            return false;
+        }
+        if (!archive.open(path, true)) {
+            cout << "Couldn't open archive: " << path << endl;
+            return false;
+        }
+    } else {
+        if (!archive.open(path)) {
+            cout << "Couldn't open archive: " << path << endl;
+            return false;
+        }
+        char header[gamearchive::FILE_HEADER_SIZE] = {};
+        memcpy(header, gamearchive::MAGIC, 4);
+        memcpy(header + 4, &gamearchive::VERSION, sizeof(uint16_t));
+        memcpy(header + 6, &gamearchive::BLOCK_SIZE, sizeof(uint16_t));
+        archive.write(header, sizeof(header));
+    }
+
+    // The index is small, rewriting it keeps it consistent with the archive we just scanned
+    if (!index.open(gamearchive::indexPath(path))) {
+        cout << "Couldn't open archive index: " << gamearchive::indexPath(path) << endl;
+        return false;
+    }
+    char indexHeader[16] = {};
+    uint32_t blockSize = gamearchive::BLOCK_SIZE;
+    memcpy(indexHeader, gamearchive::INDEX_MAGIC, 4);
+    memcpy(indexHeader + 4, &blockSize, sizeof(blockSize));
+    index.write(indexHeader, sizeof(indexHeader));
+    for (uint64_t offset: offsets) {
+        index.write((const char *) &offset, sizeof(offset));
+    }
+    return true;
+}
+
+bool GameArchiveWriter::append(const ArchivedGame &game) {
+    if (!archive.isOpen() || game.moves.size() > 255) {
+        return false;
+    }
+    bool standardStart = game.start.pieces[ReversiBoard::BLACK] == ReversiBoard::INITIAL_POSITION_BLACK
+                         && game.start.pieces[ReversiBoard::WHITE] == ReversiBoard::INITIAL_POSITION_WHITE;
+    bool withTimes = game.times.size() == game.moves.size() && !game.moves.empty();
+    uint8_t plies = (uint8_t) game.moves.size();
+
+    uint8_t record[gamearchive::GAME_HEADER_SIZE + gamearchive::START_POSITION_SIZE + 255 * 3] = {};
+    record[4] = plies;
+    record[5] = (withTimes ? gamearchive::FLAG_TIMES : 0) | (standardStart ? 0 : gamearchive::FLAG_START_POSITION);
+    record[6] = (uint8_t) game.startPlayer;
+    record[7] = (uint8_t) game.discs[ReversiBoard::BLACK];
+    record[8] = (uint8_t) game.discs[ReversiBoard::WHITE];
+    uint8_t *cursor = record + gamearchive::GAME_HEADER_SIZE;
+    if (!standardStart) {
+        memcpy(cursor, game.start.pieces, gamearchive::START_POSITION_SIZE);
+        cursor += gamearchive::START_POSITION_SIZE;
+    }
+    memcpy(cursor, game.moves.data(), plies);
+    cursor += plies;
+    if (withTimes) {
+        for (int i = 0; i < plies; i++) {
+            uint16_t quantized = gamearchive::quantizeTime(game.times[i]);
+            memcpy(cursor, &quantized, sizeof(quantized));
+            cursor += sizeof(quantized);
+        }
+    }
+    size_t size = cursor - record;
+    uint32_t checksum = gamearchive::crc32(record + 4, size - 4);
+    memcpy(record, &checksum, sizeof(checksum));
+
+    if (games % gamearchive::BLOCK_SIZE == 0) {
+        uint64_t offset = archive.position();
+        index.write((const char *) &offset, sizeof(offset));
+    }
+    archive.write((const char *) record, size);
+    games++;
+    return true;
+}
+
+long long GameArchiveWriter::size() const {
+    return games;
+}
+
+bool GameArchiveWriter::close() {
+    // Archive first: an index entry must never point past the end of the archive
+    bool archiveClosed = archive.close();
+    bool indexClosed = index.close();
+    return archiveClosed && indexClosed;
+}
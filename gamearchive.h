@@ -0,0 +1,134 @@
+#ifndef GAMEARCHIVE_H
+#define GAMEARCHIVE_H
+
+#include "bufferedwriter.h"
+#include "reversiboard.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * A finished game as stored in an archive: the start position, one square per ply
+ * (SQUARE_PASS for passes, sides alternate from startPlayer) and the time each ply took.
+ */
+class ArchivedGame {
+public:
+    ReversiBoard start;
+    int startPlayer;
+    vector<Square> moves;
+    // Seconds per ply, empty when the game was stored without times
+    vector<double> times;
+    int discs[2];
+
+    ArchivedGame();
+
+    /**
+     * Replays the moves from the start position and fills in the final disc counts
+     */
+    void computeDiscs();
+};
+
+/**
+ * Append-only binary archive of games.
+ *
+ * The archive starts with a 16 byte file header, followed by one record per game: a 16 byte header
+ * (CRC32 of the rest of the record, ply count, flags, start player and final discs), the start
+ * position when it is not the standard one, a byte per ply and, optionally, a 16 bit quantized time
+ * per ply. A sidecar ".idx" file holds the offset of every BLOCK_SIZE-th game so any game can be
+ * reached by skipping at most BLOCK_SIZE - 1 records. Integers are stored in host byte order.
+ */
+namespace gamearchive {
+    static const char MAGIC[4] = {'R', 'V', 'G', 'A'};
+    static const char INDEX_MAGIC[4] = {'R', 'V', 'G', 'I'};
+    static const uint16_t VERSION = 1;
+    static const uint16_t BLOCK_SIZE = 64;
+    static const size_t FILE_HEADER_SIZE = 16;
+    static const size_t GAME_HEADER_SIZE = 16;
+    static const size_t START_POSITION_SIZE = 16;
+
+    static const uint8_t FLAG_TIMES = 1;
+    static const uint8_t FLAG_START_POSITION = 2;
+
+    uint32_t crc32(const uint8_t *data, size_t length);
+
+    /**
+     * Times below 3.2768s keep a resolution of 0.1ms, longer ones 10ms up to about 5 minutes
+     */
+    uint16_t quantizeTime(double seconds);
+
+    double dequantizeTime(uint16_t quantized);
+
+    string indexPath(const string &archivePath);
+};
+
+class GameArchiveReader {
+public:
+    GameArchiveReader();
+    ~GameArchiveReader();
+
+    /**
+     * Maps the archive read-only. The index is used when it is present and
+     * consistent, and rebuilt in memory otherwise.
+     */
+    bool open(const string &path);
+
+    void close();
+
+    long long size() const;
+
+    /**
+     * Decodes a game, returning false if the index is out of range or its checksum does not match
+     */
+    bool read(long long game, ArchivedGame &archivedGame) const;
+
+    /**
+     * Offset of every BLOCK_SIZE-th game, as stored in the index file
+     */
+    const vector<uint64_t> &blockOffsets() const;
+
+    /**
+     * Where the next record goes, i.e. the end of the last complete one
+     */
+    uint64_t endOffset() const;
+
+private:
+    const uint8_t *data;
+    size_t length;
+    vector<uint64_t> offsets;
+    long long games;
+    uint64_t end;
+
+    size_t recordSize(uint64_t offset) const;
+
+    bool loadIndex(const string &path);
+
+    GameArchiveReader(const GameArchiveReader &);
+    GameArchiveReader &operator=(const GameArchiveReader &);
+};
+
+class GameArchiveWriter {
+public:
+    GameArchiveWriter();
+    ~GameArchiveWriter();
+
+    /**
+     * Creates the archive, or reopens it for appending after its last complete game
+     */
+    bool open(const string &path);
+
+    bool append(const ArchivedGame &game);
+
+    long long size() const;
+
+    bool close();
+
+private:
+    BufferedWriter archive;
+    BufferedWriter index;
+    long long games;
+};
+
+#endif // GAMEARCHIVE_H
@@ -0,0 +1,287 @@
+#include "gamescheduler.h"
+#include "reversicompetitionagent.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// How far the slice of a search that keeps changing its mind may grow, as a multiple of the slice
+static const double MAX_EXTENSION = 3.0;
+// Added to the slice each time the best move changes and the next iteration does not fit
+static const double EXTENSION_STEP = 0.5;
+// No single move may take more of the clock than this, extensions included
+static const double MAX_CLOCK_SHARE = 0.5;
+// Next iteration time over the last one when there is nothing better to go on
+static const double DEFAULT_GROWTH = 4.0;
+
+static chrono::steady_clock::duration seconds(double value) {
+    return chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(value));
+}
+
+GameScheduler::GameScheduler(const EngineConfig &config, int threads, size_t tableEntries,
+                             const function<void()> &answered): config(config), table(tableEntries),
+        answered(answered), generations(0), shuttingDown(false), busy(0) {
+    for (int i = 0; i < max(1, threads); i++) {
+        workers.push_back(thread(&GameScheduler::worker, this));
+    }
+}
+
+GameScheduler::~GameScheduler() {
+    {
+        lock_guard<mutex> lock(schedulerMutex);
+        vector<shared_ptr<Search> > remaining;
+        for (auto &entry: searches) {
+            remaining.push_back(entry.second);
+        }
+        for (const shared_ptr<Search> &search: remaining) {
+            search->interrupt = true;
+            search->best.stopped = true;
+            finish(search);
+        }
+        shuttingDown = true;
+    }
+    changed.notify_all();
+    for (thread &worker: workers) {
+        worker.join();
+    }
+}
+
+future<SearchInfo> GameScheduler::think(int game, const Position &position, double clock) {
+    shared_ptr<Search> search = make_shared<Search>();
+    search->game = game;
+    search->position = position;
+    search->start = Clock::now();
+    ReversiBoard board = position.board;
+    int empties = popCount(board.blankBoard());
+    search->slice = EngineConfig::moveTime(clock, empties);
+    search->deadline = search->start + seconds(search->slice);
+    search->limit = search->start + seconds(max(search->slice, min(search->slice * MAX_EXTENSION,
+                                                                   clock * MAX_CLOCK_SHARE)));
+    search->lastDepth = EngineConfig::lastDepth(config.depth, empties);
+    future<SearchInfo> result = search->result.get_future();
+
+    ullint moves = board.legalMoves(position.player);
+    lock_guard<mutex> lock(schedulerMutex);
+    map<int, shared_ptr<Search> >::iterator previous = searches.find(game);
+    if (previous != searches.end()) {
+        previous->second->interrupt = true;
+        previous->second->best.stopped = true;
+        finish(previous->second);
+    }
+    if (!moves) {
+        // Nothing to think about
+        search->answered = true;
+        search->result.set_value(search->best);
+        if (answered) {
+            answered();
+        }
+        return result;
+    }
+    // Something legal to answer with if the search never finishes an iteration
+    search->best.move = firstSquare(moves);
+    search->generation = generations++;
+    searches[game] = search;
+    table.newSearch();
+    protectLiveSearches();
+    preempt(*search);
+    changed.notify_all();
+    return result;
+}
+
+void GameScheduler::pause(int game) {
+    lock_guard<mutex> lock(schedulerMutex);
+    map<int, shared_ptr<Search> >::iterator entry = searches.find(game);
+    if (entry != searches.end()) {
+        entry->second->paused = true;
+    }
+    // Wakes a waiting worker to look after the new paused deadline
+    changed.notify_all();
+}
+
+void GameScheduler::resume(int game) {
+    lock_guard<mutex> lock(schedulerMutex);
+    map<int, shared_ptr<Search> >::iterator entry = searches.find(game);
+    if (entry != searches.end() && entry->second->paused) {
+        entry->second->paused = false;
+        preempt(*entry->second);
+        changed.notify_all();
+    }
+}
+
+void GameScheduler::extend(int game, double extra) {
+    lock_guard<mutex> lock(schedulerMutex);
+    map<int, shared_ptr<Search> >::iterator entry = searches.find(game);
+    if (entry != searches.end() && extra > 0.0) {
+        Search &search = *entry->second;
+        search.deadline += seconds(extra);
+        search.limit = max(search.limit, search.deadline);
+    }
+}
+
+void GameScheduler::stop(int game) {
+    lock_guard<mutex> lock(schedulerMutex);
+    map<int, shared_ptr<Search> >::iterator entry = searches.find(game);
+    if (entry != searches.end()) {
+        entry->second->interrupt = true;
+        entry->second->best.stopped = true;
+        finish(entry->second);
+    }
+}
+
+int GameScheduler::pending() {
+    lock_guard<mutex> lock(schedulerMutex);
+    return (int) searches.size();
+}
+
+void GameScheduler::worker() {
+    unique_lock<mutex> lock(schedulerMutex);
+    while (true) {
+        Clock::time_point now = Clock::now();
+        shared_ptr<Search> search = next(now);
+        if (!search) {
+            if (shuttingDown) {
+                return;
+            }
+            Clock::time_point wake = earliestPausedDeadline();
+            if (wake == Clock::time_point::max()) {
+                changed.wait(lock);
+            } else {
+                changed.wait_until(lock, wake);
+            }
+            continue;
+        }
+
+        search->running = true;
+        search->interrupt = false;
+        busy++;
+        int depth = search->best.depth + 1;
+        SearchControl control;
+        control.stopFlag = &search->interrupt;
+        // The first iteration takes next to no time and gives a real answer, so it always runs to the end
+        if (depth > 1) {
+            control.hasDeadline = true;
+            control.deadline = search->deadline;
+        }
+        EngineConfig iterationConfig = config;
+        iterationConfig.depth = depth;
+        lock.unlock();
+
+        Clock::time_point iterationStart = Clock::now();
+        ReversiCompetitionAgent agent(search->position.board, search->position.player, iterationConfig);
+        agent.setControl(&control);
+        vector<AnalysedMove> analysed = agent.analyse(1, table);
+        double iterationSeconds = chrono::duration<double>(Clock::now() - iterationStart).count();
+
+        lock.lock();
+        busy--;
+        search->running = false;
+        search->best.nodes += agent.nodes();
+        if (search->answered) {
+            continue;
+        }
+        now = Clock::now();
+        if (agent.stopped() || analysed.empty()) {
+            // Interrupted for a search with an earlier deadline, it goes back in line unless its time is up
+            if (now >= search->deadline) {
+                search->best.stopped = true;
+                finish(search);
+            }
+            continue;
+        }
+
+        bool moveChanged = search->best.depth > 0 && analysed[0].move != search->best.move;
+        search->best.move = analysed[0].move;
+        search->best.value = analysed[0].value;
+        search->best.pv = analysed[0].pv;
+        search->best.depth = depth;
+        search->previousIteration = search->lastIteration;
+        search->lastIteration = iterationSeconds;
+        if (depth >= search->lastDepth || !continueSearch(*search, moveChanged, now)) {
+            finish(search);
+        }
+    }
+}
+
+shared_ptr<GameScheduler::Search> GameScheduler::next(Clock::time_point now) {
+    vector<shared_ptr<Search> > expired;
+    shared_ptr<Search> earliest;
+    for (auto &entry: searches) {
+        const shared_ptr<Search> &search = entry.second;
+        if (search->running) {
+            continue;
+        }
+        // A search with no answer yet gets its first iteration even if it is late, that is still quicker
+        // than anything else it could do
+        if (now >= search->deadline && (search->best.depth > 0 || search->paused)) {
+            expired.push_back(search);
+        } else if (!search->paused && (!earliest || search->deadline < earliest->deadline)) {
+            earliest = search;
+        }
+    }
+    for (const shared_ptr<Search> &search: expired) {
+        finish(search);
+    }
+    return earliest;
+}
+
+bool GameScheduler::continueSearch(Search &search, bool moveChanged, Clock::time_point now) {
+    double growth = search.previousIteration > 0.0
+                    ? max(2.0, search.lastIteration / search.previousIteration) : DEFAULT_GROWTH;
+    Clock::time_point expected = now + seconds(search.lastIteration * growth);
+    if (expected <= search.deadline) {
+        return true;
+    }
+    if (!moveChanged || search.deadline >= search.limit) {
+        return false;
+    }
+    search.deadline = min(search.limit, search.deadline + seconds(search.slice * EXTENSION_STEP));
+    return expected <= search.deadline;
+}
+
+void GameScheduler::preempt(const Search &arrival) {
+    if (busy < (int) workers.size()) {
+        return;
+    }
+    Search *latest = NULL;
+    for (auto &entry: searches) {
+        Search &search = *entry.second;
+        if (search.running && !search.interrupt && (!latest || search.deadline > latest->deadline)) {
+            latest = &search;
+        }
+    }
+    if (latest && latest->deadline > arrival.deadline) {
+        latest->interrupt = true;
+    }
+}
+
+void GameScheduler::finish(const shared_ptr<Search> &search) {
+    search->answered = true;
+    search->best.seconds = chrono::duration<double>(Clock::now() - search->start).count();
+    search->result.set_value(search->best);
+    map<int, shared_ptr<Search> >::iterator entry = searches.find(search->game);
+    if (entry != searches.end() && entry->second == search) {
+        searches.erase(entry);
+        protectLiveSearches();
+    }
+    if (answered) {
+        answered();
+    }
+}
+
+void GameScheduler::protectLiveSearches() {
+    long long oldest = generations;
+    for (auto &entry: searches) {
+        oldest = min(oldest, entry.second->generation);
+    }
+    table.setConcurrentSearches((int) min(generations - oldest, 255LL));
+}
+
+GameScheduler::Clock::time_point GameScheduler::earliestPausedDeadline() const {
+    Clock::time_point earliest = Clock::time_point::max();
+    for (auto &entry: searches) {
+        if (entry.second->paused && !entry.second->running) {
+            earliest = min(earliest, entry.second->deadline);
+        }
+    }
+    return earliest;
+}
@@ -0,0 +1,155 @@
+#ifndef GAMESCHEDULER_H
+#define GAMESCHEDULER_H
+
+#include "engineconfig.h"
+#include "position.h"
+#include "searchengine.h"
+#include "transpositiontable.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Thinks for many games at once on a fixed number of threads and one shared transposition table.
+ *
+ * A search is a series of iterations, one depth each, and the iteration is the unit of scheduling: a free
+ * thread always takes the next iteration of the search whose deadline is earliest. A search is given its
+ * share of the game clock (EngineConfig::moveTime) as its time slice. The slice is extended while the best
+ * move keeps changing, up to a fixed multiple of it. A search whose slice runs out answers with the best
+ * move of its deepest finished iteration. A search with an earlier deadline that arrives while every thread
+ * is busy interrupts the running iteration with the latest deadline; the table keeps most of that
+ * iteration's work for when it is picked up again. Under load every search therefore gets fewer iterations,
+ * but none answers much later than its deadline.
+ *
+ * Each game has at most one search at a time, keyed by the caller's game id. Every search is a table
+ * generation of its own, and the entries of all the searches that have not answered are kept over shallower
+ * ones.
+ */
+class GameScheduler {
+public:
+    /**
+     * answered, if given, is called whenever a search answers, with the scheduler locked: it may only
+     * signal someone to collect the result, not call back into the scheduler
+     */
+    GameScheduler(const EngineConfig &config, int threads, size_t tableEntries = 1 << 22,
+                  const function<void()> &answered = function<void()>());
+
+    // Stops every search, each answers with what it has
+    ~GameScheduler();
+
+    /**
+     * Starts thinking about game's position with clock seconds left on its clock. A search still running
+     * for the same game is stopped and answers first.
+     */
+    future<SearchInfo> think(int game, const Position &position, double clock);
+
+    /**
+     * Parks the search after the iteration in progress. Its deadline keeps running: a search still
+     * paused when it passes answers with what it has.
+     */
+    void pause(int game);
+
+    void resume(int game);
+
+    /**
+     * Gives the search more time, from its next iteration on
+     */
+    void extend(int game, double seconds);
+
+    /**
+     * Makes the search answer now with the best move it has
+     */
+    void stop(int game);
+
+    /**
+     * Searches started and not answered yet
+     */
+    int pending();
+
+private:
+    typedef chrono::steady_clock Clock;
+
+    struct Search {
+        int game;
+        Position position;
+        promise<SearchInfo> result;
+        SearchInfo best;
+        Clock::time_point start;
+        Clock::time_point deadline;
+        // The slice is never extended past this
+        Clock::time_point limit;
+        double slice;
+        int lastDepth;
+        // Seconds the last two finished iterations took
+        double lastIteration;
+        double previousIteration;
+        bool paused;
+        bool running;
+        bool answered;
+        // Set to interrupt the iteration in progress
+        atomic<bool> interrupt;
+        // Table generations started before this search
+        long long generation;
+
+        Search(): slice(0.0), lastDepth(0), lastIteration(0.0), previousIteration(0.0), paused(false),
+                running(false), answered(false), interrupt(false), generation(0) {
+        }
+    };
+
+    EngineConfig config;
+    TranspositionTable table;
+    function<void()> answered;
+    mutex schedulerMutex;
+    condition_variable changed;
+    // Searches that have not answered yet. An iteration in progress holds on to its search, which may
+    // have answered and left the map by the time the iteration returns.
+    map<int, shared_ptr<Search> > searches;
+    long long generations;
+    bool shuttingDown;
+    int busy;
+    vector<thread> workers;
+
+    void worker();
+
+    /**
+     * The runnable search with the earliest deadline, NULL if none. Answers the searches whose
+     * deadline passed while they were waiting or paused on the way.
+     */
+    shared_ptr<Search> next(Clock::time_point now);
+
+    /**
+     * After an iteration: whether another one fits in the time left, extending the slice if the
+     * search is still changing its mind
+     */
+    bool continueSearch(Search &search, bool moveChanged, Clock::time_point now);
+
+    /**
+     * Interrupts the running iteration with the latest deadline if every thread is busy and it is
+     * later than arrival's
+     */
+    void preempt(const Search &arrival);
+
+    void finish(const shared_ptr<Search> &search);
+
+    /**
+     * Keeps the table entries of every generation since the oldest search that has not answered
+     */
+    void protectLiveSearches();
+
+    /**
+     * When the next paused search runs out of time, Clock::time_point::max() if none is paused
+     */
+    Clock::time_point earliestPausedDeadline() const;
+};
+
+#endif // GAMESCHEDULER_H
@@ -0,0 +1,72 @@
+#include "interleavedsearch.h"
+
+#include <algorithm>
+
+using namespace std;
+
+InterleavedSearch::InterleavedSearch(const EngineConfig &config, TranspositionTable &table, int width):
+        config(config), table(table), slots(max(1, width)), active(0), cursor(0) {
+    // Every search in flight keeps its entries, not just the one added last
+    table.setConcurrentSearches(this->width());
+}
+
+int InterleavedSearch::width() const {
+    return slots.size();
+}
+
+int InterleavedSearch::inFlight() const {
+    return active;
+}
+
+void InterleavedSearch::add(long long id, const Position &position) {
+    Slot *slot = NULL;
+    for (Slot &candidate: slots) {
+        if (!candidate.agent) {
+            slot = &candidate;
+            break;
+        }
+    }
+    EngineConfig positionConfig = config;
+    ReversiBoard board = position.board;
+    positionConfig.depth = EngineConfig::lastDepth(config.depth, popCount(board.blankBoard()));
+    slot->id = id;
+    slot->depth = positionConfig.depth;
+    slot->start = chrono::steady_clock::now();
+    table.newSearch();
+    slot->agent.reset(new ReversiCompetitionAgent(position.board, position.player, positionConfig));
+    slot->task = slot->agent->analyseInterleaved(1, table);
+    active++;
+}
+
+bool InterleavedSearch::next(long long &id, SearchInfo &info) {
+    if (active == 0) {
+        return false;
+    }
+    while (true) {
+        Slot &slot = slots[cursor];
+        cursor = (cursor + 1) % slots.size();
+        if (!slot.agent) {
+            continue;
+        }
+        slot.agent->resumeInterleaved();
+        if (!slot.task.done()) {
+            continue;
+        }
+
+        vector<AnalysedMove> &analysed = slot.task.result();
+        id = slot.id;
+        info = SearchInfo();
+        if (!analysed.empty()) {
+            info.move = analysed[0].move;
+            info.value = analysed[0].value;
+            info.pv = analysed[0].pv;
+            info.depth = slot.depth;
+        }
+        info.nodes = slot.agent->nodes();
+        info.seconds = chrono::duration<double>(chrono::steady_clock::now() - slot.start).count();
+        slot.task = SearchTask<vector<AnalysedMove> >();
+        slot.agent.reset();
+        active--;
+        return true;
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef INTERLEAVEDSEARCH_H
+#define INTERLEAVEDSEARCH_H
+
+#include "engineconfig.h"
+#include "position.h"
+#include "reversicompetitionagent.h"
+#include "searchengine.h"
+#include "transpositiontable.h"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Fixed depth table searches of several positions at once on the calling thread. Each search runs up to its
+ * next table probe, prefetches the slot and gives way to the next one in turn, so the slot has had the time
+ * of the other searches to arrive by the time it is probed. This hides the cache misses of a table larger
+ * than the cache without any more threads.
+ */
+class InterleavedSearch {
+public:
+    /**
+     * Up to width searches with the engine config, all to config.depth (capped by the empty squares)
+     */
+    InterleavedSearch(const EngineConfig &config, TranspositionTable &table, int width);
+
+    int width() const;
+
+    int inFlight() const;
+
+    /**
+     * Starts a search of position under id, which next() hands back with its result. Needs a free slot.
+     */
+    void add(long long id, const Position &position);
+
+    /**
+     * Runs the searches in flight in turn until one is done and returns it, false when there is none
+     */
+    bool next(long long &id, SearchInfo &info);
+
+private:
+    struct Slot {
+        long long id;
+        unique_ptr<ReversiCompetitionAgent> agent;
+        SearchTask<vector<AnalysedMove> > task;
+        int depth;
+        chrono::steady_clock::time_point start;
+    };
+
+    EngineConfig config;
+    TranspositionTable &table;
+    vector<Slot> slots;
+    int active;
+    // The slot to resume next
+    int cursor;
+};
+
+#endif // INTERLEAVEDSEARCH_H
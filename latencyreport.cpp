@@ -0,0 +1,320 @@
+#include "latencyreport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+static const char STATE_HEADER[] = "latency 1";
+
+LatencyStatistics::LatencyStatistics(): moves(0), sum(0.0), maximum(0.0), nearTimeouts(0), overruns(0),
+        buckets(BUCKETS, 0) {
+}
+
+void LatencyStatistics::add(double seconds, double budget) {
+    moves++;
+    sum += seconds;
+    maximum = max(maximum, seconds);
+    buckets[bucketOf(seconds)]++;
+    if (budget > 0.0) {
+        if (seconds > budget) {
+            overruns++;
+        } else if (seconds > NEAR_TIMEOUT * budget) {
+            nearTimeouts++;
+        }
+    }
+}
+
+void LatencyStatistics::merge(const LatencyStatistics &other) {
+    moves += other.moves;
+    sum += other.sum;
+    maximum = max(maximum, other.maximum);
+    nearTimeouts += other.nearTimeouts;
+    overruns += other.overruns;
+    for (int i = 0; i < BUCKETS; i++) {
+        buckets[i] += other.buckets[i];
+    }
+}
+
+double LatencyStatistics::mean() const {
+    return moves == 0 ? 0.0 : sum / moves;
+}
+
+double LatencyStatistics::percentile(double fraction) const {
+    if (moves == 0) {
+        return 0.0;
+    }
+    long long rank = max(1LL, (long long) ceil(fraction * moves));
+    long long seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return min(bucketLimit(i), maximum);
+        }
+    }
+    return maximum;
+}
+
+int LatencyStatistics::bucketOf(double seconds) {
+    long long micros = (long long) max(0.0, min(seconds * 1e6, 1e12));
+    // Exact below two sub bucket ranges, then SUB_BUCKETS per doubling
+    if (micros < 2 * SUB_BUCKETS) {
+        return (int) micros;
+    }
+    int shift = 63 - __builtin_clzll(micros) - 4;
+    return min(BUCKETS - 1, shift * SUB_BUCKETS + (int) (micros >> shift));
+}
+
+double LatencyStatistics::bucketLimit(int bucket) {
+    if (bucket < 2 * SUB_BUCKETS) {
+        return (bucket + 1) * 1e-6;
+    }
+    int shift = bucket / SUB_BUCKETS - 1;
+    long long mantissa = bucket % SUB_BUCKETS + SUB_BUCKETS;
+    return (double) ((mantissa + 1) << shift) * 1e-6;
+}
+
+void LatencyReport::record(const string &engine, int empties, double seconds, double budget) {
+    vector<LatencyStatistics> &phases = engines[engine];
+    phases.resize(PHASES);
+    phases[phaseOf(empties)].add(seconds, budget);
+}
+
+void LatencyReport::merge(const LatencyReport &other) {
+    for (const auto &engine: other.engines) {
+        vector<LatencyStatistics> &phases = engines[engine.first];
+        phases.resize(PHASES);
+        for (int i = 0; i < PHASES; i++) {
+            phases[i].merge(engine.second[i]);
+        }
+    }
+}
+
+bool LatencyReport::empty() const {
+    return engines.empty();
+}
+
+int LatencyReport::phaseOf(int empties) {
+    return min(PHASES - 1, max(0, (empties - 1) / PHASE_EMPTIES));
+}
+
+string LatencyReport::phaseName(int phase) {
+    return to_string(phase * PHASE_EMPTIES + 1) + "-" + to_string((phase + 1) * PHASE_EMPTIES);
+}
+
+string LatencyReport::exportPath(const string &path, const string &extension) {
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of('/');
+    if (dot == string::npos || (slash != string::npos && dot < slash)) {
+        return path + extension;
+    }
+    return path.substr(0, dot) + extension;
+}
+
+LatencyStatistics LatencyReport::overall(const vector<LatencyStatistics> &phases) {
+    LatencyStatistics all;
+    for (const LatencyStatistics &phase: phases) {
+        all.merge(phase);
+    }
+    return all;
+}
+
+bool LatencyReport::load(const string &path) {
+    ifstream stateFile(path.c_str());
+    if (!stateFile.is_open()) {
+        return true;
+    }
+    string line;
+    if (!getline(stateFile, line) || line != STATE_HEADER) {
+        cout << "Not a latency report: " << path << endl;
+        return false;
+    }
+    LatencyReport loaded;
+    vector<LatencyStatistics> *phases = NULL;
+    int lineNumber = 1;
+    while (getline(stateFile, line)) {
+        lineNumber++;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (line.compare(0, 7, "engine ") == 0) {
+            phases = &loaded.engines[line.substr(7)];
+            phases->resize(PHASES);
+            continue;
+        }
+        // phase <phase> <moves> <sum> <max> <near timeouts> <overruns> <bucket>:<count> ...
+        istringstream fields(line);
+        string keyword;
+        int phase = -1;
+        LatencyStatistics statistics;
+        fields >> keyword >> phase >> statistics.moves >> statistics.sum >> statistics.maximum
+               >> statistics.nearTimeouts >> statistics.overruns;
+        bool valid = fields && keyword == "phase" && phase >= 0 && phase < PHASES && phases != NULL;
+        long long counted = 0;
+        string bucketCount;
+        while (valid && fields >> bucketCount) {
+            int bucket = -1;
+            long long count = 0;
+            valid = sscanf(bucketCount.c_str(), "%d:%lld", &bucket, &count) == 2 && bucket >= 0 &&
+                    bucket < LatencyStatistics::BUCKETS && count > 0;
+            if (valid) {
+                statistics.buckets[bucket] += count;
+                counted += count;
+            }
+        }
+        if (!valid || counted != statistics.moves) {
+            cout << "Invalid latency report line " << lineNumber << " in " << path << endl;
+            return false;
+        }
+        (*phases)[phase].merge(statistics);
+    }
+    merge(loaded);
+    return true;
+}
+
+bool LatencyReport::save(const string &path) const {
+    // Written next to the state file and renamed over it, so an interruption never leaves half a file
+    string temporaryPath = path + ".tmp";
+    ofstream stateFile(temporaryPath.c_str());
+    if (!stateFile.is_open()) {
+        cout << "Failed to write latency report to: " << temporaryPath << endl;
+        return false;
+    }
+    stateFile << STATE_HEADER << endl;
+    stateFile << "# phase <phase> <moves> <sum> <max> <near timeouts> <overruns> <bucket>:<count> ..." << endl;
+    stateFile << setprecision(17);
+    for (const auto &engine: engines) {
+        stateFile << "engine " << engine.first << endl;
+        for (int phase = 0; phase < PHASES; phase++) {
+            const LatencyStatistics &statistics = engine.second[phase];
+            if (statistics.moves == 0) {
+                continue;
+            }
+            stateFile << "phase " << phase << ' ' << statistics.moves << ' ' << statistics.sum << ' '
+                      << statistics.maximum << ' ' << statistics.nearTimeouts << ' ' << statistics.overruns;
+            for (int i = 0; i < LatencyStatistics::BUCKETS; i++) {
+                if (statistics.buckets[i]) {
+                    stateFile << ' ' << i << ':' << statistics.buckets[i];
+                }
+            }
+            stateFile << endl;
+        }
+    }
+    stateFile.close();
+    if (!stateFile || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        cout << "Failed to write latency report to: " << path << endl;
+        return false;
+    }
+    return writeCsv(exportPath(path, ".csv")) && writeJson(exportPath(path, ".json"));
+}
+
+// Engine specs contain commas, so they are always quoted
+static string csvQuote(const string &value) {
+    string quoted = "\"";
+    for (char c: value) {
+        quoted += c;
+        if (c == '"') {
+            quoted += '"';
+        }
+    }
+    return quoted + "\"";
+}
+
+static string jsonQuote(const string &value) {
+    string quoted = "\"";
+    for (char c: value) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if ((unsigned char) c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            quoted += escaped;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+bool LatencyReport::writeCsv(const string &path) const {
+    ofstream csvFile(path.c_str());
+    if (!csvFile.is_open()) {
+        cout << "Couldn't open file: " << path << endl;
+        return false;
+    }
+    csvFile << fixed << setprecision(6);
+    csvFile << "engine,phase,moves,mean,p50,p90,p99,max,near_timeouts,overruns" << endl;
+    for (const auto &engine: engines) {
+        for (int phase = -1; phase < PHASES; phase++) {
+            // The whole game first, as phase "all"
+            LatencyStatistics statistics = phase < 0 ? overall(engine.second) : engine.second[phase];
+            if (phase >= 0 && statistics.moves == 0) {
+                continue;
+            }
+            csvFile << csvQuote(engine.first) << ',' << (phase < 0 ? "all" : phaseName(phase)) << ','
+                    << statistics.moves << ',' << statistics.mean() << ',' << statistics.percentile(0.5) << ','
+                    << statistics.percentile(0.9) << ',' << statistics.percentile(0.99) << ',' << statistics.maximum
+                    << ',' << statistics.nearTimeouts << ',' << statistics.overruns << endl;
+        }
+    }
+    return true;
+}
+
+bool LatencyReport::writeJson(const string &path) const {
+    ofstream jsonFile(path.c_str());
+    if (!jsonFile.is_open()) {
+        cout << "Couldn't open file: " << path << endl;
+        return false;
+    }
+    jsonFile << fixed << setprecision(6);
+    jsonFile << "{\"near_timeout\": " << LatencyStatistics::NEAR_TIMEOUT << ", \"engines\": [";
+    bool firstEngine = true;
+    for (const auto &engine: engines) {
+        jsonFile << (firstEngine ? "" : ",") << endl << "  {\"engine\": " << jsonQuote(engine.first)
+                 << ", \"phases\": [";
+        firstEngine = false;
+        bool firstPhase = true;
+        for (int phase = -1; phase < PHASES; phase++) {
+            LatencyStatistics statistics = phase < 0 ? overall(engine.second) : engine.second[phase];
+            if (phase >= 0 && statistics.moves == 0) {
+                continue;
+            }
+            jsonFile << (firstPhase ? "" : ",") << endl << "    {\"phase\": "
+                     << jsonQuote(phase < 0 ? "all" : phaseName(phase)) << ", \"moves\": " << statistics.moves
+                     << ", \"mean\": " << statistics.mean() << ", \"p50\": " << statistics.percentile(0.5)
+                     << ", \"p90\": " << statistics.percentile(0.9) << ", \"p99\": " << statistics.percentile(0.99)
+                     << ", \"max\": " << statistics.maximum << ", \"near_timeouts\": " << statistics.nearTimeouts
+                     << ", \"overruns\": " << statistics.overruns << "}";
+            firstPhase = false;
+        }
+        jsonFile << "]}";
+    }
+    jsonFile << endl << "]}" << endl;
+    return true;
+}
+
+string LatencyReport::summary() const {
+    ostringstream ss;
+    ss << fixed << setprecision(3);
+    for (const auto &engine: engines) {
+        ss << "Move times (ms) of " << engine.first << endl;
+        ss << "Empties\tMoves\tp50\tp90\tp99\tMax\tNear\tOver" << endl;
+        for (int phase = -1; phase < PHASES; phase++) {
+            LatencyStatistics statistics = phase < 0 ? overall(engine.second) : engine.second[phase];
+            if (phase >= 0 && statistics.moves == 0) {
+                continue;
+            }
+            ss << (phase < 0 ? "all" : phaseName(phase)) << '\t' << statistics.moves << '\t'
+               << statistics.percentile(0.5) * 1e3 << '\t' << statistics.percentile(0.9) * 1e3 << '\t'
+               << statistics.percentile(0.99) * 1e3 << '\t' << statistics.maximum * 1e3 << '\t'
+               << statistics.nearTimeouts << '\t' << statistics.overruns << endl;
+        }
+    }
+    return ss.str();
+}
@@ -0,0 +1,109 @@
+#ifndef LATENCYREPORT_H
+#define LATENCYREPORT_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Where the server and self-play matches keep their move latencies unless told otherwise
+static const char DEFAULT_LATENCY_REPORT[] = "latency.state";
+
+/**
+ * Move times of one engine in one game phase: a histogram with 16 buckets per doubling from a microsecond
+ * up, so every percentile is within 1/16 of the true value, and the moves that came close to or went over
+ * the time they were given.
+ */
+class LatencyStatistics {
+public:
+    static const int SUB_BUCKETS = 16;
+    static const int BUCKETS = 40 * SUB_BUCKETS;
+    // A move that takes more than this share of its time is near a timeout
+    static constexpr double NEAR_TIMEOUT = 0.9;
+
+    long long moves;
+    double sum;
+    double maximum;
+    long long nearTimeouts;
+    long long overruns;
+    vector<long long> buckets;
+
+    LatencyStatistics();
+
+    /**
+     * A move that took seconds out of a budget of the given seconds, 0 if it had no budget
+     */
+    void add(double seconds, double budget);
+
+    void merge(const LatencyStatistics &other);
+
+    double mean() const;
+
+    /**
+     * Seconds that the given fraction of the moves took at most, 0 without moves
+     */
+    double percentile(double fraction) const;
+
+    static int bucketOf(double seconds);
+
+    // Upper end of the bucket in seconds
+    static double bucketLimit(int bucket);
+};
+
+/**
+ * Move latencies per engine configuration and game phase (by empty squares), merged across every match that
+ * used the same report. The report is kept in a text state file and exported as CSV and JSON for dashboards
+ * and alerts.
+ */
+class LatencyReport {
+public:
+    // Phases are bands of this many empty squares, the last phase starting at 51 empties
+    static const int PHASE_EMPTIES = 10;
+    static const int PHASES = 6;
+
+    void record(const string &engine, int empties, double seconds, double budget);
+
+    void merge(const LatencyReport &other);
+
+    bool empty() const;
+
+    /**
+     * Adds the report in path to this one. A missing file is an empty report, a malformed one is reported
+     * and returns false.
+     */
+    bool load(const string &path);
+
+    /**
+     * Writes the state to path and the CSV and JSON exports next to it
+     */
+    bool save(const string &path) const;
+
+    bool writeCsv(const string &path) const;
+
+    bool writeJson(const string &path) const;
+
+    /**
+     * Table of every engine and phase for the console
+     */
+    string summary() const;
+
+    static int phaseOf(int empties);
+
+    // "1-10" up to "51-60"
+    static string phaseName(int phase);
+
+    /**
+     * path with its extension replaced by the given one, e.g. latency.state to latency.csv
+     */
+    static string exportPath(const string &path, const string &extension);
+
+private:
+    // Engine spec to its phases
+    map<string, vector<LatencyStatistics> > engines;
+
+    // Every phase of an engine merged
+    static LatencyStatistics overall(const vector<LatencyStatistics> &phases);
+};
+
+#endif // LATENCYREPORT_H
@@ -0,0 +1,113 @@
+#include "libreversi.h"
+
+#include "endgame.h"
+#include "searchengine.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+// Kept across searches for either colour, its table keys entries on the root side
+struct reversi_engine {
+    SearchEngine search;
+
+    explicit reversi_engine(const EngineConfig &config): search(config) {
+    }
+};
+
+static bool validSquare(int square) {
+    return 0 <= square && square < NO_OF_SQUARES;
+}
+
+int reversi_api_version(void) {
+    return REVERSI_API_VERSION;
+}
+
+void reversi_initial_position(uint64_t *black, uint64_t *white) {
+    *black = ReversiBoard::INITIAL_POSITION_BLACK;
+    *white = ReversiBoard::INITIAL_POSITION_WHITE;
+}
+
+uint64_t reversi_legal_moves(uint64_t own, uint64_t opponent) {
+    return generateMoves(own, opponent);
+}
+
+uint64_t reversi_flips(uint64_t own, uint64_t opponent, int square) {
+    if (!validSquare(square) || ((own | opponent) & squareBit(square))) {
+        return 0;
+    }
+    ReversiBoard board(own, opponent);
+    return board.flips(ReversiBoard::BLACK, (Square) square);
+}
+
+uint64_t reversi_make_move(uint64_t *own, uint64_t *opponent, int square) {
+    ullint flipped = reversi_flips(*own, *opponent, square);
+    if (flipped) {
+        *own |= flipped | squareBit(square);
+        *opponent &= ~flipped;
+    }
+    return flipped;
+}
+
+int reversi_count(uint64_t discs) {
+    return popCount(discs);
+}
+
+reversi_engine *reversi_engine_new(const char *spec) {
+    EngineConfig config;
+    config.name = "libreversi";
+    if (spec && *spec && !EngineConfig::parseAlphaBeta(spec, config)) {
+        return NULL;
+    }
+    return new reversi_engine(config);
+}
+
+void reversi_engine_free(reversi_engine *engine) {
+    delete engine;
+}
+
+int reversi_search(reversi_engine *engine, uint64_t black, uint64_t white, int player, int depth, double seconds,
+                   long long nodes, reversi_search_result *result) {
+    if (!engine || !result || (player != REVERSI_BLACK && player != REVERSI_WHITE) || (black & white)) {
+        return -1;
+    }
+    SearchLimits limits;
+    limits.depth = max(0, depth);
+    limits.time = max(0.0, seconds);
+    limits.nodes = max(0LL, nodes);
+    SearchInfo info = engine->search.start(Position(ReversiBoard(black, white), player), limits).get();
+
+    memset(result, 0, sizeof(*result));
+    result->move = info.move;
+    result->value = info.value;
+    result->depth = info.depth;
+    result->nodes = info.nodes;
+    result->seconds = info.seconds;
+    result->stopped = info.stopped;
+    result->pv_length = (int) min(info.pv.size(), (size_t) NO_OF_SQUARES);
+    for (int i = 0; i < result->pv_length; i++) {
+        result->pv[i] = info.pv[i];
+    }
+    return 0;
+}
+
+void reversi_engine_stop(reversi_engine *engine) {
+    if (engine) {
+        engine->search.stop();
+    }
+}
+
+int reversi_solve(uint64_t black, uint64_t white, int player, int *value, int *move) {
+    if (!value || (player != REVERSI_BLACK && player != REVERSI_WHITE) || (black & white)
+            || NO_OF_SQUARES - popCount(black | white) > REVERSI_SOLVE_MAX_EMPTIES) {
+        return -1;
+    }
+    EndgameSolver solver;
+    ReversiBoard board(black, white);
+    Square best = solver.bestMove(board, player, *value);
+    if (move) {
+        *move = best;
+    }
+    return 0;
+}
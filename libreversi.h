@@ -0,0 +1,102 @@
+#ifndef LIBREVERSI_H
+#define LIBREVERSI_H
+
+/*
+ * C interface of libreversi, for callers that are not C++ (the Python drivers load it with ctypes).
+ *
+ * Boards are two 64 bit masks, one per colour, with a1 in the most significant bit: square s = row * 8 + column
+ * (a1 = 0, h8 = 63) is bit 63 - s. Moves are square numbers, REVERSI_PASS when there is none. Players are
+ * REVERSI_BLACK (X) and REVERSI_WHITE (O).
+ *
+ * The board functions are pure. Engines keep their own transposition table, so independent engines may be
+ * used from different threads at the same time; a single engine is for one search at a time, apart from
+ * reversi_engine_stop which may be called from anywhere. An engine may search for both colours in turn, its
+ * table keys entries on the side to move at the root.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The library is built with hidden visibility, only these functions are exported */
+#define REVERSI_EXPORT __attribute__((visibility("default")))
+
+/* Bumped whenever a signature or struct below changes */
+#define REVERSI_API_VERSION 2
+
+#define REVERSI_BLACK 0
+#define REVERSI_WHITE 1
+#define REVERSI_PASS 64
+/* reversi_solve refuses positions with more empty squares than this, they take far too long */
+#define REVERSI_SOLVE_MAX_EMPTIES 16
+
+typedef struct reversi_engine reversi_engine;
+
+typedef struct reversi_search_result {
+    int move;
+    double value;
+    /* Deepest completed iteration */
+    int depth;
+    long long nodes;
+    double seconds;
+    /* Non-zero when stopped or cut short by a limit */
+    int stopped;
+    int pv_length;
+    int pv[64];
+} reversi_search_result;
+
+REVERSI_EXPORT int reversi_api_version(void);
+
+REVERSI_EXPORT void reversi_initial_position(uint64_t *black, uint64_t *white);
+
+REVERSI_EXPORT uint64_t reversi_legal_moves(uint64_t own, uint64_t opponent);
+
+/*
+ * Discs own would flip by playing square, 0 if the move is illegal
+ */
+REVERSI_EXPORT uint64_t reversi_flips(uint64_t own, uint64_t opponent, int square);
+
+/*
+ * Plays square for own, updating both masks, and returns the flipped discs. An illegal move changes
+ * nothing and returns 0.
+ */
+REVERSI_EXPORT uint64_t reversi_make_move(uint64_t *own, uint64_t *opponent, int square);
+
+REVERSI_EXPORT int reversi_count(uint64_t discs);
+
+/*
+ * New engine from a spec in the EngineConfig format ("depth=6,prune=1"), NULL or "" for the defaults.
+ * Returns NULL if the spec is invalid or asks for algorithm=mcts, which only the match tools play.
+ */
+REVERSI_EXPORT reversi_engine *reversi_engine_new(const char *spec);
+
+REVERSI_EXPORT void reversi_engine_free(reversi_engine *engine);
+
+/*
+ * Iterative deepening search of the position, blocking until it is done. depth, seconds and nodes limit it
+ * when positive. Returns 0 on success, -1 for an invalid argument.
+ */
+REVERSI_EXPORT int reversi_search(reversi_engine *engine, uint64_t black, uint64_t white, int player, int depth,
+                                  double seconds, long long nodes, reversi_search_result *result);
+
+/*
+ * Makes the search in progress on engine return early, with the best move of its deepest finished iteration.
+ * Does nothing when no search is in progress, so a stop that comes after reversi_search returned never cuts
+ * the next search short.
+ */
+REVERSI_EXPORT void reversi_engine_stop(reversi_engine *engine);
+
+/*
+ * Exact final disc difference for player with perfect play from here in *value, and a move that achieves it in
+ * *move when move is not NULL. Returns 0 on success, -1 for an invalid argument or a position with more than
+ * REVERSI_SOLVE_MAX_EMPTIES empty squares.
+ */
+REVERSI_EXPORT int reversi_solve(uint64_t black, uint64_t white, int player, int *value, int *move);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBREVERSI_H */
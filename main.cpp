@@ -1,12 +1,30 @@
 #include <iostream>
 #include <fstream>
 
+#include "batch.h"
+#include "movedaemon.h"
+#include "profiler.h"
 #include "reversihwagent.h"
 #include "reversicompetitionagent.h"
 
 using namespace std;
 
 int main(int argc, char **argv) {
+    if (argc > 1 && string(argv[1]) == "batch") {
+        // Many positions in one process: agent batch depth=6 threads=8 < positions.txt > results.txt
+        return runBatch(argc - 2, argv + 2);
+    }
+    if (argc > 1 && string(argv[1]) == "serve") {
+        // Moves for many clients at once: agent serve socket=/tmp/reversi.sock threads=4
+        return runDaemon(argc - 2, argv + 2);
+    }
+    string binaryTracePath;
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--trace-binary" && i + 1 < argc) {
+            binaryTracePath = argv[++i];
+        }
+    }
+
     ifstream inputFile("input.txt");
     if(!inputFile.is_open()) {
         cout << "Couldn't open file: input.txt" << endl;
@@ -22,7 +40,7 @@ int main(int argc, char **argv) {
 
     char opponent = (player == 'X'? 'O': 'X');
 
-    if (1 <= task <= 3) {
+    if (1 <= task && task <= 3) {
         inputFile >> cutoffDepth;
     } else {
         inputFile >> cpuTime;
@@ -39,11 +57,22 @@ int main(int argc, char **argv) {
     }
 
     if (1 <= task && task <= 3) {
+        // Greedy, MiniMax and AlphaBeta
+        ReversiHWAgent reversiAgent(cutoffDepth, board, player, opponent, task);
+        if (!binaryTracePath.empty()) {
+            reversiAgent.setBinaryTrace(binaryTracePath);
+        }
+        reversiAgent.play();
     } else if (task == 4) {
         // Competition
         ReversiCompetitionAgent reversiAgent(board, player, opponent, cpuTime);
         reversiAgent.play();
+    } else if (task == 5) {
+        // Analysis: every legal move with its score and expected line, best first
+        ReversiCompetitionAgent reversiAgent(board, player, opponent, cpuTime);
+        reversiAgent.writeAnalysis(reversiAgent.analyse());
     }
+    PROFILE_REPORT(cerr);
 
     return 0;
 }
@@ -0,0 +1,326 @@
+#include "mctsengine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <thread>
+
+using namespace std;
+
+// Weight of the exploration term of UCT, for results between 0 and 1
+static const double EXPLORATION = 1.0;
+// Playouts between looks at the clock
+static const int CLOCK_INTERVAL = 64;
+// No Reversi position has more moves, so a playout adds at most this many nodes to the tree
+static const long long MOST_MOVES = 33;
+
+static inline uint64_t nextRandom(uint64_t &state) {
+    // xorshift64*
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * A uniformly random square of moves, which must not be empty
+ */
+static inline Square randomSquare(ullint moves, uint64_t &random) {
+    uint32_t skip = (uint32_t) (((nextRandom(random) >> 32) * (uint64_t) popCount(moves)) >> 32);
+    for (uint32_t i = 0; i < skip; i++) {
+        moves &= moves - 1;
+    }
+    return lastSquare(moves);
+}
+
+MctsEngine::MctsEngine(const EngineConfig &config): config(config),
+        capacity((size_t) max(1024LL, min((long long) config.treeNodes, config.playouts * MOST_MOVES))),
+        pool(new MctsNode[capacity]), spare(new MctsNode[capacity]), nextFree(0), rootPlayer(0), hasTree(false),
+        playoutsStarted(0), stopRequested(false) {
+}
+
+void MctsEngine::stop() {
+    stopRequested = true;
+}
+
+size_t MctsEngine::treeSize() const {
+    return hasTree ? min((size_t) nextFree.load(), capacity) : 0;
+}
+
+static void clearNode(MctsNode &node, Square move) {
+    node.firstChild.store(0, memory_order_relaxed);
+    node.visits.store(0, memory_order_relaxed);
+    node.wins.store(0, memory_order_relaxed);
+    node.virtualLoss.store(0, memory_order_relaxed);
+    node.children = 0;
+    node.move = move;
+}
+
+void MctsEngine::resetTree(const ReversiBoard &board, int player) {
+    clearNode(pool[ROOT], SQUARE_NONE);
+    nextFree = ROOT + 1;
+    rootBoard = board;
+    rootPlayer = player;
+    hasTree = true;
+}
+
+static bool sameBoard(const ReversiBoard &a, const ReversiBoard &b) {
+    return a.pieces[ReversiBoard::BLACK] == b.pieces[ReversiBoard::BLACK]
+           && a.pieces[ReversiBoard::WHITE] == b.pieces[ReversiBoard::WHITE];
+}
+
+bool MctsEngine::reuseTree(const ReversiBoard &board, int player) {
+    if (sameBoard(board, rootBoard) && player == rootPlayer) {
+        return true;
+    }
+    // Breadth first over the first two plies, the usual case being one move by each side
+    vector<pair<uint32_t, ReversiBoard> > level(1, make_pair(ROOT, rootBoard));
+    int levelPlayer = rootPlayer;
+    for (int ply = 0; ply < 2; ply++) {
+        vector<pair<uint32_t, ReversiBoard> > next;
+        for (const pair<uint32_t, ReversiBoard> &entry: level) {
+            const MctsNode &node = pool[entry.first];
+            uint32_t first = node.firstChild.load(memory_order_relaxed);
+            if (first == NO_CHILDREN || first >= TERMINAL) {
+                continue;
+            }
+            for (uint32_t child = first; child < first + node.children; child++) {
+                ReversiBoard childBoard = entry.second;
+                childBoard.makeMove(levelPlayer, pool[child].move);
+                if (sameBoard(childBoard, board) && 1 - levelPlayer == player) {
+                    compact(child);
+                    rootBoard = board;
+                    rootPlayer = player;
+                    return true;
+                }
+                next.push_back(make_pair(child, childBoard));
+            }
+        }
+        level.swap(next);
+        levelPlayer = 1 - levelPlayer;
+    }
+    return false;
+}
+
+void MctsEngine::compact(uint32_t newRoot) {
+    // Breadth first, so each block of children stays together and comes after its parent
+    deque<pair<uint32_t, uint32_t> > queue;
+    MctsNode &root = spare[ROOT];
+    clearNode(root, SQUARE_NONE);
+    root.visits.store(pool[newRoot].visits.load(memory_order_relaxed), memory_order_relaxed);
+    root.wins.store(pool[newRoot].wins.load(memory_order_relaxed), memory_order_relaxed);
+    queue.push_back(make_pair(newRoot, ROOT));
+    uint32_t used = ROOT + 1;
+    while (!queue.empty()) {
+        const MctsNode &from = pool[queue.front().first];
+        MctsNode &to = spare[queue.front().second];
+        queue.pop_front();
+        uint32_t first = from.firstChild.load(memory_order_relaxed);
+        if (first == NO_CHILDREN || first >= TERMINAL) {
+            // A node left half expanded by a stopped search starts over
+            to.firstChild.store(first == TERMINAL ? TERMINAL : NO_CHILDREN, memory_order_relaxed);
+            continue;
+        }
+        to.children = from.children;
+        to.firstChild.store(used, memory_order_relaxed);
+        for (uint32_t i = 0; i < from.children; i++) {
+            const MctsNode &child = pool[first + i];
+            MctsNode &copy = spare[used + i];
+            clearNode(copy, child.move);
+            copy.visits.store(child.visits.load(memory_order_relaxed), memory_order_relaxed);
+            copy.wins.store(child.wins.load(memory_order_relaxed), memory_order_relaxed);
+            queue.push_back(make_pair(first + i, used + i));
+        }
+        used += from.children;
+    }
+    pool.swap(spare);
+    nextFree = used;
+}
+
+SearchInfo MctsEngine::search(const ReversiBoard &board, int player, const SearchLimits &limits) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    stopRequested = false;
+    if (!hasTree || !reuseTree(board, player)) {
+        resetTree(board, player);
+    }
+
+    long long budget = limits.nodes > 0 ? limits.nodes : config.playouts;
+    bool hasDeadline = limits.time > 0;
+    chrono::steady_clock::time_point deadline = start + chrono::duration_cast<chrono::steady_clock::duration>(
+            chrono::duration<double>(limits.time));
+    playoutsStarted = 0;
+
+    uint64_t seed = (uint64_t) start.time_since_epoch().count() | 1;
+    vector<thread> helpers;
+    for (int i = 1; i < config.threads; i++) {
+        helpers.push_back(thread(&MctsEngine::worker, this, budget, hasDeadline, deadline,
+                                 seed * (2 * i + 1) + 0x9E3779B97F4A7C15ULL * i));
+    }
+    worker(budget, hasDeadline, deadline, seed);
+    for (thread &helper: helpers) {
+        helper.join();
+    }
+
+    SearchInfo info;
+    info.nodes = min(playoutsStarted.load(), budget);
+    info.stopped = stopRequested || info.nodes < budget;
+    // The principal variation follows the most visited child down the tree
+    uint32_t index = ROOT;
+    while (true) {
+        const MctsNode &node = pool[index];
+        uint32_t first = node.firstChild.load(memory_order_relaxed);
+        if (first == NO_CHILDREN || first >= TERMINAL) {
+            break;
+        }
+        uint32_t best = first;
+        for (uint32_t child = first + 1; child < first + node.children; child++) {
+            if (pool[child].visits.load(memory_order_relaxed) > pool[best].visits.load(memory_order_relaxed)) {
+                best = child;
+            }
+        }
+        uint32_t visits = pool[best].visits.load(memory_order_relaxed);
+        if (!visits) {
+            break;
+        }
+        if (index == ROOT) {
+            info.move = pool[best].move;
+            info.value = pool[best].wins.load(memory_order_relaxed) / (2.0 * visits);
+        }
+        info.pv.push_back(pool[best].move);
+        index = best;
+    }
+    info.depth = (int) info.pv.size();
+    info.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return info;
+}
+
+void MctsEngine::worker(long long budget, bool hasDeadline, chrono::steady_clock::time_point deadline,
+                        uint64_t seed) {
+    uint64_t random = seed ? seed : 1;
+    vector<uint32_t> path;
+    path.reserve(NO_OF_SQUARES + 2);
+    for (long long done = 0; !stopRequested.load(memory_order_relaxed); done++) {
+        if (hasDeadline && done % CLOCK_INTERVAL == 0 && chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+        if (playoutsStarted.fetch_add(1, memory_order_relaxed) >= budget) {
+            break;
+        }
+        iterate(random, path);
+    }
+}
+
+void MctsEngine::iterate(uint64_t &random, vector<uint32_t> &path) {
+    ReversiBoard board = rootBoard;
+    int player = rootPlayer;
+    uint32_t index = ROOT;
+    path.clear();
+
+    while (true) {
+        MctsNode &node = pool[index];
+        uint32_t first = node.firstChild.load(memory_order_acquire);
+        if (first == NO_CHILDREN) {
+            // A leaf grows once it has been played out from, except the root which is needed to choose a move
+            if (index != ROOT && !node.visits.load(memory_order_relaxed)) {
+                break;
+            }
+            if (!expand(node, board, player)) {
+                break;
+            }
+            first = node.firstChild.load(memory_order_acquire);
+        }
+        if (first >= TERMINAL) {
+            break;
+        }
+        index = select(node);
+        MctsNode &child = pool[index];
+        child.virtualLoss.fetch_add(1, memory_order_relaxed);
+        board.makeMove(player, child.move);
+        player = 1 - player;
+        path.push_back(index);
+    }
+
+    int difference = playout(board, player, random);
+    // The last node of the path was reached by a move of the other side
+    for (size_t i = path.size(); i-- > 0;) {
+        MctsNode &node = pool[path[i]];
+        difference = -difference;
+        node.wins.fetch_add(difference > 0 ? 2 : difference == 0 ? 1 : 0, memory_order_relaxed);
+        node.visits.fetch_add(1, memory_order_relaxed);
+        node.virtualLoss.fetch_sub(1, memory_order_relaxed);
+    }
+    pool[ROOT].visits.fetch_add(1, memory_order_relaxed);
+}
+
+bool MctsEngine::expand(MctsNode &node, ReversiBoard &board, int player) {
+    ullint moves = generateMoves(board.pieces[player], board.pieces[1 - player]);
+    uint32_t count = moves ? popCount(moves) : 1;
+    // Once the pool is full the leaves stay leaves, checked first so the counter cannot run away
+    if (nextFree.load(memory_order_relaxed) + count > capacity) {
+        return false;
+    }
+    uint32_t expected = NO_CHILDREN;
+    if (!node.firstChild.compare_exchange_strong(expected, EXPANDING, memory_order_acquire)) {
+        // Somebody else is expanding it, or has just finished
+        return expected != EXPANDING;
+    }
+    if (!moves && !generateMoves(board.pieces[1 - player], board.pieces[player])) {
+        node.firstChild.store(TERMINAL, memory_order_release);
+        return true;
+    }
+    uint32_t first = nextFree.fetch_add(count, memory_order_relaxed);
+    if (first + count > capacity) {
+        node.firstChild.store(NO_CHILDREN, memory_order_release);
+        return false;
+    }
+    if (moves) {
+        for (uint32_t i = 0; i < count; i++) {
+            clearNode(pool[first + i], popFirstSquare(moves));
+        }
+    } else {
+        clearNode(pool[first], SQUARE_PASS);
+    }
+    node.children = (uint8_t) count;
+    node.firstChild.store(first, memory_order_release);
+    return true;
+}
+
+uint32_t MctsEngine::select(const MctsNode &node) const {
+    uint32_t first = node.firstChild.load(memory_order_relaxed);
+    double parentVisits = node.visits.load(memory_order_relaxed) + node.virtualLoss.load(memory_order_relaxed) + 1;
+    double logVisits = log(parentVisits);
+    uint32_t best = first;
+    double bestScore = -1.0;
+    for (uint32_t child = first; child < first + node.children; child++) {
+        const MctsNode &candidate = pool[child];
+        // A thread below a node counts as a visit that lost, so the others look elsewhere
+        uint32_t visits = candidate.visits.load(memory_order_relaxed)
+                          + candidate.virtualLoss.load(memory_order_relaxed);
+        if (!visits) {
+            return child;
+        }
+        double score = candidate.wins.load(memory_order_relaxed) / (2.0 * visits)
+                       + EXPLORATION * sqrt(logVisits / visits);
+        if (score > bestScore) {
+            bestScore = score;
+            best = child;
+        }
+    }
+    return best;
+}
+
+int MctsEngine::playout(ReversiBoard board, int player, uint64_t &random) {
+    int mover = player;
+    int passes = 0;
+    while (passes < 2) {
+        ullint moves = generateMoves(board.pieces[mover], board.pieces[1 - mover]);
+        if (!moves) {
+            passes++;
+        } else {
+            passes = 0;
+            board.makeMove(mover, randomSquare(moves, random));
+        }
+        mover = 1 - mover;
+    }
+    return popCount(board.pieces[player]) - popCount(board.pieces[1 - player]);
+}
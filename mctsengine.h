@@ -0,0 +1,116 @@
+#ifndef MCTSENGINE_H
+#define MCTSENGINE_H
+
+#include "engineconfig.h"
+#include "reversiboard.h"
+#include "searchengine.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+/**
+ * One position of the tree, reached from its parent by move. Children of a node are allocated together, so
+ * a node only needs the index of the first and how many there are.
+ */
+struct MctsNode {
+    // NO_CHILDREN until expanded, then the first child, or EXPANDING / TERMINAL
+    atomic<uint32_t> firstChild;
+    atomic<uint32_t> visits;
+    // Half points for the player who made move: 2 per win, 1 per draw
+    atomic<uint32_t> wins;
+    // Threads currently below this node, each counted as a visit that was lost
+    atomic<uint32_t> virtualLoss;
+    uint8_t children;
+    Square move;
+};
+
+/**
+ * Monte Carlo tree search with UCT selection and uniformly random playouts, an alternative to the
+ * alpha-beta of ReversiCompetitionAgent that gives a usable move for any playout budget.
+ *
+ * The tree lives in a pool of nodes allocated up front and addressed by 32 bit indices, so a search does no
+ * allocation. The pool holds config.treeNodes nodes, or fewer when the playouts of a move cannot fill that
+ * many. Threads share one tree (tree parallelism): they claim nodes with atomic counters and steer away from
+ * each other's paths with a virtual loss, and expansion is the only step that needs a compare-and-swap.
+ * When the pool is full the tree stops growing and playouts start from the leaves.
+ *
+ * The tree is kept between searches: if the new position is reachable from the last root in a move or
+ * two, that subtree is copied to the front of the spare pool and becomes the new root.
+ */
+class MctsEngine {
+public:
+    explicit MctsEngine(const EngineConfig &config);
+
+    /**
+     * Runs the configured playouts from the position, or limits.nodes playouts if set, stopping early
+     * at limits.time. value is the expected score of move for player, 0 to 1; nodes counts playouts and
+     * depth is the length of the most visited line.
+     */
+    SearchInfo search(const ReversiBoard &board, int player, const SearchLimits &limits = SearchLimits());
+
+    /**
+     * Makes a search in progress return, may be called from any thread
+     */
+    void stop();
+
+    /**
+     * Nodes in use by the current tree
+     */
+    size_t treeSize() const;
+
+private:
+    static constexpr uint32_t NO_CHILDREN = 0;
+    static constexpr uint32_t EXPANDING = 0xFFFFFFFFu;
+    static constexpr uint32_t TERMINAL = 0xFFFFFFFEu;
+    // The root is always the first node of the pool, so index 0 can mean no children
+    static constexpr uint32_t ROOT = 0;
+
+    EngineConfig config;
+    size_t capacity;
+    unique_ptr<MctsNode[]> pool;
+    // Where the reused subtree is copied to, then the two pools swap
+    unique_ptr<MctsNode[]> spare;
+    atomic<uint32_t> nextFree;
+    ReversiBoard rootBoard;
+    int rootPlayer;
+    bool hasTree;
+    atomic<long long> playoutsStarted;
+    atomic<bool> stopRequested;
+
+    void resetTree(const ReversiBoard &board, int player);
+
+    /**
+     * Makes the node for board and player the root, keeping its subtree, if it is at most two plies
+     * below the current root. Returns false if it is not.
+     */
+    bool reuseTree(const ReversiBoard &board, int player);
+
+    void compact(uint32_t newRoot);
+
+    void worker(long long budget, bool hasDeadline, chrono::steady_clock::time_point deadline, uint64_t seed);
+
+    /**
+     * One selection, expansion, playout and backup
+     */
+    void iterate(uint64_t &random, vector<uint32_t> &path);
+
+    /**
+     * Creates the children of node, the moves of player in board. Returns false if another thread is
+     * expanding it or the pool is full.
+     */
+    bool expand(MctsNode &node, ReversiBoard &board, int player);
+
+    uint32_t select(const MctsNode &node) const;
+
+    /**
+     * Plays random moves to the end, returns the disc difference for player
+     */
+    static int playout(ReversiBoard board, int player, uint64_t &random);
+};
+
+#endif // MCTSENGINE_H
@@ -0,0 +1,587 @@
+#include "movedaemon.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+// A request line is far shorter, anything longer is not speaking the protocol
+static const size_t MAX_REQUEST_LENGTH = 1024;
+// How often the I/O thread looks at the stop flag, and how long shutdown waits for answers to drain
+static const int POLL_MILLISECONDS = 200;
+static const double SHUTDOWN_SECONDS = 2.0;
+
+DaemonOptions::DaemonOptions(): port(0), host("127.0.0.1"), threads(max(1, (int) thread::hardware_concurrency())),
+        queueLimit(256), pipelineLimit(16), defaultTime(1.0), maxTime(30.0), depth(0), scheduler(false) {
+    engine.name = "daemon";
+}
+
+bool DaemonOptions::parse(const string &key, const string &value) {
+    if (key == "socket") {
+        socketPath = value;
+    } else if (key == "port") {
+        port = atoi(value.c_str());
+    } else if (key == "host") {
+        host = value;
+    } else if (key == "threads") {
+        threads = max(1, atoi(value.c_str()));
+    } else if (key == "queue") {
+        queueLimit = max(1, atoi(value.c_str()));
+    } else if (key == "pipeline") {
+        pipelineLimit = max(1, atoi(value.c_str()));
+    } else if (key == "time") {
+        defaultTime = atof(value.c_str());
+    } else if (key == "maxtime") {
+        maxTime = atof(value.c_str());
+    } else if (key == "depth") {
+        depth = max(0, atoi(value.c_str()));
+    } else if (key == "scheduler") {
+        scheduler = atoi(value.c_str()) != 0;
+    } else if (key == "engine") {
+        return EngineConfig::parseAlphaBeta(value, engine);
+    } else {
+        cout << "Unknown serve option: " << key << endl;
+        return false;
+    }
+    return true;
+}
+
+static bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+MoveDaemon::MoveDaemon(const DaemonOptions &options): options(options), stopping(false), workersDone(false),
+        nextGame(0) {
+    wakePipe[0] = wakePipe[1] = -1;
+    if (pipe(wakePipe) == 0) {
+        setNonBlocking(wakePipe[0]);
+        setNonBlocking(wakePipe[1]);
+    }
+}
+
+MoveDaemon::~MoveDaemon() {
+    for (int listener: listeners) {
+        close(listener);
+    }
+    if (!options.socketPath.empty() && !listeners.empty()) {
+        unlink(options.socketPath.c_str());
+    }
+    for (const shared_ptr<Connection> &connection: connections) {
+        close(connection->fd);
+    }
+    close(wakePipe[0]);
+    close(wakePipe[1]);
+}
+
+bool MoveDaemon::listen() {
+    if (wakePipe[0] < 0) {
+        cout << "Couldn't create pipe: " << strerror(errno) << endl;
+        return false;
+    }
+    if (options.socketPath.empty() && options.port <= 0) {
+        cout << "Nothing to listen on, give socket=path or port=N" << endl;
+        return false;
+    }
+    return (options.socketPath.empty() || openUnixSocket()) && (options.port <= 0 || openTcpSocket());
+}
+
+bool MoveDaemon::openUnixSocket() {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (options.socketPath.size() >= sizeof(address.sun_path)) {
+        cout << "Socket path too long: " << options.socketPath << endl;
+        return false;
+    }
+    strcpy(address.sun_path, options.socketPath.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    // A socket file left behind by an earlier daemon would make bind fail
+    unlink(options.socketPath.c_str());
+    if (fd < 0 || bind(fd, (sockaddr *) &address, sizeof(address)) != 0 || ::listen(fd, SOMAXCONN) != 0
+            || !setNonBlocking(fd)) {
+        cout << "Couldn't listen on " << options.socketPath << ": " << strerror(errno) << endl;
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    listeners.push_back(fd);
+    return true;
+}
+
+bool MoveDaemon::openTcpSocket() {
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options.port);
+    if (inet_pton(AF_INET, options.host.c_str(), &address.sin_addr) != 1) {
+        cout << "Invalid host: " << options.host << endl;
+        return false;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0
+            || bind(fd, (sockaddr *) &address, sizeof(address)) != 0 || ::listen(fd, SOMAXCONN) != 0
+            || !setNonBlocking(fd)) {
+        cout << "Couldn't listen on " << options.host << ':' << options.port << ": " << strerror(errno) << endl;
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    listeners.push_back(fd);
+    return true;
+}
+
+void MoveDaemon::stop() {
+    stopping = true;
+    // write is async-signal-safe, a full pipe already has the I/O thread awake
+    ssize_t ignored = write(wakePipe[1], "s", 1);
+    (void) ignored;
+}
+
+void MoveDaemon::run() {
+    if (options.scheduler) {
+        EngineConfig config = options.engine;
+        config.depth = options.depth;
+        scheduler.reset(new GameScheduler(config, options.threads, 1 << 22, [this] {
+            ssize_t ignored = write(wakePipe[1], "a", 1);
+            (void) ignored;
+        }));
+    }
+    for (int i = 0; !scheduler && i < options.threads; i++) {
+        workers.push_back(unique_ptr<Worker>(new Worker(options.engine)));
+    }
+    for (unique_ptr<Worker> &worker: workers) {
+        worker->handle = thread(&MoveDaemon::worker, this, worker.get());
+    }
+
+    bool shuttingDown = false;
+    chrono::steady_clock::time_point shutdownDeadline;
+    vector<pollfd> fds;
+    while (true) {
+        if (stopping && !shuttingDown) {
+            shuttingDown = true;
+            shutdownDeadline = chrono::steady_clock::now()
+                    + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(SHUTDOWN_SECONDS));
+            shutdownSearches();
+        }
+
+        // Answers first: they free pipeline slots, which may let buffered requests through
+        collectScheduled();
+        for (size_t i = 0; i < connections.size(); i++) {
+            const shared_ptr<Connection> &connection = connections[i];
+            if (!connection->closed && !writeAnswers(connection)) {
+                closeConnection(connection);
+            }
+            if (!connection->closed && !shuttingDown) {
+                handleRequests(connection);
+            }
+        }
+        bool idle = true;
+        {
+            lock_guard<mutex> lock(queueMutex);
+            for (size_t i = 0; i < connections.size(); ) {
+                Connection &connection = *connections[i];
+                bool drained = connection.outstanding == 0 && connection.finished.empty()
+                        && connection.writeBuffer.empty();
+                if (connection.closed || ((connection.readClosed || shuttingDown) && drained)) {
+                    connection.closed = true;
+                    close(connection.fd);
+                    connections.erase(connections.begin() + i);
+                } else {
+                    idle = idle && drained;
+                    i++;
+                }
+            }
+        }
+        if (shuttingDown && (idle || chrono::steady_clock::now() > shutdownDeadline)) {
+            break;
+        }
+
+        int queued;
+        {
+            lock_guard<mutex> lock(queueMutex);
+            queued = (int) (jobs.size() + scheduled.size());
+        }
+        fds.clear();
+        pollfd wake = {wakePipe[0], POLLIN, 0};
+        fds.push_back(wake);
+        if (!shuttingDown) {
+            for (int listener: listeners) {
+                pollfd entry = {listener, POLLIN, 0};
+                fds.push_back(entry);
+            }
+        }
+        size_t firstConnection = fds.size();
+        for (const shared_ptr<Connection> &connection: connections) {
+            short events = 0;
+            bool reading;
+            {
+                lock_guard<mutex> lock(queueMutex);
+                // Backpressure: leave requests in the socket while the queue or the pipeline is full
+                reading = !shuttingDown && !connection->readClosed && queued < options.queueLimit
+                        && connection->outstanding < options.pipelineLimit;
+            }
+            if (reading) {
+                events |= POLLIN;
+            }
+            if (!connection->writeBuffer.empty()) {
+                events |= POLLOUT;
+            }
+            pollfd entry = {connection->fd, events, 0};
+            fds.push_back(entry);
+        }
+
+        if (poll(fds.data(), fds.size(), POLL_MILLISECONDS) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            cout << "poll failed: " << strerror(errno) << endl;
+            stopping = true;
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            char drain[256];
+            while (read(wakePipe[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+        for (size_t i = 1; i < firstConnection; i++) {
+            if (fds[i].revents & POLLIN) {
+                acceptConnections(fds[i].fd);
+            }
+        }
+        // Connections accepted above are not in fds yet, they get polled on the next round
+        size_t polled = fds.size() - firstConnection;
+        for (size_t i = 0; i < polled; i++) {
+            shared_ptr<Connection> connection = connections[i];
+            short revents = fds[firstConnection + i].revents;
+            if (revents & POLLIN) {
+                if (!readRequests(connection)) {
+                    closeConnection(connection);
+                }
+            } else if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                // Hung up in both directions, nobody is left to read the answers
+                closeConnection(connection);
+            }
+        }
+    }
+
+    {
+        lock_guard<mutex> lock(queueMutex);
+        workersDone = true;
+    }
+    jobAvailable.notify_all();
+    for (unique_ptr<Worker> &worker: workers) {
+        worker->handle.join();
+    }
+    workers.clear();
+    // Whatever has not answered by now has nobody left to send it to
+    scheduler.reset();
+    scheduled.clear();
+}
+
+void MoveDaemon::acceptConnections(int listener) {
+    while (true) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            return;
+        }
+        if (!setNonBlocking(fd)) {
+            close(fd);
+            continue;
+        }
+        // Answers are single short lines that the client is waiting for
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        connections.push_back(make_shared<Connection>(fd));
+    }
+}
+
+bool MoveDaemon::readRequests(const shared_ptr<Connection> &connection) {
+    char buffer[4096];
+    ssize_t received = recv(connection->fd, buffer, sizeof(buffer), 0);
+    if (received == 0) {
+        connection->readClosed = true;
+    } else if (received < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    } else {
+        connection->readBuffer.append(buffer, received);
+    }
+    handleRequests(connection);
+    return true;
+}
+
+void MoveDaemon::handleRequests(const shared_ptr<Connection> &connection) {
+    size_t start = 0;
+    while (!connection->closed) {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            if ((int) (jobs.size() + scheduled.size()) >= options.queueLimit
+                    || connection->outstanding >= options.pipelineLimit) {
+                break;
+            }
+        }
+        size_t end = connection->readBuffer.find('\n', start);
+        if (end == string::npos) {
+            break;
+        }
+        string line = connection->readBuffer.substr(start, end - start);
+        start = end + 1;
+        if (!line.empty() && line[line.size() - 1] == '\r') {
+            line.erase(line.size() - 1);
+        }
+        if (line.find_first_not_of(" \t") != string::npos) {
+            handleRequest(connection, line);
+        }
+    }
+    connection->readBuffer.erase(0, start);
+    if (connection->readBuffer.size() > MAX_REQUEST_LENGTH
+            && connection->readBuffer.find('\n') == string::npos) {
+        closeConnection(connection);
+    }
+}
+
+void MoveDaemon::handleRequest(const shared_ptr<Connection> &connection, const string &line) {
+    chrono::steady_clock::time_point received = chrono::steady_clock::now();
+    Job job;
+    job.connection = connection;
+    job.sequence = connection->nextSequence++;
+
+    istringstream tokens(line);
+    vector<string> words;
+    string word;
+    while (tokens >> word) {
+        words.push_back(word);
+    }
+    job.id = words[0];
+    {
+        lock_guard<mutex> lock(queueMutex);
+        connection->outstanding++;
+    }
+
+    double seconds = options.defaultTime;
+    size_t boardEnd = words.size();
+    if (boardEnd > 2) {
+        char *end;
+        double value = strtod(words.back().c_str(), &end);
+        if (*end == '\0') {
+            seconds = value;
+            boardEnd--;
+        }
+    }
+    string board;
+    for (size_t i = 1; i < boardEnd; i++) {
+        board += words[i];
+    }
+    if (!Position::parse(board, job.position)) {
+        complete(connection, job.sequence, job.id + " error invalid position");
+        return;
+    }
+    if (!(seconds > 0.0)) {
+        complete(connection, job.sequence, job.id + " error invalid time");
+        return;
+    }
+    if (scheduler) {
+        // The scheduler gives the move its share of the clock itself
+        ScheduledJob scheduledJob;
+        scheduledJob.connection = connection;
+        scheduledJob.sequence = job.sequence;
+        scheduledJob.id = job.id;
+        scheduledJob.game = nextGame++;
+        scheduledJob.result = scheduler->think(scheduledJob.game, job.position, seconds);
+        scheduled.push_back(move(scheduledJob));
+        return;
+    }
+    seconds = min(seconds, options.maxTime);
+    job.deadline = received + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+
+    {
+        lock_guard<mutex> lock(queueMutex);
+        jobs.push_back(job);
+    }
+    jobAvailable.notify_one();
+}
+
+bool MoveDaemon::writeAnswers(const shared_ptr<Connection> &connection) {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        map<long long, string>::iterator next;
+        while ((next = connection->finished.find(connection->nextToWrite)) != connection->finished.end()) {
+            connection->writeBuffer += next->second;
+            connection->writeBuffer += '\n';
+            connection->finished.erase(next);
+            connection->nextToWrite++;
+        }
+    }
+    while (!connection->writeBuffer.empty()) {
+        ssize_t sent = send(connection->fd, connection->writeBuffer.data(), connection->writeBuffer.size(),
+                            MSG_NOSIGNAL);
+        if (sent < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        connection->writeBuffer.erase(0, sent);
+    }
+    return true;
+}
+
+void MoveDaemon::closeConnection(const shared_ptr<Connection> &connection) {
+    lock_guard<mutex> lock(queueMutex);
+    connection->closed = true;
+    connection->finished.clear();
+    for (deque<Job>::iterator job = jobs.begin(); job != jobs.end(); ) {
+        if (job->connection == connection) {
+            job = jobs.erase(job);
+            connection->outstanding--;
+        } else {
+            ++job;
+        }
+    }
+    for (unique_ptr<Worker> &worker: workers) {
+        if (worker->current == connection) {
+            worker->cancel = true;
+        }
+    }
+    for (const ScheduledJob &job: scheduled) {
+        if (job.connection == connection) {
+            scheduler->stop(job.game);
+        }
+    }
+}
+
+void MoveDaemon::shutdownSearches() {
+    deque<Job> dropped;
+    {
+        lock_guard<mutex> lock(queueMutex);
+        dropped.swap(jobs);
+        for (unique_ptr<Worker> &worker: workers) {
+            if (worker->current) {
+                worker->cancel = true;
+            }
+        }
+        for (const ScheduledJob &job: scheduled) {
+            scheduler->stop(job.game);
+        }
+    }
+    for (const Job &job: dropped) {
+        complete(job.connection, job.sequence, job.id + " error shutting down");
+    }
+}
+
+void MoveDaemon::worker(Worker *self) {
+    while (true) {
+        Job job;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            jobAvailable.wait(lock, [this] { return !jobs.empty() || workersDone; });
+            if (jobs.empty()) {
+                return;
+            }
+            job = jobs.front();
+            jobs.pop_front();
+            self->current = job.connection;
+            self->cancel = false;
+        }
+        string answer = search(job, self);
+        {
+            lock_guard<mutex> lock(queueMutex);
+            self->current.reset();
+        }
+        complete(job.connection, job.sequence, answer);
+    }
+}
+
+string MoveDaemon::search(const Job &job, Worker *self) {
+    SearchLimits limits;
+    limits.depth = options.depth;
+    limits.time = chrono::duration<double>(job.deadline - chrono::steady_clock::now()).count();
+    if (limits.time <= 0.0) {
+        // The budget went on queueing, answer with the quickest move that is still a search
+        limits.depth = 1;
+        limits.time = 0.0;
+    }
+    // Set if the connection has gone since the job was taken, the search then stops at once
+    limits.cancel = &self->cancel;
+    return answerLine(job.id, self->engine.start(job.position, limits).get());
+}
+
+string MoveDaemon::answerLine(const string &id, const SearchInfo &info) {
+    ostringstream ss;
+    ss << id << ' ' << squareToString(info.move) << ' ' << info.value << ' ' << info.depth << ' ' << info.nodes
+       << ' ' << (long long) (info.seconds * 1000.0 + 0.5);
+    return ss.str();
+}
+
+void MoveDaemon::collectScheduled() {
+    for (size_t i = 0; i < scheduled.size(); ) {
+        ScheduledJob &job = scheduled[i];
+        if (job.result.wait_for(chrono::seconds(0)) != future_status::ready) {
+            i++;
+            continue;
+        }
+        complete(job.connection, job.sequence, answerLine(job.id, job.result.get()));
+        scheduled.erase(scheduled.begin() + i);
+    }
+}
+
+void MoveDaemon::complete(const shared_ptr<Connection> &connection, long long sequence, const string &answer) {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        connection->outstanding--;
+        if (!connection->closed) {
+            connection->finished[sequence] = answer;
+        }
+    }
+    ssize_t ignored = write(wakePipe[1], "a", 1);
+    (void) ignored;
+}
+
+static MoveDaemon *runningDaemon = NULL;
+
+static void stopDaemon(int) {
+    if (runningDaemon) {
+        runningDaemon->stop();
+    }
+}
+
+int runDaemon(int argc, char *argv[]) {
+    DaemonOptions options;
+    for (int i = 0; i < argc; i++) {
+        string argument(argv[i]);
+        size_t separator = argument.find('=');
+        if (separator == string::npos) {
+            cout << "Expected key=value, got: " << argument << endl;
+            return 1;
+        }
+        if (!options.parse(argument.substr(0, separator), argument.substr(separator + 1))) {
+            return 1;
+        }
+    }
+
+    MoveDaemon daemon(options);
+    if (!daemon.listen()) {
+        return 1;
+    }
+    runningDaemon = &daemon;
+    signal(SIGINT, stopDaemon);
+    signal(SIGTERM, stopDaemon);
+    signal(SIGPIPE, SIG_IGN);
+    daemon.run();
+    runningDaemon = NULL;
+    return 0;
+}
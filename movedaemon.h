@@ -0,0 +1,199 @@
+#ifndef MOVEDAEMON_H
+#define MOVEDAEMON_H
+
+#include "engineconfig.h"
+#include "gamescheduler.h"
+#include "searchengine.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Options of "agent serve key=value ..."
+ */
+class DaemonOptions {
+public:
+    EngineConfig engine;
+    // Unix socket path and/or TCP port to listen on, at least one of them
+    string socketPath;
+    int port;
+    string host;
+    int threads;
+    // Searches waiting for a worker, or all searches with the scheduler; at this many no more requests are read
+    int queueLimit;
+    // Requests of one connection that may be queued or running at once
+    int pipelineLimit;
+    // Seconds per move when a request gives none, and the most a request may ask for (not a clock)
+    double defaultTime;
+    double maxTime;
+    // Deepest iteration, 0 for no cap
+    int depth;
+    // Hand the searches to a GameScheduler, the time of a request is then its game's clock
+    bool scheduler;
+
+    DaemonOptions();
+
+    bool parse(const string &key, const string &value);
+};
+
+/**
+ * Serves moves to many clients at once over a Unix or TCP socket. Each request is one line,
+ * "<id> <64 board characters> <X|O> [seconds]", and gets one line back, "<id> <move> <value> <depth> <nodes> <ms>"
+ * or "<id> error <reason>". Clients may pipeline requests; the answers on a connection come back in request order.
+ *
+ * One thread does all the socket I/O with poll(), a fixed pool of workers runs the searches. When the shared
+ * queue is full, or a connection has pipelineLimit requests outstanding, the daemon stops reading from the
+ * sockets, so clients see backpressure through the socket buffers rather than errors. The time budget of a
+ * request counts from when it was read, queueing included. Requests of a connection that goes away are dropped
+ * and the searches already running for it are stopped.
+ *
+ * With scheduler=1 there is no queue and no pool of engines: every request goes straight to a GameScheduler,
+ * which runs the searches of all requests on the threads, earliest deadline first, with one shared table.
+ */
+class MoveDaemon {
+public:
+    MoveDaemon(const DaemonOptions &options);
+    ~MoveDaemon();
+
+    /**
+     * Opens the listening sockets, returns false and reports why if one cannot be opened
+     */
+    bool listen();
+
+    /**
+     * Serves until stop() is called. Then it reads no more requests, stops the searches in progress, which
+     * answer with their best move so far, fails the queued ones and returns once the answers are sent.
+     */
+    void run();
+
+    /**
+     * Safe to call from a signal handler
+     */
+    void stop();
+
+private:
+    struct Connection {
+        int fd;
+        string readBuffer;
+        string writeBuffer;
+        // No more requests will come, close once everything is answered
+        bool readClosed;
+        // Gone, its remaining requests are dropped
+        bool closed;
+        long long nextSequence;
+        long long nextToWrite;
+        // Guarded by queueMutex from here on
+        int outstanding;
+        map<long long, string> finished;
+
+        Connection(int fd): fd(fd), readClosed(false), closed(false), nextSequence(0), nextToWrite(0),
+                outstanding(0) {
+        }
+    };
+
+    struct Job {
+        shared_ptr<Connection> connection;
+        long long sequence;
+        string id;
+        Position position;
+        chrono::steady_clock::time_point deadline;
+    };
+
+    // A request handed to the scheduler, the I/O thread collects its answer
+    struct ScheduledJob {
+        shared_ptr<Connection> connection;
+        long long sequence;
+        string id;
+        int game;
+        future<SearchInfo> result;
+    };
+
+    struct Worker {
+        // Serves every client and both colours: its table keys entries on the side to move at the root
+        SearchEngine engine;
+        // The connection being served, so its search can be stopped if it goes away
+        shared_ptr<Connection> current;
+        // Stops the search of the current job; cleared with each new job, so it never stops the next one
+        atomic<bool> cancel;
+        thread handle;
+
+        Worker(const EngineConfig &config): engine(config), cancel(false) {
+        }
+    };
+
+    const DaemonOptions &options;
+    vector<int> listeners;
+    // Workers write a byte here to wake the I/O thread when an answer is ready
+    int wakePipe[2];
+    atomic<bool> stopping;
+
+    mutex queueMutex;
+    condition_variable jobAvailable;
+    deque<Job> jobs;
+    bool workersDone;
+    vector<unique_ptr<Worker> > workers;
+    vector<shared_ptr<Connection> > connections;
+    // Only with options.scheduler, and then only used by the I/O thread
+    unique_ptr<GameScheduler> scheduler;
+    vector<ScheduledJob> scheduled;
+    int nextGame;
+
+    void worker(Worker *self);
+
+    string search(const Job &job, Worker *self);
+
+    void complete(const shared_ptr<Connection> &connection, long long sequence, const string &answer);
+
+    /**
+     * Completes the scheduled requests that have answered
+     */
+    void collectScheduled();
+
+    static string answerLine(const string &id, const SearchInfo &info);
+
+    bool openUnixSocket();
+
+    bool openTcpSocket();
+
+    void acceptConnections(int listener);
+
+    /**
+     * Reads what the socket has, returns false if the connection failed
+     */
+    bool readRequests(const shared_ptr<Connection> &connection);
+
+    /**
+     * Queues the complete request lines in the read buffer, as many as the limits allow
+     */
+    void handleRequests(const shared_ptr<Connection> &connection);
+
+    void handleRequest(const shared_ptr<Connection> &connection, const string &line);
+
+    /**
+     * Moves the answers that are next in order to the write buffer and sends what the socket takes.
+     * Returns false if the connection failed.
+     */
+    bool writeAnswers(const shared_ptr<Connection> &connection);
+
+    void closeConnection(const shared_ptr<Connection> &connection);
+
+    void shutdownSearches();
+};
+
+/**
+ * Entry point for "agent serve key=value ...", returns the process exit code
+ */
+int runDaemon(int argc, char *argv[]);
+
+#endif // MOVEDAEMON_H
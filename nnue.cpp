@@ -0,0 +1,536 @@
+#include "nnue.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+using namespace nnue;
+
+static const size_t HEADER_SIZE = 16;
+static const size_t FILE_SIZE = HEADER_SIZE + sizeof(int16_t) * (INPUTS * ACCUMULATOR + ACCUMULATOR)
+                                + HIDDEN1 * 2 * ACCUMULATOR + sizeof(int32_t) * HIDDEN1
+                                + HIDDEN2 * HIDDEN1 + sizeof(int32_t) * HIDDEN2 + HIDDEN2 + sizeof(int32_t);
+
+static inline uint8_t clipped(int32_t value) {
+    return (uint8_t) min(max(value, 0), ACTIVATION_ONE);
+}
+
+// outputs[j] = biases[j] + weights[j] . input, with inputs a multiple of 32 and outputs of 4
+typedef void (*DenseFunction)(const uint8_t *input, int inputs, const int8_t *weights, const int32_t *biases,
+                              int outputs, int32_t *output);
+
+// The output of the network for player to move, in ACTIVATION_ONE * WEIGHT_ONE ths
+typedef int32_t (*ForwardFunction)(const NnueNetwork &network, const NnueAccumulator &accumulator, int player);
+
+// to = from + the rows in added - the rows in removed, over a whole accumulator
+typedef void (*ChangeFunction)(const int16_t *from, int16_t *to, const int16_t *const *added, int addedCount,
+                               const int16_t *const *removed, int removedCount);
+
+static void denseScalar(const uint8_t *input, int inputs, const int8_t *weights, const int32_t *biases,
+                        int outputs, int32_t *output) {
+    for (int j = 0; j < outputs; j++) {
+        const int8_t *row = weights + j * inputs;
+        int32_t sum = biases[j];
+        for (int i = 0; i < inputs; i++) {
+            sum += input[i] * row[i];
+        }
+        output[j] = sum;
+    }
+}
+
+static void changeScalar(const int16_t *from, int16_t *to, const int16_t *const *added, int addedCount,
+                         const int16_t *const *removed, int removedCount) {
+    memcpy(to, from, sizeof(int16_t) * ACCUMULATOR);
+    for (int r = 0; r < addedCount; r++) {
+        for (int i = 0; i < ACCUMULATOR; i++) {
+            to[i] += added[r][i];
+        }
+    }
+    for (int r = 0; r < removedCount; r++) {
+        for (int i = 0; i < ACCUMULATOR; i++) {
+            to[i] -= removed[r][i];
+        }
+    }
+}
+
+template <DenseFunction DENSE>
+static int32_t forward(const NnueNetwork &network, const NnueAccumulator &accumulator, int player) {
+    alignas(32) uint8_t input[2 * ACCUMULATOR];
+    const int16_t *own = accumulator.values[player];
+    const int16_t *other = accumulator.values[1 - player];
+    for (int i = 0; i < ACCUMULATOR; i++) {
+        input[i] = clipped(own[i]);
+        input[ACCUMULATOR + i] = clipped(other[i]);
+    }
+
+    int32_t sums[HIDDEN1 > HIDDEN2 ? HIDDEN1 : HIDDEN2];
+    alignas(32) uint8_t hidden1[HIDDEN1];
+    DENSE(input, 2 * ACCUMULATOR, network.hidden1Weights[0], network.hidden1Biases, HIDDEN1, sums);
+    for (int j = 0; j < HIDDEN1; j++) {
+        hidden1[j] = clipped(sums[j] >> WEIGHT_SHIFT);
+    }
+    alignas(32) uint8_t hidden2[HIDDEN2];
+    DENSE(hidden1, HIDDEN1, network.hidden2Weights[0], network.hidden2Biases, HIDDEN2, sums);
+    for (int j = 0; j < HIDDEN2; j++) {
+        hidden2[j] = clipped(sums[j] >> WEIGHT_SHIFT);
+    }
+
+    int32_t output = network.outputBias;
+    for (int i = 0; i < HIDDEN2; i++) {
+        output += network.outputWeights[i] * hidden2[i];
+    }
+    return output;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// maddubs multiplies the unsigned activations with the signed weights and adds neighbouring pairs into
+// int16; activations of at most 127 keep that from saturating. madd with ones widens the pairs to int32.
+// Four rows are done together so that one horizontal reduction serves all four.
+
+__attribute__((target("avx2")))
+static inline __m256i dotAvx2(__m256i sum, __m256i x, const int8_t *row, __m256i ones) {
+    __m256i w = _mm256_load_si256((const __m256i *) row);
+    return _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(x, w), ones));
+}
+
+__attribute__((target("avx2")))
+static void denseAvx2(const uint8_t *input, int inputs, const int8_t *weights, const int32_t *biases,
+                      int outputs, int32_t *output) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    for (int j = 0; j < outputs; j += 4) {
+        const int8_t *row = weights + j * inputs;
+        __m256i sum0 = _mm256_setzero_si256(), sum1 = sum0, sum2 = sum0, sum3 = sum0;
+        for (int i = 0; i < inputs; i += 32) {
+            __m256i x = _mm256_load_si256((const __m256i *) (input + i));
+            sum0 = dotAvx2(sum0, x, row + i, ones);
+            sum1 = dotAvx2(sum1, x, row + inputs + i, ones);
+            sum2 = dotAvx2(sum2, x, row + 2 * inputs + i, ones);
+            sum3 = dotAvx2(sum3, x, row + 3 * inputs + i, ones);
+        }
+        sum0 = _mm256_hadd_epi32(_mm256_hadd_epi32(sum0, sum1), _mm256_hadd_epi32(sum2, sum3));
+        __m128i sums = _mm_add_epi32(_mm256_castsi256_si128(sum0), _mm256_extracti128_si256(sum0, 1));
+        sums = _mm_add_epi32(sums, _mm_loadu_si128((const __m128i *) (biases + j)));
+        _mm_storeu_si128((__m128i *) (output + j), sums);
+    }
+}
+
+__attribute__((target("avx2")))
+static void changeAvx2(const int16_t *from, int16_t *to, const int16_t *const *added, int addedCount,
+                       const int16_t *const *removed, int removedCount) {
+    // The whole accumulator stays in four registers
+    __m256i values[ACCUMULATOR / 16];
+    for (int k = 0; k < ACCUMULATOR / 16; k++) {
+        values[k] = _mm256_load_si256((const __m256i *) from + k);
+    }
+    for (int r = 0; r < addedCount; r++) {
+        for (int k = 0; k < ACCUMULATOR / 16; k++) {
+            values[k] = _mm256_add_epi16(values[k], _mm256_load_si256((const __m256i *) added[r] + k));
+        }
+    }
+    for (int r = 0; r < removedCount; r++) {
+        for (int k = 0; k < ACCUMULATOR / 16; k++) {
+            values[k] = _mm256_sub_epi16(values[k], _mm256_load_si256((const __m256i *) removed[r] + k));
+        }
+    }
+    for (int k = 0; k < ACCUMULATOR / 16; k++) {
+        _mm256_store_si256((__m256i *) to + k, values[k]);
+    }
+}
+
+/**
+ * Clips, packs and shifts in registers too. The packs work within 128 bit lanes, so each is followed by a
+ * permutation that puts the values back in order.
+ */
+__attribute__((target("avx2")))
+static int32_t forwardAvx2(const NnueNetwork &network, const NnueAccumulator &accumulator, int player) {
+    static_assert(ACCUMULATOR == 64 && HIDDEN1 == 32 && HIDDEN2 == 32, "forwardAvx2 is written for 64x32x32");
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    alignas(32) uint8_t input[2 * ACCUMULATOR];
+    for (int side = 0; side < 2; side++) {
+        const __m256i *values = (const __m256i *) accumulator.values[side ? 1 - player : player];
+        for (int k = 0; k < 2; k++) {
+            __m256i packed = _mm256_packs_epi16(_mm256_load_si256(values + 2 * k),
+                                                _mm256_load_si256(values + 2 * k + 1));
+            packed = _mm256_permute4x64_epi64(_mm256_max_epi8(packed, zero), 0xD8);
+            _mm256_store_si256((__m256i *) (input + side * ACCUMULATOR + 32 * k), packed);
+        }
+    }
+
+    alignas(32) int32_t sums[HIDDEN1];
+    alignas(32) uint8_t hidden1[HIDDEN1];
+    alignas(32) uint8_t hidden2[HIDDEN2];
+    const __m256i *sumVectors = (const __m256i *) sums;
+    denseAvx2(input, 2 * ACCUMULATOR, network.hidden1Weights[0], network.hidden1Biases, HIDDEN1, sums);
+    for (int layer = 0; layer < 2; layer++) {
+        if (layer) {
+            denseAvx2(hidden1, HIDDEN1, network.hidden2Weights[0], network.hidden2Biases, HIDDEN2, sums);
+        }
+        __m256i low = _mm256_packs_epi32(_mm256_srai_epi32(_mm256_load_si256(sumVectors), WEIGHT_SHIFT),
+                                         _mm256_srai_epi32(_mm256_load_si256(sumVectors + 1), WEIGHT_SHIFT));
+        __m256i high = _mm256_packs_epi32(_mm256_srai_epi32(_mm256_load_si256(sumVectors + 2), WEIGHT_SHIFT),
+                                          _mm256_srai_epi32(_mm256_load_si256(sumVectors + 3), WEIGHT_SHIFT));
+        __m256i packed = _mm256_max_epi8(_mm256_packs_epi16(low, high), zero);
+        _mm256_store_si256((__m256i *) (layer ? hidden2 : hidden1), _mm256_permutevar8x32_epi32(packed, order));
+    }
+
+    __m256i products = _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_load_si256((const __m256i *) hidden2),
+            _mm256_load_si256((const __m256i *) network.outputWeights)), _mm256_set1_epi16(1));
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(products), _mm256_extracti128_si256(products, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return network.outputBias + _mm_cvtsi128_si32(sum);
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i dotSsse3(__m128i sum, __m128i x, const int8_t *row, __m128i ones) {
+    __m128i w = _mm_load_si128((const __m128i *) row);
+    return _mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(x, w), ones));
+}
+
+__attribute__((target("ssse3")))
+static void denseSsse3(const uint8_t *input, int inputs, const int8_t *weights, const int32_t *biases,
+                       int outputs, int32_t *output) {
+    const __m128i ones = _mm_set1_epi16(1);
+    for (int j = 0; j < outputs; j += 4) {
+        const int8_t *row = weights + j * inputs;
+        __m128i sum0 = _mm_setzero_si128(), sum1 = sum0, sum2 = sum0, sum3 = sum0;
+        for (int i = 0; i < inputs; i += 16) {
+            __m128i x = _mm_load_si128((const __m128i *) (input + i));
+            sum0 = dotSsse3(sum0, x, row + i, ones);
+            sum1 = dotSsse3(sum1, x, row + inputs + i, ones);
+            sum2 = dotSsse3(sum2, x, row + 2 * inputs + i, ones);
+            sum3 = dotSsse3(sum3, x, row + 3 * inputs + i, ones);
+        }
+        __m128i sums = _mm_hadd_epi32(_mm_hadd_epi32(sum0, sum1), _mm_hadd_epi32(sum2, sum3));
+        sums = _mm_add_epi32(sums, _mm_loadu_si128((const __m128i *) (biases + j)));
+        _mm_storeu_si128((__m128i *) (output + j), sums);
+    }
+}
+
+#if defined(__SSE2__)
+
+// SSE2 is part of x86-64, so this needs no check
+static void changeSse2(const int16_t *from, int16_t *to, const int16_t *const *added, int addedCount,
+                       const int16_t *const *removed, int removedCount) {
+    __m128i values[ACCUMULATOR / 8];
+    for (int k = 0; k < ACCUMULATOR / 8; k++) {
+        values[k] = _mm_load_si128((const __m128i *) from + k);
+    }
+    for (int r = 0; r < addedCount; r++) {
+        for (int k = 0; k < ACCUMULATOR / 8; k++) {
+            values[k] = _mm_add_epi16(values[k], _mm_load_si128((const __m128i *) added[r] + k));
+        }
+    }
+    for (int r = 0; r < removedCount; r++) {
+        for (int k = 0; k < ACCUMULATOR / 8; k++) {
+            values[k] = _mm_sub_epi16(values[k], _mm_load_si128((const __m128i *) removed[r] + k));
+        }
+    }
+    for (int k = 0; k < ACCUMULATOR / 8; k++) {
+        _mm_store_si128((__m128i *) to + k, values[k]);
+    }
+}
+
+#endif
+
+#endif
+
+/**
+ * The widest versions the processor runs, so the default build needs no -march
+ */
+static ForwardFunction chooseForward() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return forwardAvx2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return forward<denseSsse3>;
+    }
+#endif
+    return forward<denseScalar>;
+}
+
+static ChangeFunction chooseChange() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return changeAvx2;
+    }
+#if defined(__SSE2__)
+    return changeSse2;
+#endif
+#endif
+    return changeScalar;
+}
+
+static const ForwardFunction forwardPass = chooseForward();
+static const ChangeFunction change = chooseChange();
+
+NnueNetwork::NnueNetwork() {
+    memset(featureWeights, 0, sizeof(featureWeights));
+    memset(featureBiases, 0, sizeof(featureBiases));
+    memset(hidden1Weights, 0, sizeof(hidden1Weights));
+    memset(hidden1Biases, 0, sizeof(hidden1Biases));
+    memset(hidden2Weights, 0, sizeof(hidden2Weights));
+    memset(hidden2Biases, 0, sizeof(hidden2Biases));
+    memset(outputWeights, 0, sizeof(outputWeights));
+    outputBias = 0;
+}
+
+shared_ptr<const NnueNetwork> NnueNetwork::load(const string &path) {
+    static mutex cacheMutex;
+    static map<string, shared_ptr<const NnueNetwork> > cache;
+    lock_guard<mutex> lock(cacheMutex);
+    auto found = cache.find(path);
+    if (found != cache.end()) {
+        return found->second;
+    }
+    shared_ptr<NnueNetwork> network(new NnueNetwork());
+    if (!network->read(path)) {
+        return NULL;
+    }
+    cache[path] = network;
+    return network;
+}
+
+/**
+ * Little endian fields of a network file, in order
+ */
+class FieldReader {
+public:
+    explicit FieldReader(const uint8_t *data): data(data) {
+    }
+
+    uint64_t next(int bytes) {
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; i++) {
+            value |= (uint64_t) data[i] << (8 * i);
+        }
+        data += bytes;
+        return value;
+    }
+
+    int16_t int16() {
+        return (int16_t) next(2);
+    }
+
+    int8_t int8() {
+        return (int8_t) next(1);
+    }
+
+    int32_t int32() {
+        return (int32_t) next(4);
+    }
+
+private:
+    const uint8_t *data;
+};
+
+class FieldWriter {
+public:
+    explicit FieldWriter(vector<uint8_t> &data): data(data) {
+    }
+
+    void add(uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) {
+            data.push_back((uint8_t) (value >> (8 * i)));
+        }
+    }
+
+private:
+    vector<uint8_t> &data;
+};
+
+bool NnueNetwork::read(const string &path) {
+    ifstream inputFile(path.c_str(), ios::binary);
+    if (!inputFile.is_open()) {
+        cout << "Couldn't open network file: " << path << endl;
+        return false;
+    }
+    vector<uint8_t> data((istreambuf_iterator<char>(inputFile)), istreambuf_iterator<char>());
+    if (data.size() < HEADER_SIZE || memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        cout << "Not a network file: " << path << endl;
+        return false;
+    }
+    FieldReader reader(data.data() + sizeof(MAGIC));
+    uint32_t version = (uint32_t) reader.next(4);
+    int sizes[4];
+    for (int i = 0; i < 4; i++) {
+        sizes[i] = (int) reader.next(2);
+    }
+    if (version != VERSION || sizes[0] != INPUTS || sizes[1] != ACCUMULATOR || sizes[2] != HIDDEN1
+            || sizes[3] != HIDDEN2 || data.size() != FILE_SIZE) {
+        cout << "Network file " << path << " is version " << version << " with layers " << sizes[0] << 'x'
+             << sizes[1] << 'x' << sizes[2] << 'x' << sizes[3] << ", expected version " << VERSION << " with "
+             << INPUTS << 'x' << ACCUMULATOR << 'x' << HIDDEN1 << 'x' << HIDDEN2 << endl;
+        return false;
+    }
+
+    for (int f = 0; f < INPUTS; f++) {
+        for (int i = 0; i < ACCUMULATOR; i++) {
+            featureWeights[f][i] = reader.int16();
+        }
+    }
+    for (int i = 0; i < ACCUMULATOR; i++) {
+        featureBiases[i] = reader.int16();
+    }
+    for (int j = 0; j < HIDDEN1; j++) {
+        for (int i = 0; i < 2 * ACCUMULATOR; i++) {
+            hidden1Weights[j][i] = reader.int8();
+        }
+    }
+    for (int j = 0; j < HIDDEN1; j++) {
+        hidden1Biases[j] = reader.int32();
+    }
+    for (int j = 0; j < HIDDEN2; j++) {
+        for (int i = 0; i < HIDDEN1; i++) {
+            hidden2Weights[j][i] = reader.int8();
+        }
+    }
+    for (int j = 0; j < HIDDEN2; j++) {
+        hidden2Biases[j] = reader.int32();
+    }
+    for (int i = 0; i < HIDDEN2; i++) {
+        outputWeights[i] = reader.int8();
+    }
+    outputBias = reader.int32();
+    return true;
+}
+
+bool NnueNetwork::write(const string &path) const {
+    vector<uint8_t> data(MAGIC, MAGIC + sizeof(MAGIC));
+    data.reserve(FILE_SIZE);
+    FieldWriter writer(data);
+    writer.add(VERSION, 4);
+    writer.add(INPUTS, 2);
+    writer.add(ACCUMULATOR, 2);
+    writer.add(HIDDEN1, 2);
+    writer.add(HIDDEN2, 2);
+    for (int f = 0; f < INPUTS; f++) {
+        for (int i = 0; i < ACCUMULATOR; i++) {
+            writer.add((uint16_t) featureWeights[f][i], 2);
+        }
+    }
+    for (int i = 0; i < ACCUMULATOR; i++) {
+        writer.add((uint16_t) featureBiases[i], 2);
+    }
+    for (int j = 0; j < HIDDEN1; j++) {
+        for (int i = 0; i < 2 * ACCUMULATOR; i++) {
+            writer.add((uint8_t) hidden1Weights[j][i], 1);
+        }
+    }
+    for (int j = 0; j < HIDDEN1; j++) {
+        writer.add((uint32_t) hidden1Biases[j], 4);
+    }
+    for (int j = 0; j < HIDDEN2; j++) {
+        for (int i = 0; i < HIDDEN1; i++) {
+            writer.add((uint8_t) hidden2Weights[j][i], 1);
+        }
+    }
+    for (int j = 0; j < HIDDEN2; j++) {
+        writer.add((uint32_t) hidden2Biases[j], 4);
+    }
+    for (int i = 0; i < HIDDEN2; i++) {
+        writer.add((uint8_t) outputWeights[i], 1);
+    }
+    writer.add((uint32_t) outputBias, 4);
+
+    ofstream outputFile(path.c_str(), ios::binary);
+    if (!outputFile.is_open()) {
+        cout << "Couldn't open file: " << path << endl;
+        return false;
+    }
+    outputFile.write((const char *) data.data(), data.size());
+    return (bool) outputFile;
+}
+
+void NnueNetwork::refresh(const ReversiBoard &board, NnueAccumulator &accumulator) const {
+    const int16_t *rows[NO_OF_SQUARES];
+    for (int perspective = 0; perspective < 2; perspective++) {
+        int count = 0;
+        for (int colour = 0; colour < 2; colour++) {
+            ullint discs = board.pieces[colour];
+            while (discs) {
+                rows[count++] = featureWeights[feature(perspective, colour, popFirstSquare(discs))];
+            }
+        }
+        change(featureBiases, accumulator.values[perspective], rows, count, NULL, 0);
+    }
+}
+
+void NnueNetwork::update(const NnueAccumulator &parent, NnueAccumulator &child, int colour, Square square,
+                         ullint flipped) const {
+    if (square >= NO_OF_SQUARES) {
+        child = parent;
+        return;
+    }
+    // The new disc and the flipped ones in their new colour come, the flipped ones in the old colour go
+    const int16_t *added[NO_OF_SQUARES];
+    const int16_t *removed[NO_OF_SQUARES];
+    for (int perspective = 0; perspective < 2; perspective++) {
+        int count = 0;
+        added[count] = featureWeights[feature(perspective, colour, square)];
+        ullint discs = flipped;
+        while (discs) {
+            Square flip = popFirstSquare(discs);
+            removed[count] = featureWeights[feature(perspective, 1 - colour, flip)];
+            added[++count] = featureWeights[feature(perspective, colour, flip)];
+        }
+        change(parent.values[perspective], child.values[perspective], added, count + 1, removed, count);
+    }
+}
+
+double NnueNetwork::evaluate(const NnueAccumulator &accumulator, int player) const {
+    return forwardPass(*this, accumulator, player) * OUTPUT_SCALE / (ACTIVATION_ONE * WEIGHT_ONE);
+}
+
+NnueStack::NnueStack(): network(NULL), top(0) {
+}
+
+void NnueStack::reset(const NnueNetwork *network, const ReversiBoard &board) {
+    this->network = network;
+    // Room for a whole game, so a search never reallocates
+    entries.resize(NO_OF_SQUARES + 1);
+    top = 0;
+    network->refresh(board, entries[0].accumulator);
+    entries[0].computed = true;
+}
+
+void NnueStack::push(int colour, Square square, ullint flipped) {
+    if (++top == entries.size()) {
+        entries.push_back(Entry());
+    }
+    Entry &entry = entries[top];
+    entry.computed = false;
+    entry.colour = colour;
+    entry.square = square;
+    entry.flipped = flipped;
+}
+
+void NnueStack::pop() {
+    top--;
+}
+
+double NnueStack::evaluate(int player) {
+    size_t computed = top;
+    while (!entries[computed].computed) {
+        computed--;
+    }
+    for (size_t i = computed + 1; i <= top; i++) {
+        Entry &entry = entries[i];
+        network->update(entries[i - 1].accumulator, entry.accumulator, entry.colour, entry.square, entry.flipped);
+        entry.computed = true;
+    }
+    return network->evaluate(entries[top].accumulator, player);
+}
@@ -0,0 +1,129 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include "reversiboard.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Shape and fixed point scales of the network. The input is one feature per square and colour, seen from
+ * one side: its own disc on the square or the other side's. The first layer is kept as an accumulator for
+ * each side and updated with the discs a move adds and flips. The side to move's accumulator and the other
+ * one, clipped to 0..1, feed two small dense layers and a single output, the expected final disc
+ * difference for the side to move divided by OUTPUT_SCALE.
+ *
+ * Activations are stored as 0..ACTIVATION_ONE, i.e. in 127ths. First layer weights are int16 in 127ths,
+ * dense weights int8 in 64ths (so at most +/-2) with int32 biases in 127 * 64ths.
+ */
+namespace nnue {
+    static const int INPUTS = 2 * NO_OF_SQUARES;
+    static const int ACCUMULATOR = 64;
+    static const int HIDDEN1 = 32;
+    static const int HIDDEN2 = 32;
+
+    static const int ACTIVATION_ONE = 127;
+    static const int WEIGHT_ONE = 64;
+    static const int WEIGHT_SHIFT = 6;
+    static const double OUTPUT_SCALE = 64.0;
+
+    static const char MAGIC[4] = {'R', 'V', 'N', 'N'};
+    static const uint32_t VERSION = 1;
+
+    /**
+     * Feature of a disc of colour on square, seen from perspective
+     */
+    inline int feature(int perspective, int colour, Square square) {
+        return (colour == perspective ? 0 : NO_OF_SQUARES) + square;
+    }
+}
+
+/**
+ * First layer outputs for both perspectives, indexed by colour
+ */
+struct alignas(32) NnueAccumulator {
+    int16_t values[2][nnue::ACCUMULATOR];
+};
+
+/**
+ * Quantised weights of a network, as written by `tuner model=nnue`. Files are a 16 byte header (magic,
+ * version and the four layer sizes as little endian uint32 / uint16) followed by the first layer weights
+ * feature by feature and its biases as int16, then for each dense layer its weights output by output as int8
+ * and its biases as int32, all little endian.
+ */
+class NnueNetwork {
+public:
+    alignas(32) int16_t featureWeights[nnue::INPUTS][nnue::ACCUMULATOR];
+    alignas(32) int16_t featureBiases[nnue::ACCUMULATOR];
+    alignas(32) int8_t hidden1Weights[nnue::HIDDEN1][2 * nnue::ACCUMULATOR];
+    int32_t hidden1Biases[nnue::HIDDEN1];
+    alignas(32) int8_t hidden2Weights[nnue::HIDDEN2][nnue::HIDDEN1];
+    int32_t hidden2Biases[nnue::HIDDEN2];
+    alignas(32) int8_t outputWeights[nnue::HIDDEN2];
+    int32_t outputBias;
+
+    NnueNetwork();
+
+    /**
+     * The network in path, read once per process and shared by every engine that asks for it.
+     * Reports the problem and returns NULL if the file cannot be used.
+     */
+    static shared_ptr<const NnueNetwork> load(const string &path);
+
+    bool read(const string &path);
+
+    bool write(const string &path) const;
+
+    /**
+     * Computes both accumulators of board from scratch
+     */
+    void refresh(const ReversiBoard &board, NnueAccumulator &accumulator) const;
+
+    /**
+     * child is parent after colour played on square and flipped the given discs
+     */
+    void update(const NnueAccumulator &parent, NnueAccumulator &child, int colour, Square square,
+                ullint flipped) const;
+
+    /**
+     * Expected final disc difference for player, the side to move
+     */
+    double evaluate(const NnueAccumulator &accumulator, int player) const;
+};
+
+/**
+ * The accumulators along the line a search is on, one per ply. Pushing a move only records it; the
+ * accumulator is brought up to date from the nearest computed one below when a position is evaluated, so
+ * moves that are cut off before their leaves cost nothing.
+ */
+class NnueStack {
+public:
+    NnueStack();
+
+    void reset(const NnueNetwork *network, const ReversiBoard &board);
+
+    void push(int colour, Square square, ullint flipped);
+
+    void pop();
+
+    double evaluate(int player);
+
+private:
+    struct Entry {
+        NnueAccumulator accumulator;
+        bool computed;
+        int colour;
+        Square square;
+        ullint flipped;
+    };
+
+    const NnueNetwork *network;
+    vector<Entry> entries;
+    size_t top;
+};
+
+#endif // NNUE_H
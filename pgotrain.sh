@@ -0,0 +1,36 @@
+#!/bin/sh
+# Training workload of the profile-guided build: runs the instrumented binaries in <bindir> from the
+# scratch directory <workdir>, where their profiles are not written. The workload is fixed so that every
+# release build is trained the same way; it covers the alpha-beta and MCTS searches, the network evaluation
+# and its training, the endgame solver, batch analysis and the board primitives, and takes under a minute on
+# one core.
+#
+# Usage: pgotrain.sh <bindir> <workdir>
+
+set -e
+BIN=$(cd "$1" && pwd)
+mkdir -p "$2"
+cd "$2"
+
+"$BIN/server" tournament games=8 threads=1 a=name=deep,depth=5 b=name=shallow,depth=4 results=tournament.csv \
+    > /dev/null
+"$BIN/server" tournament games=4 threads=1 a=name=mcts,algorithm=mcts,playouts=3000 b=name=ab,depth=3 \
+    results=mcts.csv > /dev/null
+
+cat > positions.txt << EOF
+****************OOOX****OOXXO*****XXO*****OXXOXX***OOOOO*****X** X
+****X******XXO**O***OXXX*OXOXX*O*OOOOX***OOXXX***O***XX*O******X O
+**OO*******OO***OOOXXO*O**XXXOO****XOXOX***OOOX***OXXXXX*OOOOO** X
+**OOO*X***OOOXX***OOXX*X*OOOXOX**XOXOXXO**XOX*OO*XXXO**OXXXXX*** O
+***XXXXX**XXXXXX*OXXXXXX**XXXXOO*XXXXX**XXOXOOX*OOOOOOXX**OXOO** X
+**OX*O**XXOOXXXO*XOXXXXOXXOOXOOOXOOXOOOOXXOOOOOOXXOOXXXOO*O*O*X* X
+EOF
+"$BIN/agent" batch depth=7 threads=1 input=positions.txt output=batch.txt
+"$BIN/agent" batch depth=6 threads=1 interleave=4 table=16 input=positions.txt output=interleaved.txt
+"$BIN/datagen" out=training.bin games=20 threads=1 random=8 solve=12 engine=depth=2 > /dev/null
+"$BIN/tuner" data=training.bin model=nnue epochs=2 threads=1 out=network.nnue > /dev/null
+"$BIN/server" tournament games=4 threads=1 a=name=nnue,depth=4,network=network.nnue b=name=weights,depth=4 \
+    results=nnue.csv > /dev/null
+
+"$BIN/boardbench" samples=3 warmup=1 > /dev/null
+"$BIN/variant" size=6 board=**OOO***OOX*OXXXOOOXXXXO*OXO*X*XO*O* side=X > /dev/null
@@ -4,11 +4,8 @@ import curses
 import copy
 import time
 
-DIRECTIONS = [
-    [-1, -1], [-1, 0], [-1, 1],
-    [0, -1], [0, 1],  # [0, 0],
-    [1, -1], [1, 0], [1, 1]
-]
+import reversicore
+
 PLAYERS = ['X', 'O']
 COLUMN_NAMES = ['a', 'b', 'c', 'd', 'e', 'f', 'g', 'h']
 BOARD_SIZE = 8
@@ -37,15 +34,6 @@ class Play:
         self.current_state = copy.deepcopy(START_STATE)
         self.moves_list = list()
 
-    def common_move_check(self, i, j, check_for_star=True, board=None):
-        if board is None:
-            board = self.current_state
-        within_limits = 0 <= j < BOARD_SIZE and 0 <= i < BOARD_SIZE
-        if check_for_star:
-            return within_limits and board[i][j] != '*'
-        else:
-            return within_limits
-
     def generate_input(self, player, depth):
         params = dict()
         params['cutoff_depth'] = depth
@@ -147,28 +135,15 @@ class Play:
         if move is None:
             return
         (x, y) = move
-        flips = dict()
+        if player == 'X':
+            opponent = 'O'
+        else:
+            opponent = 'X'
+        (own, other, flips) = reversicore.make_move(reversicore.from_state(board, player),
+                                                   reversicore.from_state(board, opponent), x, y)
         board[x][y] = player
-        for d in xrange(len(DIRECTIONS)):
-            (delta_i, delta_j) = DIRECTIONS[d]
-            i, j = x + delta_i, y + delta_j
-            found_player = False
-            while self.common_move_check(i, j, board=board) and board[i][j] != player:
-                # First check if flips are possible in this direction
-                i += delta_i
-                j += delta_j
-                if self.common_move_check(i, j, board=board) and board[i][j] == player:
-                    found_player = True
-            if (i, j) != (x + delta_i, y + delta_j) and found_player:
-                # Then, if flips are possible, make the flips
-                a, b = x + delta_i, y + delta_j
-                while (a, b) != (i, j):
-                    board[a][b] = player
-                    (a, b) = (a + delta_i, b + delta_j)
-                flips[d] = (i, j)
-        #print "Make move: ", (x, y), flips
-        #self.print_board()
-        #time.sleep(1)
+        for (i, j) in reversicore.squares(flips):
+            board[i][j] = player
         return flips
 
     def print_board_curses(self, valid_moves_list=list(), args=list(), board=None):
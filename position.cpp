@@ -0,0 +1,114 @@
+#include "position.h"
+
+#include <fstream>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+Position::Position(): board(), player(ReversiBoard::BLACK) {
+}
+
+Position::Position(const ReversiBoard &board, int player): board(board), player(player) {
+}
+
+bool Position::parse(const string &line, Position &position) {
+    ullint pieces[2] = {0, 0};
+    int square = 0;
+    int player = -1;
+    for (char ch: line) {
+        if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n') {
+            continue;
+        }
+        if (square == NO_OF_SQUARES) {
+            if (player != -1 || (ch != 'X' && ch != 'O')) {
+                return false;
+            }
+            player = ch == 'X' ? ReversiBoard::BLACK : ReversiBoard::WHITE;
+            continue;
+        }
+        if (ch == 'X') {
+            pieces[ReversiBoard::BLACK] |= squareBit(square);
+        } else if (ch == 'O') {
+            pieces[ReversiBoard::WHITE] |= squareBit(square);
+        } else if (ch != '*' && ch != '-') {
+            return false;
+        }
+        square++;
+    }
+    if (player == -1) {
+        return false;
+    }
+    position = Position(ReversiBoard(pieces[ReversiBoard::BLACK], pieces[ReversiBoard::WHITE]), player);
+    return true;
+}
+
+vector<Position> Position::randomGamePositions(int count, unsigned int seed, int maxEmpties) {
+    mt19937 random(seed);
+    vector<Position> positions;
+    while ((int) positions.size() < count) {
+        ReversiBoard board;
+        int player = ReversiBoard::BLACK;
+        int passes = 0;
+        while (passes < 2 && (int) positions.size() < count) {
+            ullint moves = board.legalMoves(player);
+            if (!moves) {
+                passes++;
+                player = 1 - player;
+                continue;
+            }
+            passes = 0;
+            if (popCount(board.blankBoard()) <= maxEmpties) {
+                positions.push_back(Position(board, player));
+            }
+            int skip = uniform_int_distribution<int>(0, popCount(moves) - 1)(random);
+            while (skip-- > 0) {
+                popFirstSquare(moves);
+            }
+            board.makeMove(player, firstSquare(moves));
+            player = 1 - player;
+        }
+    }
+    return positions;
+}
+
+bool Position::loadPositions(const string &path, vector<Position> &positions) {
+    ifstream input(path.c_str());
+    if (!input.is_open()) {
+        cout << "Couldn't open file: " << path << endl;
+        return false;
+    }
+    size_t first = positions.size();
+    string line;
+    Position position;
+    while (getline(input, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (!parse(line, position)) {
+            cout << "Invalid position: " << line << endl;
+            return false;
+        }
+        positions.push_back(position);
+    }
+    if (positions.size() == first) {
+        cout << "No positions in " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+string Position::toString() const {
+    string line(NO_OF_SQUARES + 2, ' ');
+    for (int square = 0; square < NO_OF_SQUARES; square++) {
+        if (board.pieces[ReversiBoard::BLACK] & squareBit(square)) {
+            line[square] = 'X';
+        } else if (board.pieces[ReversiBoard::WHITE] & squareBit(square)) {
+            line[square] = 'O';
+        } else {
+            line[square] = '*';
+        }
+    }
+    line[NO_OF_SQUARES + 1] = player == ReversiBoard::BLACK ? 'X' : 'O';
+    return line;
+}
@@ -0,0 +1,43 @@
+#ifndef POSITION_H
+#define POSITION_H
+
+#include "reversiboard.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * A board together with the side to move
+ */
+class Position {
+public:
+    ReversiBoard board;
+    int player;
+
+    Position();
+    Position(const ReversiBoard &board, int player);
+
+    /**
+     * Parses a line of 64 board characters (X, O and * or -) followed by the side to move, X or O.
+     * Whitespace anywhere in the line is ignored.
+     */
+    static bool parse(const string &line, Position &position);
+
+    /**
+     * Every position of random games where the side to move has a move and at most maxEmpties squares are
+     * empty, in the order they were played, until there are count of them. The benchmarks' default corpora.
+     */
+    static vector<Position> randomGamePositions(int count, unsigned int seed, int maxEmpties = NO_OF_SQUARES);
+
+    /**
+     * Appends the positions of a file of parse() lines, skipping blank lines and # comments. Returns false and
+     * reports why if the file cannot be read, has an invalid line or has no positions.
+     */
+    static bool loadPositions(const string &path, vector<Position> &positions);
+
+    string toString() const;
+};
+
+#endif // POSITION_H
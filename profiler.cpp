@@ -0,0 +1,308 @@
+#include "profiler.h"
+
+#ifdef REVERSI_PROFILE
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace profiler {
+
+// Histogram buckets are powers of two: bucket b holds calls of [2^b, 2^(b+1)) cycles
+static const int BUCKETS = 40;
+static const int BAR_WIDTH = 40;
+
+static const char *POINT_NAMES[PROFILE_POINTS] = {
+    "legalMoves", "makeMove", "evaluateScore", "numberOfStablePieces", "table probe"
+};
+
+static const char *COUNTER_NAMES[HARDWARE_COUNTERS] = {
+    "cycles", "instructions", "branch misses", "L1d misses", "LLC misses"
+};
+
+/**
+ * Counts of one thread. Only that thread writes them, the atomics let report() read them while it runs.
+ */
+struct ThreadStats {
+    atomic<uint64_t> calls[PROFILE_POINTS];
+    atomic<uint64_t> cycles[PROFILE_POINTS];
+    atomic<uint64_t> histogram[PROFILE_POINTS][BUCKETS];
+    atomic<uint64_t> counters[PROFILE_POINTS][HARDWARE_COUNTERS];
+
+    ThreadStats() {
+        clear();
+    }
+
+    void clear() {
+        for (int point = 0; point < PROFILE_POINTS; point++) {
+            calls[point].store(0, memory_order_relaxed);
+            cycles[point].store(0, memory_order_relaxed);
+            for (int bucket = 0; bucket < BUCKETS; bucket++) {
+                histogram[point][bucket].store(0, memory_order_relaxed);
+            }
+            for (int counter = 0; counter < HARDWARE_COUNTERS; counter++) {
+                counters[point][counter].store(0, memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * Adds these counts to total, which only the caller may be writing
+     */
+    void addTo(ThreadStats &total) const;
+};
+
+static inline void add(atomic<uint64_t> &total, uint64_t value) {
+    // Single writer, so no read-modify-write is needed
+    total.store(total.load(memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+void ThreadStats::addTo(ThreadStats &total) const {
+    for (int point = 0; point < PROFILE_POINTS; point++) {
+        add(total.calls[point], calls[point].load(memory_order_relaxed));
+        add(total.cycles[point], cycles[point].load(memory_order_relaxed));
+        for (int bucket = 0; bucket < BUCKETS; bucket++) {
+            add(total.histogram[point][bucket], histogram[point][bucket].load(memory_order_relaxed));
+        }
+        for (int counter = 0; counter < HARDWARE_COUNTERS; counter++) {
+            add(total.counters[point][counter], counters[point][counter].load(memory_order_relaxed));
+        }
+    }
+}
+
+// The stats of the running threads, and what the finished ones counted since the last report, so that
+// report() still sees the work of finished searches without keeping an entry per thread ever started
+static mutex registryMutex;
+static vector<ThreadStats *> registry;
+static ThreadStats retired;
+
+/**
+ * Registers the stats of a thread on its first profiled call and, when the thread exits, moves them
+ * into retired and drops them from the registry
+ */
+struct ThreadEntry {
+    unique_ptr<ThreadStats> stats;
+
+    ThreadEntry(): stats(new ThreadStats()) {
+        lock_guard<mutex> lock(registryMutex);
+        registry.push_back(stats.get());
+    }
+
+    ~ThreadEntry() {
+        lock_guard<mutex> lock(registryMutex);
+        stats->addTo(retired);
+        registry.erase(find(registry.begin(), registry.end(), stats.get()));
+    }
+};
+
+static ThreadStats &threadStats() {
+    thread_local ThreadEntry entry;
+    return *entry.stats;
+}
+
+/**
+ * The hardware counters of one thread, opened as a group so they are read together
+ */
+struct CounterGroup {
+    int leader;
+    int fds[HARDWARE_COUNTERS];
+    // Position of each counter in a group read, -1 if the machine does not have it
+    int slot[HARDWARE_COUNTERS];
+    int opened;
+
+    CounterGroup(): leader(-1), opened(0) {
+        for (int i = 0; i < HARDWARE_COUNTERS; i++) {
+            fds[i] = -1;
+            slot[i] = -1;
+        }
+    }
+
+    ~CounterGroup() {
+        for (int i = 0; i < HARDWARE_COUNTERS; i++) {
+            if (fds[i] >= 0) {
+                close(fds[i]);
+            }
+        }
+    }
+
+    bool open() {
+        static const uint32_t types[HARDWARE_COUNTERS] = {
+            PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE
+        };
+        static const uint64_t configs[HARDWARE_COUNTERS] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_CACHE_MISSES
+        };
+        for (int i = 0; i < HARDWARE_COUNTERS; i++) {
+            perf_event_attr attributes;
+            memset(&attributes, 0, sizeof(attributes));
+            attributes.size = sizeof(attributes);
+            attributes.type = types[i];
+            attributes.config = configs[i];
+            attributes.disabled = leader < 0;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+            attributes.read_format = PERF_FORMAT_GROUP;
+            int fd = (int) syscall(SYS_perf_event_open, &attributes, 0, -1, leader, 0);
+            if (fd < 0) {
+                // The cycle counter leads the group, without it there is nothing to read
+                if (i == 0) {
+                    return false;
+                }
+                continue;
+            }
+            if (leader < 0) {
+                leader = fd;
+            }
+            fds[i] = fd;
+            slot[i] = opened++;
+        }
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        return true;
+    }
+
+    void read(uint64_t values[HARDWARE_COUNTERS]) const {
+        // The number of counters, then their values
+        uint64_t buffer[HARDWARE_COUNTERS + 1];
+        if (::read(leader, buffer, sizeof(uint64_t) * (opened + 1)) < 0) {
+            memset(buffer, 0, sizeof(buffer));
+        }
+        for (int i = 0; i < HARDWARE_COUNTERS; i++) {
+            values[i] = slot[i] >= 0 ? buffer[slot[i] + 1] : 0;
+        }
+    }
+};
+
+static bool countersRequested() {
+    static const bool requested = getenv("REVERSI_PROFILE_COUNTERS") && atoi(getenv("REVERSI_PROFILE_COUNTERS"));
+    return requested;
+}
+
+static thread_local unique_ptr<CounterGroup> threadCounters;
+static thread_local bool countersTried = false;
+static atomic<bool> countersFailed(false);
+
+bool countersEnabled() {
+    if (!countersTried) {
+        countersTried = true;
+        if (countersRequested() && !countersFailed) {
+            unique_ptr<CounterGroup> group(new CounterGroup());
+            if (group->open()) {
+                threadCounters.swap(group);
+            } else if (!countersFailed.exchange(true)) {
+                cerr << "Hardware counters unavailable: " << strerror(errno) << endl;
+            }
+        }
+    }
+    return threadCounters != NULL;
+}
+
+void readCounters(uint64_t values[HARDWARE_COUNTERS]) {
+    threadCounters->read(values);
+}
+
+void record(ProfilePoint point, uint64_t elapsed, const uint64_t *counters) {
+    ThreadStats &stats = threadStats();
+    add(stats.calls[point], 1);
+    add(stats.cycles[point], elapsed);
+    int bucket = elapsed ? 63 - __builtin_clzll(elapsed) : 0;
+    add(stats.histogram[point][bucket < BUCKETS ? bucket : BUCKETS - 1], 1);
+    if (counters) {
+        for (int i = 0; i < HARDWARE_COUNTERS; i++) {
+            add(stats.counters[point][i], counters[i]);
+        }
+    }
+}
+
+/**
+ * Upper end of the bucket the given fraction of calls falls in
+ */
+static uint64_t percentile(const uint64_t histogram[BUCKETS], uint64_t calls, double fraction) {
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < BUCKETS; bucket++) {
+        seen += histogram[bucket];
+        if (seen >= fraction * calls) {
+            return 2ULL << bucket;
+        }
+    }
+    return 2ULL << (BUCKETS - 1);
+}
+
+void report(ostream &output) {
+    unique_ptr<ThreadStats> total(new ThreadStats());
+    {
+        lock_guard<mutex> lock(registryMutex);
+        for (ThreadStats *stats: registry) {
+            stats->addTo(*total);
+            stats->clear();
+        }
+        retired.addTo(*total);
+        retired.clear();
+    }
+    uint64_t calls[PROFILE_POINTS], cycles[PROFILE_POINTS];
+    uint64_t histogram[PROFILE_POINTS][BUCKETS];
+    uint64_t counters[PROFILE_POINTS][HARDWARE_COUNTERS];
+    for (int point = 0; point < PROFILE_POINTS; point++) {
+        calls[point] = total->calls[point].load(memory_order_relaxed);
+        cycles[point] = total->cycles[point].load(memory_order_relaxed);
+        for (int bucket = 0; bucket < BUCKETS; bucket++) {
+            histogram[point][bucket] = total->histogram[point][bucket].load(memory_order_relaxed);
+        }
+        for (int counter = 0; counter < HARDWARE_COUNTERS; counter++) {
+            counters[point][counter] = total->counters[point][counter].load(memory_order_relaxed);
+        }
+    }
+
+    output << "profile: calls, cycles in total and per call (timestamp counter, callees included)" << endl;
+    for (int point = 0; point < PROFILE_POINTS; point++) {
+        if (!calls[point]) {
+            continue;
+        }
+        output << setw(22) << left << POINT_NAMES[point] << right << setw(12) << calls[point] << " calls "
+               << setw(14) << cycles[point] << " cycles " << setw(8) << fixed << setprecision(1)
+               << (double) cycles[point] / calls[point] << " mean  p50 <" << percentile(histogram[point], calls[point], 0.5)
+               << "  p99 <" << percentile(histogram[point], calls[point], 0.99) << endl;
+        if (counters[point][0]) {
+            output << setw(22) << "";
+            for (int counter = 1; counter < HARDWARE_COUNTERS; counter++) {
+                output << "  " << COUNTER_NAMES[counter] << ' ' << setprecision(2)
+                       << (double) counters[point][counter] / calls[point];
+            }
+            output << "  per call, IPC " << (double) counters[point][1] / counters[point][0] << endl;
+        }
+        uint64_t largest = 0;
+        for (int bucket = 0; bucket < BUCKETS; bucket++) {
+            largest = max(largest, histogram[point][bucket]);
+        }
+        for (int bucket = 0; bucket < BUCKETS; bucket++) {
+            if (!histogram[point][bucket]) {
+                continue;
+            }
+            int width = (int) ((histogram[point][bucket] * BAR_WIDTH + largest - 1) / largest);
+            output << setw(24) << (1ULL << bucket) << "+ " << setw(12) << histogram[point][bucket] << ' '
+                   << string(width, '#') << endl;
+        }
+    }
+    output.unsetf(ios::floatfield);
+    output << setprecision(6);
+}
+
+}
+
+#endif // REVERSI_PROFILE
@@ -0,0 +1,111 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/**
+ * Scoped timers for the hot paths of the search, compiled in with -DREVERSI_PROFILE (make PROFILE=1,
+ * cmake -DREVERSI_PROFILE=ON). Without it PROFILE_SCOPE and PROFILE_REPORT expand to nothing.
+ *
+ * Each scope counts its calls and the cycles spent inside, including the scopes it calls, into a
+ * histogram per profile point. With REVERSI_PROFILE_COUNTERS=1 in the environment the scopes also read the
+ * hardware counters of the thread through perf_event_open: cycles, instructions, branch misses, L1 data
+ * and last level cache misses. They count user space only, so the read system call itself stays out of
+ * the numbers, but reading them at every call makes a profiled search many times slower.
+ */
+
+#include <cstdint>
+#include <iostream>
+
+using namespace std;
+
+enum ProfilePoint {
+    PROFILE_LEGAL_MOVES,
+    PROFILE_MAKE_MOVE,
+    PROFILE_EVALUATE,
+    PROFILE_STABLE_PIECES,
+    PROFILE_TABLE_PROBE,
+    PROFILE_POINTS
+};
+
+#ifdef REVERSI_PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace profiler {
+
+static const int HARDWARE_COUNTERS = 5;
+
+/**
+ * Timestamp counter, or nanoseconds where there is none
+ */
+inline uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/**
+ * Whether this thread reads hardware counters, opening them on first use
+ */
+bool countersEnabled();
+
+void readCounters(uint64_t values[HARDWARE_COUNTERS]);
+
+void record(ProfilePoint point, uint64_t cycles, const uint64_t *counters);
+
+/**
+ * Writes the totals and histograms of every thread so far and starts over. Searches still running on
+ * other threads keep counting, but what they count while the report is written may be lost.
+ */
+void report(ostream &output);
+
+class Scope {
+public:
+    explicit Scope(ProfilePoint point): point(point), counting(countersEnabled()) {
+        if (counting) {
+            readCounters(startCounters);
+        }
+        start = cycles();
+    }
+
+    ~Scope() {
+        uint64_t elapsed = cycles() - start;
+        if (counting) {
+            uint64_t counters[HARDWARE_COUNTERS];
+            readCounters(counters);
+            for (int i = 0; i < HARDWARE_COUNTERS; i++) {
+                counters[i] -= startCounters[i];
+            }
+            record(point, elapsed, counters);
+        } else {
+            record(point, elapsed, NULL);
+        }
+    }
+
+private:
+    ProfilePoint point;
+    bool counting;
+    uint64_t start;
+    uint64_t startCounters[HARDWARE_COUNTERS];
+};
+
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(point) profiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(point)
+#define PROFILE_REPORT(output) profiler::report(output)
+
+#else
+
+#define PROFILE_SCOPE(point) ((void) 0)
+#define PROFILE_REPORT(output) ((void) 0)
+
+#endif // REVERSI_PROFILE
+
+#endif // PROFILER_H
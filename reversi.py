@@ -1,6 +1,8 @@
 # import time
 import curses
 
+import reversicore
+
 POS_WEIGHTS_HW = [
     [99, -8, 8, 6, 6, 8, -8, 99],
     [-8, -24, -4, -3, -3, -4, -24, -8],
@@ -15,11 +17,6 @@ COLUMN_NAMES = ['a', 'b', 'c', 'd', 'e', 'f', 'g', 'h']
 
 BOARD_SIZE = 8
 INF_NEG, INF_POS = -float('inf'), float('inf')
-DIRECTIONS = [
-    [-1, -1], [-1, 0], [-1, 1],
-    [0, -1], [0, 1],  # [0, 0],
-    [1, -1], [1, 0], [1, 1]
-]
 
 
 class ReversiAgent:
@@ -36,19 +33,17 @@ class ReversiAgent:
         self.traverse_log = list()
         self.task = params['task']
         self.curses_output = output
+        # Bitboards of both players, kept in step with current_state for libreversi
+        self.discs = {
+            self.max_player: reversicore.from_state(self.current_state, self.max_player),
+            self.min_player: reversicore.from_state(self.current_state, self.min_player)
+        }
 
         if self.curses_output:
             # Init some curses settings
             self.scr = curses.initscr()
             curses.noecho()
 
-    def common_move_check(self, i, j, check_for_star=True):
-        within_limits = 0 <= j < BOARD_SIZE and 0 <= i < BOARD_SIZE
-        if check_for_star:
-            return within_limits and self.current_state[i][j] != '*'
-        else:
-            return within_limits
-
     def evaluate_score(self):
         max_player_score = 0
         min_player_score = 0
@@ -147,26 +142,21 @@ class ReversiAgent:
             print "Error writing output"
             print e.message
 
+    def opponent_of(self, player):
+        if player == self.max_player:
+            return self.min_player
+        return self.max_player
+
+    def set_squares(self, bits, player):
+        for (i, j) in reversicore.squares(bits):
+            self.current_state[i][j] = player
+
     def make_move(self, x, y, player):
-        flips = dict()
+        opponent = self.opponent_of(player)
+        (self.discs[player], self.discs[opponent], flips) = reversicore.make_move(
+            self.discs[player], self.discs[opponent], x, y)
         self.current_state[x][y] = player
-        for d in xrange(len(DIRECTIONS)):
-            (delta_i, delta_j) = DIRECTIONS[d]
-            i, j = x + delta_i, y + delta_j
-            found_player = False
-            while self.common_move_check(i, j) and self.current_state[i][j] != player:
-                # First check if flips are possible in this direction
-                i += delta_i
-                j += delta_j
-                if self.common_move_check(i, j) and self.current_state[i][j] == player:
-                    found_player = True
-            if (i, j) != (x + delta_i, y + delta_j) and found_player:
-                # Then, if flips are possible, make the flips
-                a, b = x + delta_i, y + delta_j
-                while (a, b) != (i, j):
-                    self.current_state[a][b] = player
-                    (a, b) = (a + delta_i, b + delta_j)
-                flips[d] = (i, j)
+        self.set_squares(flips, player)
         #print "Make move: ", (x, y), flips
         #self.print_board()
         #time.sleep(1)
@@ -174,18 +164,11 @@ class ReversiAgent:
         return flips
 
     def undo_move(self, x, y, player, flips):
+        opponent = self.opponent_of(player)
+        self.discs[player] &= ~(flips | reversicore.square_bit(x, y))
+        self.discs[opponent] |= flips
         self.current_state[x][y] = '*'
-        if player == 'X':
-            opponent = 'O'
-        else:
-            opponent = 'X'
-        for d in flips:
-            (delta_i, delta_j) = DIRECTIONS[d]
-            i, j = x + delta_i, y + delta_j
-            while self.common_move_check(i, j) and (i, j) != flips[d]:
-                self.current_state[i][j] = opponent
-                i += delta_i
-                j += delta_j
+        self.set_squares(flips, opponent)
         #print "Undo move: ", (x, y), flips
         #self.print_board()
         #time.sleep(1)
@@ -280,29 +263,19 @@ class ReversiAgent:
         self.scr.getch()
 
     def valid_moves(self, player):
-        valid_moves_list = list()
-        for x in xrange(BOARD_SIZE):
-            for y in xrange(BOARD_SIZE):
-                if self.current_state[x][y] != '*':
-                    continue
-                for (delta_i, delta_j) in DIRECTIONS:
-                    (i, j) = (x + delta_i, y + delta_j)
-                    while self.common_move_check(i, j, False) and self.current_state[i][j] not in [player, '*']:
-                        (i, j) = (i + delta_i, j + delta_j)
-                    if (i, j) != (x + delta_i, y + delta_j) and self.common_move_check(i, j, False) and\
-                            self.current_state[i][j] == player:
-                        valid_moves_list.append((x, y))
-                        break
+        opponent = self.opponent_of(player)
+        # Row-major, so already sorted
+        valid_moves_list = reversicore.squares(reversicore.legal_moves(self.discs[player], self.discs[opponent]))
 
-        valid_moves_list = sorted(valid_moves_list)
-        for (x, y) in valid_moves_list:
-            self.current_state[x][y] = player.lower()
-        self.print_board_curses(valid_moves_list)
+        if self.curses_output:
+            for (x, y) in valid_moves_list:
+                self.current_state[x][y] = player.lower()
+            self.print_board_curses(valid_moves_list)
 
-        for (x, y) in valid_moves_list:
-            self.current_state[x][y] = '*'
-            # print (x, y), ":", self.format_move(x, y)
-        # print
+            for (x, y) in valid_moves_list:
+                self.current_state[x][y] = '*'
+                # print (x, y), ":", self.format_move(x, y)
+            # print
         return valid_moves_list
 
     def terminal_test(self, depth, valid_moves):
@@ -1,19 +1,38 @@
 #include "reversiboard.h"
+#include "profiler.h"
 
 #include <bitset>
-#include <math.h>
-#include <set>
 #include <iostream>
 
 using namespace std;
 
-static shiftFunction shiftFunctions[8] = {
-    shiftDown, shiftDownLeft, shiftDownRight, shiftLeft, shiftRight,
-    shiftUp, shiftUpLeft, shiftUpRight
-};
+/**
+ * Swaps the bits selected by mask with the bits delta places above them
+ */
+static inline ullint deltaSwap(ullint x, ullint mask, int delta) {
+    ullint t = (x ^ (x >> delta)) & mask;
+    return x ^ t ^ (t << delta);
+}
+
+// Square s is bit 63 - s, so reversing the bytes mirrors the rows and reversing the bits of
+// every byte mirrors the columns
+static inline ullint mirrorColumns(ullint x) {
+    x = deltaSwap(x, 0x5555555555555555ULL, 1);
+    x = deltaSwap(x, 0x3333333333333333ULL, 2);
+    return deltaSwap(x, 0x0F0F0F0F0F0F0F0FULL, 4);
+}
+
+static inline ullint mirrorRows(ullint x) {
+    return __builtin_bswap64(x);
+}
+
+static inline ullint transpose(ullint x) {
+    x = deltaSwap(x, 0x00AA00AA00AA00AAULL, 7);
+    x = deltaSwap(x, 0x0000CCCC0000CCCCULL, 14);
+    return deltaSwap(x, 0x00000000F0F0F0F0ULL, 28);
+}
 
-ReversiBoard::ReversiBoard() {
-    ReversiBoard(INITIAL_POSITION_BLACK, INITIAL_POSITION_WHITE);
+ReversiBoard::ReversiBoard(): ReversiBoard(INITIAL_POSITION_BLACK, INITIAL_POSITION_WHITE) {
 }
 
 ReversiBoard::ReversiBoard(vector<vector<char> > &board) {
@@ -34,12 +53,12 @@ ReversiBoard ReversiBoard::clone() {
 vector< ullint > ReversiBoard::charBoardToLong(vector<vector<char> > &board) {
     ullint longReprX = 0;
     ullint longReprO = 0;
-    for (int i = 0; i < 8; i++) {
-        for (int j = 0; j < 8; j++) {
+    for (int i = 0; i < BOARD_SIZE; i++) {
+        for (int j = 0; j < BOARD_SIZE; j++) {
             if (board[i][j] == 'X') {
-                longReprX += (ullint) pow(2, 63 - (i * 8 + j));
+                longReprX |= squareBit(makeSquare(i, j));
             } else if (board[i][j] == 'O') {
-                longReprO += (ullint) pow(2, 63 - (i * 8 + j));
+                longReprO |= squareBit(makeSquare(i, j));
             }
         }
     }
@@ -59,182 +78,154 @@ ullint ReversiBoard::whitePieces() {
 }
 
 ullint ReversiBoard::blankBoard() {
-    return ~blackPieces() & ~whitePieces();
+    return ~(pieces[BLACK] | pieces[WHITE]);
 }
 
-ullint ReversiBoard::coordinateToLong(Coordinate c) {
-    ullint l = (ullint) (pow(2, 63 - (c.x * 8 + c.y)));
-    return l;
+bool ReversiBoard::isMoveLegal(int color, Square square) {
+    return square < NO_OF_SQUARES && (legalMoves(color) & squareBit(square));
 }
 
-bool ReversiBoard::isMoveLegal(int color, Coordinate coordinate) {
-    vector<Coordinate> moves = legalMoves(color);
-    for (auto move: moves) {
-        if (move == coordinate) {
-            return true;
-        }
-    }
-    return false;
+bool ReversiBoard::isCorner(ullint position) {
+    return (position & CORNERS) != 0;
 }
 
-bool ReversiBoard::isCorner(ullint position) {
-    return (bool) position & CORNERS;
+ullint ReversiBoard::legalMoves(int player) {
+    PROFILE_SCOPE(PROFILE_LEGAL_MOVES);
+    return generateMoves(pieces[player], pieces[1 - player]);
 }
 
-Coordinate ReversiBoard::longToCoordinate(ullint position) {
-    Coordinate theCoordinate;
-    if (position > 0) {
-        ullint l = 1L;
-        int counter = 0;
-        while (theCoordinate.empty() && counter < 64){
-            if (l == position) {
-                return Coordinate(7 - counter / 8, 7 - counter % 8);
+ullint ReversiBoard::flips(int color, Square square) {
+    ullint own = pieces[color];
+    ullint opponent = pieces[1 - color];
+    ullint flipped = 0;
+
+    // Rays towards higher bits: the nearest square is the lowest bit
+    for (int d = 0; d < 4; d++) {
+        ullint ray = squareRay(d, square);
+        ullint blockers = ray & ~opponent;
+        ullint first = blockers & (0 - blockers);
+        if (first & own) {
+            flipped |= ray & (first - 1);
+        }
+    }
+    // Rays towards lower bits: the nearest square is the highest bit
+    for (int d = 4; d < 8; d++) {
+        ullint ray = squareRay(d, square);
+        ullint blockers = ray & ~opponent;
+        if (blockers) {
+            ullint first = squareBit(firstSquare(blockers));
+            if (first & own) {
+                flipped |= ray & ~(first | (first - 1));
             }
-            l = l << 1;
-            counter++;
         }
     }
-    return theCoordinate;
+    return flipped;
 }
 
-ullint ReversiBoard::highestOrderBit(ullint num) {
-    if (!num)
+ullint ReversiBoard::makeMove(int color, Square square) {
+    PROFILE_SCOPE(PROFILE_MAKE_MOVE);
+    if (square >= NO_OF_SQUARES) {
         return 0;
-    ullint ret = 1;
-    while (num >>= 1)
-        ret <<= 1;
-    return ret;
-}
-
-vector< Coordinate > ReversiBoard::longToCoordinateList(ullint position) {
-    ullint workingPosition = position;
-    vector<Coordinate> coordinates;
-    ullint highestOneBit = highestOrderBit(workingPosition);
-    while (highestOneBit != 0) {
-        coordinates.push_back(longToCoordinate(highestOneBit));
-        workingPosition ^= highestOneBit;
-        highestOneBit = highestOrderBit(workingPosition);
     }
-    return coordinates;
+    ullint flipped = flips(color, square);
+    pieces[color] |= flipped | squareBit(square);
+    pieces[1 - color] &= ~flipped;
+    return flipped;
 }
 
-bool ReversiBoard::makeMove(int color, Coordinate coordinate) {
-    vector<Coordinate> piecesToTurn;
-    piecesToTurn.push_back(coordinate);
-    vector<Coordinate> endPoints = moveEndPoints(color, coordinate);
-    piecesToTurn.insert(piecesToTurn.end(), endPoints.begin(), endPoints.end());
-    for (auto c: endPoints) {
-        vector<Coordinate> betweenEndsAndC = coordinate.between(c);
-        piecesToTurn.insert(piecesToTurn.end(), betweenEndsAndC.begin(), betweenEndsAndC.end());
-    }
-    for (auto c: piecesToTurn) {
-        setPieceAtPosition(color, coordinateToLong(c));
+void ReversiBoard::undoMove(int color, Square square, ullint flipped) {
+    if (square >= NO_OF_SQUARES) {
+        return;
     }
-//     printBoard();
+    pieces[color] &= ~(flipped | squareBit(square));
+    pieces[1 - color] |= flipped;
 }
 
-vector< Coordinate > ReversiBoard::moveEndPoints(int color, Coordinate coordinate) {
-    vector<Coordinate> endPoints;
-    ullint startPoint = coordinateToLong(coordinate);
-
-    for (int i = 0; i < 8; i++) {
-        shiftFunction func = shiftFunctions[i];
-        Coordinate endPoint = moveEndPointInDirection(color, startPoint, func);
-        if (!endPoint.empty()) {
-            endPoints.push_back(endPoint);
-        }
-    }
-    return endPoints;
+int ReversiBoard::numberOfPieces(int player) {
+    return popCount(pieces[player]);
 }
 
-Coordinate ReversiBoard::moveEndPointInDirection(int color, ullint startPosition, shiftFunction func) {
-    ullint potentialEndPoint = func(startPosition);
-    while(potentialEndPoint != 0) {
-        if(validEndPoint(color, potentialEndPoint)) {
-            return longToCoordinate(potentialEndPoint);
-        }
-        potentialEndPoint = func(potentialEndPoint);
-    }
-    return longToCoordinate(-1);
+int ReversiBoard::numberOfStablePieces(int player) {
+    PROFILE_SCOPE(PROFILE_STABLE_PIECES);
+    // A disc counts as stable on a corner, or when all eight neighbours exist and belong to the player
+    ullint own = pieces[player];
+    ullint surrounded = shiftDown(own) & shiftDownLeft(own) & shiftDownRight(own) & shiftLeft(own)
+        & shiftRight(own) & shiftUp(own) & shiftUpLeft(own) & shiftUpRight(own);
+    return popCount(own & (CORNERS | surrounded));
 }
 
-vector< Coordinate > ReversiBoard::legalMoves(int player) {
-    vector<Coordinate> moves;
-    for (shiftFunction func: shiftFunctions) {
-        vector<Coordinate> directionMoves = movesInDirection(player, func);
-        moves.insert(moves.end(), directionMoves.begin(), directionMoves.end());
+ullint ReversiBoard::transformPieces(ullint pieces, int transform) {
+    if (transform & 1) {
+        pieces = mirrorColumns(pieces);
     }
-
-    set<Coordinate> setOfMoves(moves.begin(), moves.end());
-    moves.assign(setOfMoves.begin(), setOfMoves.end());
-    return moves;
+    if (transform & 2) {
+        pieces = mirrorRows(pieces);
+    }
+    if (transform & 4) {
+        pieces = transpose(pieces);
+    }
+    return pieces;
 }
 
-vector< Coordinate > ReversiBoard::movesInDirection(int player, shiftFunction func) {
-    vector<Coordinate> moves;
-    int otherPlayer = 1 - player;
-    ullint potentialMoves = func(pieces[player]) & pieces[otherPlayer];
-    ullint emptyBoard = blankBoard();
-    while (potentialMoves != 0){
-        ullint legalMoves = func(potentialMoves) & emptyBoard;
-        vector<Coordinate> legalMovesList = longToCoordinateList(legalMoves);
-        moves.insert(moves.end(), legalMovesList.begin(), legalMovesList.end());
-        potentialMoves = func(potentialMoves) & pieces[otherPlayer];
+Square ReversiBoard::transformSquare(Square square, int transform) {
+    if (square >= NO_OF_SQUARES) {
+        return square;
+    }
+    int row = squareRow(square), column = squareColumn(square);
+    if (transform & 1) {
+        column = BOARD_SIZE - 1 - column;
+    }
+    if (transform & 2) {
+        row = BOARD_SIZE - 1 - row;
     }
-    return moves;
+    if (transform & 4) {
+        return makeSquare(column, row);
+    }
+    return makeSquare(row, column);
 }
 
-int ReversiBoard::numberOfPieces(int player) {
-    ullint playerPieces = pieces[player];
-
-    int noOfPieces = 0;
-    while (playerPieces) {
-        noOfPieces++;
-        playerPieces ^= highestOrderBit(playerPieces);
+int ReversiBoard::inverseTransform(int transform) {
+    // Transposing swaps which mirror comes first
+    if (transform & 4) {
+        return 4 | ((transform & 1) << 1) | ((transform & 2) >> 1);
     }
+    return transform;
+}
 
-    return noOfPieces;
+ReversiBoard ReversiBoard::transformed(int transform) const {
+    return ReversiBoard(transformPieces(pieces[BLACK], transform), transformPieces(pieces[WHITE], transform));
 }
 
-int ReversiBoard::numberOfStablePieces(int player) {
-    int opponent = 1 - player;
-    ullint playerPieces = pieces[player];
-    ullint opponentPieces = pieces[opponent];
-    int stablePieces = 0;
-
-    while (playerPieces) {
-        ullint highestBit = highestOrderBit(playerPieces);
-        playerPieces ^= highestBit;
-        if (isCorner(highestBit)) {
-            stablePieces++;
-        } else {
-            // Go through all the directions and check if it can be flipped at any point of time
-            bool isStable = true;
-            for (shiftFunction func: shiftFunctions) {
-                ullint position = func(highestBit);
-                while (position && (position & pieces[player])) {
-                    position = func(position);
-                }
-                if (position == func(highestBit)) {
-                    isStable = false;
-                    break;
-                }
-            }
-            if (isStable) {
-                stablePieces++;
-            }
+CanonicalKey ReversiBoard::canonicalKey(int player) const {
+    ullint forms[SYMMETRIES][2];
+    forms[0][0] = pieces[player];
+    forms[0][1] = pieces[1 - player];
+    for (int side = 0; side < 2; side++) {
+        forms[1][side] = mirrorColumns(forms[0][side]);
+        forms[2][side] = mirrorRows(forms[0][side]);
+        forms[3][side] = mirrorRows(forms[1][side]);
+        for (int t = 0; t < 4; t++) {
+            forms[t + 4][side] = transpose(forms[t][side]);
         }
     }
-
+    CanonicalKey key = {forms[0][0], forms[0][1], 0};
+    for (int t = 1; t < SYMMETRIES; t++) {
+        if (forms[t][0] < key.player || (forms[t][0] == key.player && forms[t][1] < key.opponent)) {
+            key.player = forms[t][0];
+            key.opponent = forms[t][1];
+            key.transform = t;
+        }
+    }
+    return key;
 }
 
 void ReversiBoard::printBoard() {
     string black = bitToString(pieces[BLACK]);
     string white = bitToString(pieces[WHITE]);
-    for (int i = 0; i < 8; i++) {
-        for (int j = 0; j < 8; j++) {
-            char b = black.at(i * 8 + j);
-            char w = white.at(i * 8 + j);
+    for (int i = 0; i < BOARD_SIZE; i++) {
+        for (int j = 0; j < BOARD_SIZE; j++) {
+            char b = black.at(i * BOARD_SIZE + j);
+            char w = white.at(i * BOARD_SIZE + j);
             if (b == '1') {
                 cout << "X ";
             } else if (w == '1') {
@@ -253,48 +244,6 @@ string ReversiBoard::bitToString(ullint pieces) {
 }
 
 void ReversiBoard::setPieceAtPosition(int color, ullint position) {
-    pieces[1 - color] &= ~position; 
-    pieces[color] = pieces[color] | position; 
-}
-
-bool ReversiBoard::validEndPoint(int color, ullint position) {
-    return (position & pieces[color]);
-}
-
-ullint shiftDown(ullint position) {
-    return (ullint) (position >> 8);
-}
-
-ullint shiftDownLeft(ullint position) {
-    ullint dlShift = (ullint) (position >> 7);
-    return dlShift & ~RIGHT_MASK;
-}
-
-ullint shiftDownRight(ullint position) {
-    ullint drShift = (ullint) (position >> 9);
-    return drShift & ~LEFT_MASK;
-}
-
-ullint shiftLeft(ullint position) {
-    ullint lShift = position << 1;
-    return lShift & ~RIGHT_MASK;
-}
-
-ullint shiftRight(ullint position) {
-    ullint rShift = (ullint) (position >> 1);
-    return rShift & ~LEFT_MASK;
-}
-
-ullint shiftUp(ullint position) {
-    return position << 8;
-}
-
-ullint shiftUpLeft(ullint position) {
-    ullint ulShift = position << 9;
-    return ulShift & ~RIGHT_MASK;
-}
-
-ullint shiftUpRight(ullint position) {
-    ullint urShift = position << 7;
-    return urShift & ~LEFT_MASK;
+    pieces[1 - color] &= ~position;
+    pieces[color] = pieces[color] | position;
 }
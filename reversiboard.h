@@ -1,28 +1,93 @@
 #ifndef REVERSIBOARD_H
 #define REVERSIBOARD_H
 
-#include "coordinate.h"
+#include "square.h"
 
+#include <string>
 #include <vector>
 
-#define BOARD_SIZE 8
-
 using namespace std;
 
-typedef unsigned long long int ullint;
 typedef ullint (*shiftFunction) (ullint);
 
-static const signed long long int LEFT_MASK = -9187201950435737472L;
-static const signed long long int RIGHT_MASK = 72340172838076673L;
-
-ullint shiftDown(ullint position);
-ullint shiftDownLeft(ullint position);
-ullint shiftDownRight(ullint position);
-ullint shiftLeft(ullint position);
-ullint shiftRight(ullint position);
-ullint shiftUp(ullint position);
-ullint shiftUpLeft(ullint position);
-ullint shiftUpRight(ullint position);
+static const ullint LEFT_MASK = BoardGeometry<BOARD_SIZE>::LEFT_COLUMN;
+static const ullint RIGHT_MASK = BoardGeometry<BOARD_SIZE>::RIGHT_COLUMN;
+
+inline ullint shiftDown(ullint position) {
+    return position >> 8;
+}
+
+inline ullint shiftDownLeft(ullint position) {
+    return (position >> 7) & ~RIGHT_MASK;
+}
+
+inline ullint shiftDownRight(ullint position) {
+    return (position >> 9) & ~LEFT_MASK;
+}
+
+inline ullint shiftLeft(ullint position) {
+    return (position << 1) & ~RIGHT_MASK;
+}
+
+inline ullint shiftRight(ullint position) {
+    return (position >> 1) & ~LEFT_MASK;
+}
+
+inline ullint shiftUp(ullint position) {
+    return position << 8;
+}
+
+inline ullint shiftUpLeft(ullint position) {
+    return (position << 9) & ~RIGHT_MASK;
+}
+
+inline ullint shiftUpRight(ullint position) {
+    return (position << 7) & ~LEFT_MASK;
+}
+
+/**
+ * Squares in direction Shift from which the player can move by flipping opponent discs.
+ * Opponent runs are at most six discs long, so six propagation steps cover the board.
+ */
+template <shiftFunction Shift>
+inline ullint movesInDirection(ullint player, ullint opponent, ullint empty) {
+    ullint run = Shift(player) & opponent;
+    run |= Shift(run) & opponent;
+    run |= Shift(run) & opponent;
+    run |= Shift(run) & opponent;
+    run |= Shift(run) & opponent;
+    run |= Shift(run) & opponent;
+    return Shift(run) & empty;
+}
+
+/**
+ * Squares own can move to, from the raw bitboards
+ */
+inline ullint generateMoves(ullint own, ullint opponent) {
+    ullint empty = ~(own | opponent);
+    return movesInDirection<shiftDown>(own, opponent, empty)
+        | movesInDirection<shiftDownLeft>(own, opponent, empty)
+        | movesInDirection<shiftDownRight>(own, opponent, empty)
+        | movesInDirection<shiftLeft>(own, opponent, empty)
+        | movesInDirection<shiftRight>(own, opponent, empty)
+        | movesInDirection<shiftUp>(own, opponent, empty)
+        | movesInDirection<shiftUpLeft>(own, opponent, empty)
+        | movesInDirection<shiftUpRight>(own, opponent, empty);
+}
+
+/**
+ * Symmetric form of a position seen from one player, see ReversiBoard::canonicalKey
+ */
+struct CanonicalKey {
+    ullint player;
+    ullint opponent;
+    // Maps the original board onto this one, see ReversiBoard::transformPieces
+    int transform;
+
+    bool operator==(const CanonicalKey &other) const {
+        return player == other.player && opponent == other.opponent;
+    }
+};
 
 class ReversiBoard
 {
@@ -31,10 +96,14 @@ public:
     static const short int WHITE = 1;
     static const int DIRECTIONS = 8;
 
-    static const ullint INITIAL_POSITION_BLACK = 68853694464L;
-    static const ullint INITIAL_POSITION_WHITE = 34628173824L;
+    static const ullint INITIAL_POSITION_BLACK = BoardGeometry<BOARD_SIZE>::INITIAL_BLACK;
+    static const ullint INITIAL_POSITION_WHITE = BoardGeometry<BOARD_SIZE>::INITIAL_WHITE;
 
-    static const ullint CORNERS = 9295429630892703873L;
+    static const ullint CORNERS = BoardGeometry<BOARD_SIZE>::CORNERS;
+
+    // Rotations and reflections of the board. Transform t mirrors the columns if t & 1, then the rows
+    // if t & 2, then transposes if t & 4; transform 0 is the identity.
+    static const int SYMMETRIES = 8;
 
     ullint pieces[2];
 
@@ -52,43 +121,53 @@ public:
 
     ullint blankBoard();
 
-    ullint highestOrderBit(ullint num);
+    bool isCorner(ullint position);
 
-    Coordinate longToCoordinate(ullint position);
+    bool isMoveLegal(int color, Square square);
 
-    ullint coordinateToLong(Coordinate c);
+    /**
+     * Returns the set of squares the player can move to as a bitboard
+     */
+    ullint legalMoves(int player);
 
-    vector<Coordinate> longToCoordinateList(ullint position);
+    /**
+     * Returns the discs that color would flip by playing on square, without changing the board
+     */
+    ullint flips(int color, Square square);
 
-    bool isCorner(ullint position);
+    /**
+     * Plays the move and returns the flipped discs, to be handed back to undoMove.
+     * Passing (SQUARE_PASS) leaves the board untouched.
+     */
+    ullint makeMove(int color, Square square);
 
-    bool isMoveLegal(int color, Coordinate coordinate);
+    void undoMove(int color, Square square, ullint flipped);
 
-    vector<Coordinate> legalMoves(int player);
+    int numberOfPieces(int player);
 
-    bool makeMove(int color, Coordinate coordinate);
+    int numberOfStablePieces(int player);
 
-    vector<Coordinate> moveEndPoints(int color, Coordinate coordinate);
+    void setPieceAtPosition(int color, ullint position);
 
     /**
-     * Takes the player and a starting position with a shift function.
-     * Returns the end point (or last point that we can flip in the given direction)
-     * If no flips can be made, returns -1
+     * The smallest (player, opponent) pair over the 8 symmetries, with the transform that gives it.
+     * Mirrored positions share a key, so caches, the book and deduplication store them once.
      */
-    Coordinate moveEndPointInDirection(int color, ullint startPosition, shiftFunction func);
+    CanonicalKey canonicalKey(int player) const;
 
-    vector<Coordinate> movesInDirection(int player, shiftFunction func);
+    ReversiBoard transformed(int transform) const;
 
-    int numberOfPieces(int player);
+    static ullint transformPieces(ullint pieces, int transform);
 
-    int numberOfStablePieces(int player);
+    static Square transformSquare(Square square, int transform);
 
-    void setPieceAtPosition(int color, ullint position);
+    /**
+     * The transform that undoes the given one, e.g. to map a move found on the canonical board back
+     */
+    static int inverseTransform(int transform);
 
     void printBoard();
 
-    bool validEndPoint(int color, ullint position);
-
     string bitToString(ullint pieces);
 };
 
@@ -1,6 +1,8 @@
 #ifndef REVERSICOMMON_H
 #define REVERSICOMMON_H
 
+#include "boardgeometry.h"
+
 #include <algorithm>
 #include <cstdio>
 #include <iostream>
@@ -10,7 +12,6 @@
 #include <sstream>
 #include <vector>
 
-#define BOARD_SIZE 8
 #define NO_OF_DIRECTIONS 8
 
 using namespace std;
@@ -69,7 +70,7 @@ namespace reversi {
         public:
             int value;
             Move move;
-            MoveValue(int value, Move &move): value(value), move(move) {
+            MoveValue(int value, const Move &move): value(value), move(move) {
             }
             MoveValue(int value, int x, int y): value(value), move(x, y) {
             }
@@ -152,36 +153,6 @@ namespace reversi {
             return maxPlayerScore - minPlayerScore;
         }
 
-        static string formatInfinity(int value) {
-            if (value == INF_POS) {
-                return "Infinity";
-            } else if (value == INF_NEG) {
-                return "-Infinity";
-            } else {
-                return toString(value);
-            }
-        }
-
-        static string toString(int integer) {
-            ostringstream ss;
-            ss << integer;
-            return ss.str();
-        }
-
-        static vector<string> formatLog(Move move, int depth, int value, int alpha, int beta) {
-            vector<string> log;
-            bool forceRoot = false;
-            if (depth == 0) {
-                forceRoot = true;
-            }
-            log.push_back(formatMove(move, forceRoot));
-            log.push_back(toString(depth));
-            log.push_back(formatInfinity(value));
-            log.push_back(formatInfinity(alpha));
-            log.push_back(formatInfinity(beta));
-            return log;
-        }
-
         static string formatMove(Move move, bool forceRoot=false) {
             if (move.rootMove() || forceRoot) {
                 return string("root");
@@ -192,16 +163,11 @@ namespace reversi {
             int x = move.x, y = move.y;
             char row = char('1') + x;
             char column = COLUMN_NAMES[y];
-            char moveFormatted[2];
+            char moveFormatted[3];
             sprintf(moveFormatted, "%c%c", column, row);
             return string(moveFormatted);
         }
 
-        void logMove(Move move, int depth, int value, int alpha, int beta) {
-            vector<string> log = formatLog(move, depth, value, alpha, beta);
-            traverseLog.push_back(log);
-        }
-
         static map<int, vector<int> > makeMove(Move move, vector<vector<char> > &board, char player) {
             map<int, vector<int> > flips;
             if (move.empty()) {
@@ -352,22 +318,12 @@ namespace reversi {
             return validMovesList;
         }
 
-        bool terminalTest(int depth, int cutoffDepth, vector<Move> &p_validMoves, char t_player) {
-            char t_opponent = t_player == 'X'? 'O' : 'X';
-            DiscsAndStableDiscs discs = numberOfDiscsAndStableDiscs(currentState);
-            map<char, int> noOfDiscs = discs.numberOfDiscs;
-            bool noPlayerDiscs = noOfDiscs[m_player] == 0 || noOfDiscs[m_opponent] == 0;
-            return (depth >= cutoffDepth || (p_validMoves.size() == 0 && passes == 2) || noPlayerDiscs);
-        }
-
     protected:
         vector<vector<char> > currentState;
         char m_player;
         bool prune;
         char m_opponent;
         int task;
-        vector<vector<string> > traverseLog;
-        int traverseLogLength;
         int passes;
     };
 };
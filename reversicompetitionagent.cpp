@@ -1,15 +1,23 @@
 #include "reversicompetitionagent.h"
+#include "boardfeatures.h"
+#include "profiler.h"
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstring>
 #include <fstream>
 #include <limits>
+#include <sstream>
 
 using namespace reversi;
 using namespace std;
 
 ReversiCompetitionAgent::ReversiCompetitionAgent(vector< vector< char > >& currentState, char player, char opponent, double cpuTime):
-                                                 cpuTime(cpuTime), board(currentState) {
+                                                 cpuTime(cpuTime), board(currentState), prune(true), nodeCount(0),
+                                                 control(NULL), aborted(false) {
+    memcpy(heuristic, EngineConfig::defaultWeights(), sizeof(heuristic));
+    heuristicCompare.heuristic = heuristic;
     if (player == 'X') {
         m_player = 0;
         m_opponent = 1;
@@ -21,39 +29,66 @@ ReversiCompetitionAgent::ReversiCompetitionAgent(vector< vector< char > >& curre
     }
 }
 
-double ReversiCompetitionAgent::evaluateScore(char player, Coordinate& action, vector< Coordinate >& playerMoves) {
-    int opponent = 1 - player;
+ReversiCompetitionAgent::ReversiCompetitionAgent(const ReversiBoard& board, int player, const EngineConfig& config):
+                                                 cpuTime(config.cpuTime), board(board), prune(config.prune),
+                                                 nodeCount(0), control(NULL), aborted(false) {
+    memcpy(heuristic, config.weights, sizeof(heuristic));
+    heuristicCompare.heuristic = heuristic;
+    m_player = player;
+    m_opponent = 1 - player;
+    if (config.depth > 0) {
+        cutoffDepth = config.depth;
+    } else {
+        cutoffDepth = player == ReversiBoard::BLACK ? 4 : 5;
+    }
+    if (!config.networkPath.empty()) {
+        network = NnueNetwork::load(config.networkPath);
+    }
+    if (network) {
+        accumulators.reset(network.get(), this->board);
+    }
+}
 
-    // Make the move and get the number of moves the opponent can make
-    vector<Coordinate> opponentMoves = board.legalMoves(opponent);
+double ReversiCompetitionAgent::evaluateScore(int player, Square action, ullint playerMoves) {
+    PROFILE_SCOPE(PROFILE_EVALUATE);
+    int opponent = 1 - player;
 
-    // Mobility ratio or number of moves
-    double noOfPlayerMoves = max(1.0, (double) playerMoves.size());
-    double noOfOpponentMoves = max(1.0, (double) opponentMoves.size());
-    double mobilityRatio = noOfPlayerMoves / noOfOpponentMoves;
+    if (network) {
+        // The network scores the side to move, the search wants the root player's view
+        double value;
+        if (!playerMoves && !features::mobility(board.pieces[opponent], board.pieces[player])) {
+            value = board.numberOfPieces(player) - board.numberOfPieces(opponent);
+        } else {
+            value = accumulators.evaluate(player);
+        }
+        return player == m_player ? value : -value;
+    }
 
     // Heuristic
-    double heuristic = 1.0;
-    if (!action.empty()) {
-        heuristic = (double) HEURISTIC[action.x][action.y];
+    double moveWeight = 1.0;
+    if (action < NO_OF_SQUARES) {
+        moveWeight = (double) heuristic[squareRow(action)][squareColumn(action)];
     }
 
-    // Disc ratio
-    double noOfPlayerDiscs = max(1.0, (double) board.numberOfPieces(player));
-    double noOfOpponentDiscs = max(1.0, (double) board.numberOfPieces(opponent));
-    double discRatio = noOfPlayerDiscs / noOfOpponentDiscs;
-
-    // Stable disc ratio: count the number of unflippable discs and get the ratio
-    double noOfPlayerStableDiscs = max(1.0, (double) board.numberOfStablePieces(player));
-    double noOfOpponentStableDiscs = max(1.0, (double) board.numberOfStablePieces(opponent));
-    double stableDiscRatio = noOfPlayerStableDiscs / noOfOpponentStableDiscs;
+    return features::competitionEvaluation(board, player, playerMoves, moveWeight);
+}
 
-    double value = (heuristic * discRatio * stableDiscRatio * mobilityRatio);
+ullint ReversiCompetitionAgent::playMove(int player, Square action) {
+    ullint flipped = board.makeMove(player, action);
+    if (network) {
+        accumulators.push(player, action, flipped);
+    }
+    return flipped;
+}
 
-    return value;
+void ReversiCompetitionAgent::takeBackMove(int player, Square action, ullint flipped) {
+    board.undoMove(player, action, flipped);
+    if (network) {
+        accumulators.pop();
+    }
 }
 
-void ReversiCompetitionAgent::orderValidMoves(vector< Coordinate >& moves) {
+void ReversiCompetitionAgent::orderValidMoves(vector< Square >& moves) {
     // Order moves according to their current heuristic value
     std::sort(moves.begin(), moves.end(), heuristicCompare);
 }
@@ -62,12 +97,12 @@ bool ReversiCompetitionAgent::isMaxPlayer(int player) {
     return player == m_player;
 }
 
-Node ReversiCompetitionAgent::iterativeDeepening(int depth, double alpha, double beta, Coordinate &move, int player) {
+Node ReversiCompetitionAgent::iterativeDeepening(int depth, double alpha, double beta, Square move, int player) {
     chrono::time_point<chrono::system_clock> playerStart, playerEnd;
-    int moves = readMoves();
-    double timeRemaining = cpuTime / ((double) (max(1, 32 - moves)));
+    // cpuTime is what is left on the clock, this move gets its share of it
+    double timeRemaining = EngineConfig::moveTime(cpuTime, popCount(board.blankBoard()));
     playerStart = chrono::system_clock::now();
-    Node node(NEG_INF, Coordinate(-2, -2));
+    Node node(NEG_INF, SQUARE_PASS);
     for (int d = 2; d < 8; d++) {
         cutoffDepth = d;
         Node newNode = minMax(d, alpha, beta, move, player);
@@ -79,13 +114,11 @@ Node ReversiCompetitionAgent::iterativeDeepening(int depth, double alpha, double
         double playerSeconds = playerDuration.count();
         cout << timeRemaining << " " << playerSeconds << " " << (!definitelyGreaterThan(timeRemaining, playerSeconds, 0.5)) << endl;
         if (!definitelyGreaterThan(timeRemaining, playerSeconds, 0.5)) {
-            writeMoves(moves + 1);
             cout << endl;
             return node;
         }
     }
     cout << endl;
-    writeMoves(moves + 1);
     return node;
 }
 
@@ -94,45 +127,21 @@ bool ReversiCompetitionAgent::definitelyGreaterThan(float a, float b, float epsi
     return (a - b) > ( (fabs(a) < fabs(b) ? fabs(b) : fabs(a)) * epsilon);
 }
 
-int ReversiCompetitionAgent::readMoves() {
-    char moveFormatted[18];
-    sprintf(moveFormatted, "numberofmoves%d.txt", m_player);
-    ifstream inputFile(string(moveFormatted).c_str());
-    if (!inputFile.is_open()) {
-        writeMoves(1);
-        return 0;
-    }
-    int moves;
-    inputFile >> moves;
-    inputFile.close();
-    return moves;
-}
-
-void ReversiCompetitionAgent::writeMoves(int moves) {
-    char moveFormatted[18];
-    sprintf(moveFormatted, "numberofmoves%d.txt", m_player);
-    ofstream outputFile(string(moveFormatted).c_str());
-    outputFile << (moves);
-    outputFile.close();
+void ReversiCompetitionAgent::play() {
+    Node node = search();
+    writeOutput(node.move);
 }
 
-
-void ReversiCompetitionAgent::play() {
+Node ReversiCompetitionAgent::search() {
     double alpha = NEG_INF, beta = POS_INF;
-    Coordinate move(-2, -2);
-    Node node = minMax(0, alpha, beta, move, m_player);
-    writeOutput(node.move);
+    return minMax(0, alpha, beta, SQUARE_PASS, m_player);
 }
 
-Node ReversiCompetitionAgent::minMax(int depth, double alpha, double beta, Coordinate& move, int player) {
+Node ReversiCompetitionAgent::minMax(int depth, double alpha, double beta, Square move, int player) {
+    nodeCount++;
     // First get the valid moves
-    vector<Coordinate> playerMoves = board.legalMoves(player);
+    ullint playerMoves = board.legalMoves(player);
     double value;
-//     cout << m_player << " " << player << " " << move.toString() << " : ";
-//     for (Coordinate c: playerMoves) {
-//         cout << c.toString() << " ";
-//     }
-//     cout << endl;
 
     if (shouldStopSearch(depth, playerMoves)) {
         value = evaluateScore(player, move, playerMoves);
@@ -141,19 +150,22 @@ Node ReversiCompetitionAgent::minMax(int depth, double alpha, double beta, Coord
 
     bool maxPlayer = isMaxPlayer(player);
     value = maxPlayer ? NEG_INF : POS_INF;
-    Coordinate bestMove(-2, -2);
+    Square bestMove = SQUARE_PASS;
 
-    for (Coordinate action: playerMoves) {
-        ReversiBoard copyBoard = board.clone();
-
-        board.makeMove(player, action);
+    ullint remainingMoves = playerMoves;
+    while (remainingMoves) {
+        Square action = popFirstSquare(remainingMoves);
+        ullint flipped = playMove(player, action);
         Node childNode = minMax(depth + 1, alpha, beta, action, 1 - player);
-        board = copyBoard;
+        takeBackMove(player, action, flipped);
 
         if ((maxPlayer && childNode.value > value) || (!maxPlayer && childNode.value < value)) {
             bestMove = action;
             value = childNode.value;
         }
+        if (!prune) {
+            continue;
+        }
         if ((maxPlayer && value >= beta) || (!maxPlayer && value <= alpha)) {
             return Node(value, bestMove);
         }
@@ -166,21 +178,276 @@ Node ReversiCompetitionAgent::minMax(int depth, double alpha, double beta, Coord
     return Node(value, bestMove);
 }
 
-bool ReversiCompetitionAgent::shouldStopSearch(int depth, vector< Coordinate >& moves) {
+long long ReversiCompetitionAgent::nodes() const {
+    return nodeCount;
+}
+
+void ReversiCompetitionAgent::setControl(const SearchControl *control) {
+    this->control = control;
+}
+
+bool ReversiCompetitionAgent::stopped() const {
+    return aborted;
+}
+
+vector<AnalysedMove> ReversiCompetitionAgent::analyse(int topK) {
+    TranspositionTable table;
+    return analyse(topK, table);
+}
+
+vector<AnalysedMove> ReversiCompetitionAgent::analyse(int topK, TranspositionTable &table) {
+    SearchTask<vector<AnalysedMove> > task = rootAnalysis(topK, table, false);
+    resumePoint = task.start();
+    while (!task.done()) {
+        resumeInterleaved();
+    }
+    return move(task.result());
+}
+
+SearchTask<vector<AnalysedMove> > ReversiCompetitionAgent::analyseInterleaved(int topK, TranspositionTable &table) {
+    SearchTask<vector<AnalysedMove> > task = rootAnalysis(topK, table, true);
+    resumePoint = task.start();
+    return task;
+}
+
+void ReversiCompetitionAgent::resumeInterleaved() {
+    coroutine_handle<> next = resumePoint;
+    resumePoint = NULL;
+    next.resume();
+}
+
+SearchTask<vector<AnalysedMove> > ReversiCompetitionAgent::rootAnalysis(int topK, TranspositionTable &table,
+                                                                       bool interleave) {
+    aborted = false;
+    vector<AnalysedMove> moves;
+    // Exact values found so far, best first; a move has to beat the topK-th of them to be searched exactly
+    vector<double> exactValues;
+
+    ullint remainingMoves = board.legalMoves(m_player);
+    while (remainingMoves) {
+        Square action = popFirstSquare(remainingMoves);
+        double alpha = NEG_INF;
+        if (topK > 0 && (int) exactValues.size() >= topK) {
+            alpha = exactValues[topK - 1];
+        }
+        ullint flipped = playMove(m_player, action);
+        double value;
+        if (interleave) {
+            value = co_await interleavedSearch(table, 1, alpha, POS_INF, action, m_opponent);
+        } else {
+            value = tableSearch(table, 1, alpha, POS_INF, action, m_opponent);
+        }
+        if (aborted) {
+            takeBackMove(m_player, action, flipped);
+            break;
+        }
+        AnalysedMove analysed(action, value, value <= alpha ? TranspositionTable::UPPER : TranspositionTable::EXACT);
+        analysed.pv = principalVariation(table, action);
+        takeBackMove(m_player, action, flipped);
+
+        if (analysed.bound == TranspositionTable::EXACT) {
+            exactValues.insert(upper_bound(exactValues.begin(), exactValues.end(), value, greater<double>()), value);
+        }
+        moves.push_back(analysed);
+    }
+
+    rankAnalysis(moves, topK);
+    co_return moves;
+}
+
+void ReversiCompetitionAgent::rankAnalysis(vector<AnalysedMove> &moves, int topK) {
+    // Stable, so equal moves keep the order search() would pick them in
+    stable_sort(moves.begin(), moves.end(), [](const AnalysedMove &a, const AnalysedMove &b) {
+        if (a.value != b.value) {
+            return a.value > b.value;
+        }
+        return a.bound == TranspositionTable::EXACT && b.bound != TranspositionTable::EXACT;
+    });
+    if (topK > 0 && (int) moves.size() > topK) {
+        moves.erase(moves.begin() + topK, moves.end());
+    }
+}
+
+bool ReversiCompetitionAgent::tableCutoff(const TranspositionEntry &entry, int remaining, double alpha, double beta) {
+    return entry.remaining == remaining && (entry.bound == TranspositionTable::EXACT
+            || (entry.bound == TranspositionTable::LOWER && entry.value >= beta)
+            || (entry.bound == TranspositionTable::UPPER && entry.value <= alpha));
+}
+
+uint8_t ReversiCompetitionAgent::resultBound(double value, double alpha, double beta) {
+    if (prune && value <= alpha) {
+        return TranspositionTable::UPPER;
+    } else if (prune && value >= beta) {
+        return TranspositionTable::LOWER;
+    }
+    return TranspositionTable::EXACT;
+}
+
+bool ReversiCompetitionAgent::settledNode(int depth, Square move, int player, ullint &playerMoves, double &value) {
+    nodeCount++;
+    // Checking the clock is cheap next to a few thousand nodes
+    if (aborted || (control && (nodeCount & 4095) == 0 && control->expired(nodeCount))) {
+        aborted = true;
+        value = 0.0;
+        return true;
+    }
+    playerMoves = board.legalMoves(player);
+    if (shouldStopSearch(depth, playerMoves)) {
+        value = evaluateScore(player, move, playerMoves);
+        return true;
+    }
+    return false;
+}
+
+bool ReversiCompetitionAgent::tableHit(TranspositionTable &table, ullint key, int remaining, double alpha,
+                                       double beta, double &value, Square &hashMove) {
+    TranspositionEntry entry;
+    hashMove = SQUARE_NONE;
+    if (!table.probe(key, entry)) {
+        return false;
+    }
+    if (tableCutoff(entry, remaining, alpha, beta)) {
+        value = entry.value;
+        return true;
+    }
+    hashMove = entry.best;
+    return false;
+}
+
+double ReversiCompetitionAgent::tableSearch(TranspositionTable &table, int depth, double alpha, double beta,
+                                            Square move, int player) {
+    ullint playerMoves;
+    double value;
+    if (settledNode(depth, move, player, playerMoves, value)) {
+        return value;
+    }
+    int remaining = cutoffDepth - depth;
+    ullint key = TranspositionTable::hash(board, player, move, m_player);
+    Square hashMove;
+    if (tableHit(table, key, remaining, alpha, beta, value, hashMove)) {
+        return value;
+    }
+
+    MoveLoop loop(playerMoves, hashMove, isMaxPlayer(player), alpha, beta, prune);
+    Square action;
+    while (loop.next(action)) {
+        ullint flipped = playMove(player, action);
+        double childValue = tableSearch(table, depth + 1, loop.alpha, loop.beta, action, 1 - player);
+        takeBackMove(player, action, flipped);
+        if (aborted) {
+            // Nothing from an unfinished subtree goes into the table
+            return 0.0;
+        }
+        loop.searched(action, childValue);
+    }
+
+    table.store(key, loop.value, remaining, resultBound(loop.value, alpha, beta), loop.bestMove);
+    return loop.value;
+}
+
+SearchTask<double> ReversiCompetitionAgent::interleavedSearch(TranspositionTable &table, int depth, double alpha,
+                                                             double beta, Square move, int player) {
+    ullint playerMoves;
+    double value;
+    if (settledNode(depth, move, player, playerMoves, value)) {
+        co_return value;
+    }
+    int remaining = cutoffDepth - depth;
+    ullint key = TranspositionTable::hash(board, player, move, m_player);
+    co_await TablePrefetch(table, key, resumePoint);
+    Square hashMove;
+    if (tableHit(table, key, remaining, alpha, beta, value, hashMove)) {
+        co_return value;
+    }
+
+    MoveLoop loop(playerMoves, hashMove, isMaxPlayer(player), alpha, beta, prune);
+    Square action;
+    while (loop.next(action)) {
+        ullint flipped = playMove(player, action);
+        // Only nodes with grandchildren get a coroutine of their own. The parents of leaves, most of the nodes
+        // that probe, have their slot prefetched here and are searched in place; leaves never probe.
+        double childValue;
+        if (depth + 2 < cutoffDepth) {
+            childValue = co_await interleavedSearch(table, depth + 1, loop.alpha, loop.beta, action, 1 - player);
+        } else {
+            if (depth + 1 < cutoffDepth) {
+                ullint childKey = TranspositionTable::hash(board, 1 - player, action, m_player);
+                co_await TablePrefetch(table, childKey, resumePoint);
+            }
+            childValue = tableSearch(table, depth + 1, loop.alpha, loop.beta, action, 1 - player);
+        }
+        takeBackMove(player, action, flipped);
+        if (aborted) {
+            co_return 0.0;
+        }
+        loop.searched(action, childValue);
+    }
+
+    table.store(key, loop.value, remaining, resultBound(loop.value, alpha, beta), loop.bestMove);
+    co_return loop.value;
+}
+
+vector<Square> ReversiCompetitionAgent::principalVariation(TranspositionTable &table, Square move) {
+    vector<Square> pv(1, move);
+    vector<ullint> flips;
+    int player = m_opponent;
+    for (int depth = 1; depth < cutoffDepth; depth++) {
+        TranspositionEntry entry;
+        if (!table.probe(TranspositionTable::hash(board, player, pv.back(), m_player), entry)
+                || entry.best >= NO_OF_SQUARES || !board.isMoveLegal(player, entry.best)) {
+            break;
+        }
+        pv.push_back(entry.best);
+        flips.push_back(playMove(player, entry.best));
+        player = 1 - player;
+    }
+    // Take the line back, last move first
+    for (int i = (int) flips.size() - 1; i >= 0; i--) {
+        player = 1 - player;
+        takeBackMove(player, pv[i + 1], flips[i]);
+    }
+    return pv;
+}
+
+string AnalysedMove::toString() const {
+    ostringstream ss;
+    ss << squareToString(move) << ' ' << value << ' ' << (bound == TranspositionTable::EXACT ? "exact" : "upper");
+    for (size_t i = 1; i < pv.size(); i++) {
+        ss << ' ' << squareToString(pv[i]);
+    }
+    return ss.str();
+}
+
+void ReversiCompetitionAgent::writeAnalysis(const vector<AnalysedMove> &moves) {
+    ofstream outputFile("output.txt");
+    if(!outputFile.is_open()) {
+        cout << "Failed to write output to: output.txt" << endl;
+        return;
+    }
+    for (const AnalysedMove &move: moves) {
+        outputFile << move.toString() << endl;
+    }
+    if (moves.empty()) {
+        outputFile << squareToString(SQUARE_PASS) << endl;
+    }
+    outputFile.close();
+}
+
+bool ReversiCompetitionAgent::shouldStopSearch(int depth, ullint moves) {
     // See if we should stop searching considering the depth and the number of valid moves we have
-    if (moves.size() == 0 || depth >= cutoffDepth) {
+    if (moves == 0 || depth >= cutoffDepth) {
         return true;
     }
     return false;
 }
 
-void ReversiCompetitionAgent::writeOutput(Coordinate &move) {
+void ReversiCompetitionAgent::writeOutput(Square move) {
     ofstream outputFile("output.txt");
     if(!outputFile.is_open()) {
         cout << "Failed to write output to: output.txt" << endl;
         return;
     }
-    outputFile << move.toString();
+    outputFile << squareToString(move);
     outputFile.close();
 }
 
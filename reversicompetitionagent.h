@@ -1,11 +1,17 @@
 #ifndef REVERSICOMPETITIONAGENT_H
 #define REVERSICOMPETITIONAGENT_H
 
-#include "coordinate.h"
+#include "engineconfig.h"
+#include "nnue.h"
 #include "reversiboard.h"
 #include "reversicommon.h"
+#include "searchtask.h"
+#include "transpositiontable.h"
 
+#include <atomic>
+#include <chrono>
 #include <limits>
+#include <memory>
 
 using namespace reversi;
 using namespace std;
@@ -30,26 +36,112 @@ public:
     double upperbound;
     double lowerbound;
     string state;
-    Coordinate move;
+    Square move;
 
-    Node(double value, Coordinate move) : value(value), move(move) {
+    Node(double value, Square move) : value(value), move(move) {
+    }
+};
+
+/**
+ * A root move scored by ReversiCompetitionAgent::analyse, with the line the search expects to follow
+ */
+class AnalysedMove {
+public:
+    Square move;
+    double value;
+    // TranspositionTable::EXACT, or UPPER when the move was only shown to be no better than value
+    uint8_t bound;
+    // Starts with the move itself
+    vector<Square> pv;
+
+    AnalysedMove(Square move, double value, uint8_t bound): move(move), value(value), bound(bound) {
+    }
+
+    string toString() const;
+};
+
+/**
+ * When a search has to give up early: a flag another thread may set, a deadline and a node budget.
+ * Each is optional, a default constructed control never stops.
+ */
+class SearchControl {
+public:
+    const atomic<bool> *stopFlag;
+    // A second flag, for a caller that cancels searches on its own besides stopFlag
+    const atomic<bool> *cancelFlag;
+    bool hasDeadline;
+    chrono::steady_clock::time_point deadline;
+    // 0 for no limit
+    long long nodeLimit;
+
+    SearchControl(): stopFlag(NULL), cancelFlag(NULL), hasDeadline(false), nodeLimit(0) {
+    }
+
+    bool expired(long long nodes) const {
+        return (stopFlag && stopFlag->load(memory_order_relaxed))
+               || (cancelFlag && cancelFlag->load(memory_order_relaxed)) || (nodeLimit > 0 && nodes >= nodeLimit)
+               || (hasDeadline && chrono::steady_clock::now() >= deadline);
     }
 };
 
 class ReversiCompetitionAgent {
 public:
     ReversiCompetitionAgent(vector< vector< char > >& currentState, char player, char opponent, double cpuTime);
+    ReversiCompetitionAgent(const ReversiBoard& board, int player, const EngineConfig& config);
 
     struct HeuristicCompare {
-        bool operator()(Coordinate m1, Coordinate m2) {
-            int x1 = m1.x, y1 = m1.y;
-            int x2 = m2.x, y2 = m2.y;
-            return HEURISTIC[x1][y1] > HEURISTIC[x2][y2];
+        const int (*heuristic)[BOARD_SIZE];
+        bool operator()(Square m1, Square m2) {
+            return heuristic[squareRow(m1)][squareColumn(m1)] > heuristic[squareRow(m2)][squareColumn(m2)];
         }
     } heuristicCompare;
 
     void play();
 
+    /**
+     * Searches the current position in memory and returns the chosen move, SQUARE_PASS if there is none
+     */
+    Node search();
+
+    /**
+     * Scores every legal move at the cutoff depth and returns them best first. With topK > 0 only the
+     * best topK moves get exact scores and are returned; the table is shared by the per-move searches
+     * and may be reused across calls. Callers start a table generation (newSearch) per move, not per call.
+     */
+    vector<AnalysedMove> analyse(int topK, TranspositionTable &table);
+
+    vector<AnalysedMove> analyse(int topK = 0);
+
+    /**
+     * analyse(topK, table) as a coroutine that prefetches the table slot before every probe and suspends
+     * until resumeInterleaved() is called again, so that one thread can keep several searches in flight
+     * and run the others while the slot loads. Nothing runs before the first resumeInterleaved().
+     */
+    SearchTask<vector<AnalysedMove> > analyseInterleaved(int topK, TranspositionTable &table);
+
+    /**
+     * Runs the interleaved analysis up to its next table probe or to its end, when its task is done
+     */
+    void resumeInterleaved();
+
+    /**
+     * Writes one analysed move per line to output.txt
+     */
+    void writeAnalysis(const vector<AnalysedMove> &moves);
+
+    long long nodes() const;
+
+    /**
+     * Lets analyse() give up when control expires, it is checked every few thousand nodes.
+     * control must outlive the search.
+     */
+    void setControl(const SearchControl *control);
+
+    /**
+     * Whether the last analyse() gave up before it finished, its results are incomplete if so
+     */
+    bool stopped() const;
+
 private:
     double cpuTime;
     ReversiBoard board;
@@ -57,28 +149,137 @@ private:
     int m_player;
     int m_opponent;
     int cutoffDepth;
+    bool prune;
+    int heuristic[BOARD_SIZE][BOARD_SIZE];
+    long long nodeCount;
+    const SearchControl *control;
+    bool aborted;
+    // Set when the config names a network, which then evaluates instead of the heuristic
+    shared_ptr<const NnueNetwork> network;
+    NnueStack accumulators;
+    // Where resumeInterleaved() carries on
+    coroutine_handle<> resumePoint;
 
     bool isMaxPlayer(int player);
 
-    int readMoves();
-    void writeMoves(int moves);
-
     bool definitelyGreaterThan(float a, float b, float epsilon);
 
-    Node iterativeDeepening(int depth, double alpha, double beta, Coordinate& move, int player);
+    Node iterativeDeepening(int depth, double alpha, double beta, Square move, int player);
 
     // alphabetasearch
-    Node minMax(int depth, double alpha, double beta, Coordinate& move, int player);
+    Node minMax(int depth, double alpha, double beta, Square move, int player);
+
+    /**
+     * The move loop of a node of tableSearch and interleavedSearch: the hash move first, then the others in
+     * square order, keeping the best child and narrowing the window as the children return
+     */
+    class MoveLoop {
+    public:
+        double alpha;
+        double beta;
+        double value;
+        Square bestMove;
+
+        MoveLoop(ullint moves, Square hashMove, bool maxPlayer, double alpha, double beta, bool prune):
+                alpha(alpha), beta(beta), value(maxPlayer ? NEG_INF : POS_INF), bestMove(SQUARE_PASS),
+                remainingMoves(moves), hashMove(SQUARE_NONE), maxPlayer(maxPlayer), prune(prune), cutoff(false) {
+            if (hashMove < NO_OF_SQUARES && (moves & squareBit(hashMove))) {
+                this->hashMove = hashMove;
+                remainingMoves &= ~squareBit(hashMove);
+            }
+        }
+
+        /**
+         * The next move to search, false once all are searched or one of them cut the others off
+         */
+        bool next(Square &action) {
+            if (cutoff) {
+                return false;
+            }
+            if (hashMove != SQUARE_NONE) {
+                action = hashMove;
+                hashMove = SQUARE_NONE;
+                return true;
+            }
+            if (!remainingMoves) {
+                return false;
+            }
+            action = popFirstSquare(remainingMoves);
+            return true;
+        }
+
+        void searched(Square action, double childValue) {
+            if ((maxPlayer && childValue > value) || (!maxPlayer && childValue < value)) {
+                bestMove = action;
+                value = childValue;
+            }
+            if (!prune) {
+                return;
+            }
+            if ((maxPlayer && value >= beta) || (!maxPlayer && value <= alpha)) {
+                cutoff = true;
+            } else if (maxPlayer) {
+                alpha = max(alpha, value);
+            } else {
+                beta = min(beta, value);
+            }
+        }
+
+    private:
+        ullint remainingMoves;
+        Square hashMove;
+        bool maxPlayer;
+        bool prune;
+        bool cutoff;
+    };
+
+    // minMax with a transposition table for cutoffs and move ordering
+    double tableSearch(TranspositionTable &table, int depth, double alpha, double beta, Square move, int player);
+
+    // tableSearch that suspends before each probe, see analyseInterleaved
+    SearchTask<double> interleavedSearch(TranspositionTable &table, int depth, double alpha, double beta,
+                                         Square move, int player);
+
+    // Counts a node of the table searches and settles it without looking at its moves if the search is given
+    // up or the node is a leaf, playerMoves are its moves otherwise
+    bool settledNode(int depth, Square move, int player, ullint &playerMoves, double &value);
+
+    // Whether the table settles the value of a node of the table searches, hashMove is its best move otherwise
+    static bool tableHit(TranspositionTable &table, ullint key, int remaining, double alpha, double beta,
+                         double &value, Square &hashMove);
+
+    /**
+     * The root loop of analyse and analyseInterleaved. With interleave the root moves are searched by
+     * interleavedSearch; without, by tableSearch, and the task runs to the end once resumed.
+     */
+    SearchTask<vector<AnalysedMove> > rootAnalysis(int topK, TranspositionTable &table, bool interleave);
+
+    // Whether a table entry settles the value of a node searched with this window and remaining depth
+    static bool tableCutoff(const TranspositionEntry &entry, int remaining, double alpha, double beta);
+
+    // How value relates to the true value of a node searched with the window alpha, beta
+    uint8_t resultBound(double value, double alpha, double beta);
+
+    // Puts the moves of analyse best first and keeps topK of them
+    static void rankAnalysis(vector<AnalysedMove> &moves, int topK);
+
+    // Follows the best moves stored in the table from the position after move
+    vector<Square> principalVariation(TranspositionTable &table, Square move);
 
     // calculate heuristic
-    double evaluateScore(char player, Coordinate &action, vector<Coordinate> &playerMoves);
+    double evaluateScore(int player, Square action, ullint playerMoves);
+
+    // makeMove / undoMove that keep the network's accumulators in step with the board
+    ullint playMove(int player, Square action);
+
+    void takeBackMove(int player, Square action, ullint flipped);
 
     // order valid moves
-    void orderValidMoves(vector< Coordinate >& moves);
+    void orderValidMoves(vector< Square >& moves);
 
-    void writeOutput(Coordinate& move);
+    void writeOutput(Square move);
 
-    bool shouldStopSearch(int depth, vector<Coordinate> &moves);
+    bool shouldStopSearch(int depth, ullint moves);
 };
 
 #endif // REVERSICOMPETITIONAGENT_H
@@ -0,0 +1,152 @@
+"""
+ctypes binding of libreversi.so (see libreversi.h). Build the library with `make libreversi.so`; it is looked
+up next to this file first, then on the usual library path. The module has a name of its own because Python
+would try to import libreversi.so itself as an extension module.
+
+Boards are two ints, one bit mask per colour, with a1 in the most significant bit: square s = row * 8 + column
+is bit 63 - s.
+"""
+import ctypes
+import os
+
+BOARD_SIZE = 8
+NO_OF_SQUARES = BOARD_SIZE * BOARD_SIZE
+BLACK, WHITE = 0, 1
+PASS = 64
+SOLVE_MAX_EMPTIES = 16
+API_VERSION = 2
+
+
+class SearchResult(ctypes.Structure):
+    _fields_ = [
+        ('move', ctypes.c_int),
+        ('value', ctypes.c_double),
+        ('depth', ctypes.c_int),
+        ('nodes', ctypes.c_longlong),
+        ('seconds', ctypes.c_double),
+        ('stopped', ctypes.c_int),
+        ('pv_length', ctypes.c_int),
+        ('pv', ctypes.c_int * NO_OF_SQUARES)
+    ]
+
+
+def _load():
+    local = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'libreversi.so')
+    lib = ctypes.CDLL(local if os.path.exists(local) else 'libreversi.so')
+    u64, u64p = ctypes.c_uint64, ctypes.POINTER(ctypes.c_uint64)
+    signatures = [
+        ('reversi_api_version', ctypes.c_int, []),
+        ('reversi_initial_position', None, [u64p, u64p]),
+        ('reversi_legal_moves', u64, [u64, u64]),
+        ('reversi_flips', u64, [u64, u64, ctypes.c_int]),
+        ('reversi_make_move', u64, [u64p, u64p, ctypes.c_int]),
+        ('reversi_count', ctypes.c_int, [u64]),
+        ('reversi_engine_new', ctypes.c_void_p, [ctypes.c_char_p]),
+        ('reversi_engine_free', None, [ctypes.c_void_p]),
+        ('reversi_search', ctypes.c_int, [ctypes.c_void_p, u64, u64, ctypes.c_int, ctypes.c_int, ctypes.c_double,
+                                          ctypes.c_longlong, ctypes.POINTER(SearchResult)]),
+        ('reversi_engine_stop', None, [ctypes.c_void_p]),
+        ('reversi_solve', ctypes.c_int, [u64, u64, ctypes.c_int, ctypes.POINTER(ctypes.c_int),
+                                         ctypes.POINTER(ctypes.c_int)])
+    ]
+    for (name, restype, argtypes) in signatures:
+        function = getattr(lib, name)
+        function.restype = restype
+        function.argtypes = argtypes
+    if lib.reversi_api_version() != API_VERSION:
+        raise ImportError("libreversi.so has API version %d, expected %d" % (lib.reversi_api_version(), API_VERSION))
+    return lib
+
+
+_lib = _load()
+
+
+def square_bit(x, y):
+    return 1 << (NO_OF_SQUARES - 1 - (x * BOARD_SIZE + y))
+
+
+def squares(bits):
+    """(row, column) of every square in bits, in row-major order"""
+    result = list()
+    while bits:
+        high = bits.bit_length() - 1
+        square = NO_OF_SQUARES - 1 - high
+        result.append(divmod(square, BOARD_SIZE))
+        bits ^= 1 << high
+    return result
+
+
+def from_state(state, player):
+    """Mask of player's discs on a board of characters"""
+    bits = 0
+    for x in range(BOARD_SIZE):
+        row = state[x]
+        for y in range(BOARD_SIZE):
+            if row[y] == player:
+                bits |= square_bit(x, y)
+    return bits
+
+
+def initial_position():
+    black, white = ctypes.c_uint64(), ctypes.c_uint64()
+    _lib.reversi_initial_position(ctypes.byref(black), ctypes.byref(white))
+    return black.value, white.value
+
+
+def legal_moves(own, opponent):
+    return _lib.reversi_legal_moves(own, opponent)
+
+
+def flips(own, opponent, x, y):
+    return _lib.reversi_flips(own, opponent, x * BOARD_SIZE + y)
+
+
+def make_move(own, opponent, x, y):
+    """(own, opponent, flipped) after own plays (x, y); an illegal move flips nothing and changes nothing"""
+    own_bits, opponent_bits = ctypes.c_uint64(own), ctypes.c_uint64(opponent)
+    flipped = _lib.reversi_make_move(ctypes.byref(own_bits), ctypes.byref(opponent_bits), x * BOARD_SIZE + y)
+    return own_bits.value, opponent_bits.value, flipped
+
+
+def count(bits):
+    return _lib.reversi_count(bits)
+
+
+def solve(black, white, player):
+    """
+    (exact final disc difference for player, best move as (row, column) or None for a pass). Raises ValueError
+    for a position with more than SOLVE_MAX_EMPTIES empty squares.
+    """
+    value, move = ctypes.c_int(), ctypes.c_int()
+    if _lib.reversi_solve(black, white, player, ctypes.byref(value), ctypes.byref(move)) != 0:
+        raise ValueError("Cannot solve a position with more than %d empty squares" % SOLVE_MAX_EMPTIES)
+    return value.value, None if move.value >= NO_OF_SQUARES else divmod(move.value, BOARD_SIZE)
+
+
+class Engine(object):
+    """
+    A search engine with its own transposition table. Separate engines may search on separate threads;
+    stop() may be called from any thread to cut the search in progress short.
+    """
+
+    def __init__(self, spec=''):
+        self._handle = _lib.reversi_engine_new(spec.encode('ascii'))
+        if not self._handle:
+            raise ValueError("Invalid engine spec: %s" % spec)
+
+    def __del__(self):
+        self.close()
+
+    def close(self):
+        if getattr(self, '_handle', None):
+            _lib.reversi_engine_free(self._handle)
+            self._handle = None
+
+    def search(self, black, white, player, depth=0, seconds=0.0, nodes=0):
+        result = SearchResult()
+        if _lib.reversi_search(self._handle, black, white, player, depth, seconds, nodes, ctypes.byref(result)):
+            raise ValueError("Invalid position")
+        return result
+
+    def stop(self):
+        _lib.reversi_engine_stop(self._handle)
@@ -5,56 +5,114 @@
 
 using namespace std;
 
+static int squareWeight(Square square) {
+    return reversi::POS_WEIGHTS_HW[squareRow(square)][squareColumn(square)];
+}
+
+static reversi::ReversiCommon::Move squareToMove(Square square) {
+    if (square == SQUARE_PASS) {
+        return reversi::ReversiCommon::Move(-2, -2, true);
+    } else if (square == SQUARE_NONE) {
+        return reversi::ReversiCommon::Move(-1, -1, true);
+    }
+    return reversi::ReversiCommon::Move(squareRow(square), squareColumn(square));
+}
+
+static const char *OUTPUT_PATH = "output.txt";
+
 ReversiHWAgent::ReversiHWAgent(int cutoffDepth, vector<vector<char> > &currentState, char player, char opponent, int task):
-        cutoffDepth(cutoffDepth), ReversiCommon(currentState, player, opponent, task) {
+        ReversiCommon(currentState, player, opponent, task), cutoffDepth(cutoffDepth), traceColumns(0),
+        board(currentState) {
     prune = false;
     if (task == 1) {
         // Greedy
         cout << "Greedy" << endl;
-        cutoffDepth = 1;
-        traverseLogLength = 0;
+        this->cutoffDepth = 1;
     } else if (task == 2) {
         // MiniMax
         cout << "MiniMax" << endl;
-        traverseLogLength = 3;
+        traceColumns = 3;
     } else if (task == 3) {
         // AlphaBeta
         cout << "AlphaBeta" << endl;
-        traverseLogLength = 5;
+        traceColumns = 5;
         prune = true;
     }
+
+    maxColor = player == 'X' ? ReversiBoard::BLACK : ReversiBoard::WHITE;
+    minColor = 1 - maxColor;
+    discs[ReversiBoard::BLACK] = board.numberOfPieces(ReversiBoard::BLACK);
+    discs[ReversiBoard::WHITE] = board.numberOfPieces(ReversiBoard::WHITE);
+    positionalScore = 0;
+    ullint blackPieces = board.blackPieces(), whitePieces = board.whitePieces();
+    while (blackPieces) {
+        positionalScore += squareWeight(popFirstSquare(blackPieces));
+    }
+    while (whitePieces) {
+        positionalScore -= squareWeight(popFirstSquare(whitePieces));
+    }
+}
+
+ullint ReversiHWAgent::makeMove(int color, Square square) {
+    ullint flipped = board.makeMove(color, square);
+    int noOfFlips = popCount(flipped);
+    discs[color] += noOfFlips + 1;
+    discs[1 - color] -= noOfFlips;
+
+    int delta = squareWeight(square);
+    ullint remaining = flipped;
+    while (remaining) {
+        delta += 2 * squareWeight(popFirstSquare(remaining));
+    }
+    positionalScore += color == ReversiBoard::BLACK ? delta : -delta;
+    return flipped;
 }
 
-reversi::ReversiCommon::MoveValue ReversiHWAgent::minMax(int depth, int alpha, int beta, reversi::ReversiCommon::Move move,
-                                                        bool maxPlayer) {
-    char maxSymbol = maxPlayer? player : opponent;
+void ReversiHWAgent::undoMove(int color, Square square, ullint flipped) {
+    board.undoMove(color, square, flipped);
+    int noOfFlips = popCount(flipped);
+    discs[color] -= noOfFlips + 1;
+    discs[1 - color] += noOfFlips;
+
+    int delta = squareWeight(square);
+    while (flipped) {
+        delta += 2 * squareWeight(popFirstSquare(flipped));
+    }
+    positionalScore -= color == ReversiBoard::BLACK ? delta : -delta;
+}
+
+bool ReversiHWAgent::terminalTest(int depth, ullint moves) {
+    bool noPlayerDiscs = discs[maxColor] == 0 || discs[minColor] == 0;
+    return (depth >= cutoffDepth || (moves == 0 && passes == 2) || noPlayerDiscs);
+}
+
+reversi::ReversiCommon::MoveValue ReversiHWAgent::minMax(int depth, int alpha, int beta, Square move, bool maxPlayer) {
+    int color = maxPlayer? maxColor : minColor;
     // First get the valid moves
-    vector<Move> c_validMoves = validMoves(currentState, maxSymbol);
+    ullint c_validMoves = board.legalMoves(color);
     int value = maxPlayer? reversi::INF_NEG : reversi::INF_POS;
 
     // If the game ends (both players don't have moves or cutoffDepth is reached)
-    if (terminalTest(depth, cutoffDepth, c_validMoves, maxSymbol)) {
+    if (terminalTest(depth, c_validMoves)) {
         // Then we're at a leaf node with no more moves
-        value = evaluateScoreHW(currentState);
-        logMove(move, depth, value, alpha, beta);
-        return MoveValue(value, move);
+        value = positionalScore;
+        trace.log(move, depth, value, alpha, beta);
+        return MoveValue(value, squareToMove(move));
     }
 
-    logMove(move, depth, value, alpha, beta);
+    trace.log(move, depth, value, alpha, beta);
     // Else, the current player might have no moves, so we can pass over
-    if(c_validMoves.size() == 0) {
+    if(c_validMoves == 0) {
         // Then the game hasn't ended, and we can still perform checks for the other player
-        Move bestMove(-2, -2, true);
-        Move passMove(-2, -2, true);
+        Move passMove = squareToMove(SQUARE_PASS);
         passes += 1;
-        MoveValue moveValue = minMax(depth + 1, alpha, beta, bestMove, !maxPlayer);
+        MoveValue moveValue = minMax(depth + 1, alpha, beta, SQUARE_PASS, !maxPlayer);
         if ((maxPlayer && moveValue.value > value) || (!maxPlayer && moveValue.value < value)) {
-            bestMove = moveValue.move;
             value = moveValue.value;
         }
         if(prune) {
             if ((maxPlayer && value >= beta) || (!maxPlayer && value <= alpha)) {
-                logMove(move, depth, value, alpha, beta);
+                trace.log(move, depth, value, alpha, beta);
                 return MoveValue(value, passMove);
             }
             if(maxPlayer) {
@@ -63,23 +121,21 @@ reversi::ReversiCommon::MoveValue ReversiHWAgent::minMax(int depth, int alpha, i
                 beta = min(beta, value);
             }
         }
-        logMove(move, depth, value, alpha, beta);
+        trace.log(move, depth, value, alpha, beta);
         return MoveValue(value, passMove);
     }
 
     passes = 0;
 
-    Move bestMove(-2, -2, true);
-    if (depth == 0) {
-        bestMove = Move(-1, -1, true);
-    }
+    Square bestMove = depth == 0 ? SQUARE_NONE : SQUARE_PASS;
 
-    for (int m = 0; m < c_validMoves.size(); m++) {
-        Move action = c_validMoves[m];
+    ullint remainingMoves = c_validMoves;
+    while (remainingMoves) {
+        Square action = popFirstSquare(remainingMoves);
 
-        map<int, vector<int> > flips = makeMove(action, currentState, maxSymbol);
+        ullint flipped = makeMove(color, action);
         MoveValue childMoveValue = minMax(depth + 1, alpha, beta, action, !maxPlayer);
-        undoMove(action, currentState, maxSymbol, flips);
+        undoMove(color, action, flipped);
 
         if ((maxPlayer && childMoveValue.value > value) || (!maxPlayer && childMoveValue.value < value)) {
             bestMove = action;
@@ -87,8 +143,8 @@ reversi::ReversiCommon::MoveValue ReversiHWAgent::minMax(int depth, int alpha, i
         }
         if(prune) {
             if ((maxPlayer && value >= beta) || (!maxPlayer && value <= alpha)) {
-                logMove(move, depth, value, alpha, beta);
-                return MoveValue(value, bestMove);
+                trace.log(move, depth, value, alpha, beta);
+                return MoveValue(value, squareToMove(bestMove));
             }
             if(maxPlayer) {
                 alpha = max(alpha, value);
@@ -96,58 +152,47 @@ reversi::ReversiCommon::MoveValue ReversiHWAgent::minMax(int depth, int alpha, i
                 beta = min(beta, value);
             }
         }
-        logMove(move, depth, value, alpha, beta);
+        trace.log(move, depth, value, alpha, beta);
     }
-    return MoveValue(value, bestMove);
+    return MoveValue(value, squareToMove(bestMove));
 }
 
 
+void ReversiHWAgent::setBinaryTrace(const string &path) {
+    binaryTracePath = path;
+}
+
 void ReversiHWAgent::play() {
-    vector<string> headers;
-    headers.push_back("Node");
-    headers.push_back("Depth");
-    headers.push_back("Value");
-    headers.push_back("Alpha");
-    headers.push_back("Beta");
-    traverseLog.push_back(headers);
+    bool binary = !binaryTracePath.empty();
+    if (!trace.open(binary ? binaryTracePath : OUTPUT_PATH, traceColumns, binary)) {
+        cout << "Failed to write output to: " << (binary ? binaryTracePath : OUTPUT_PATH) << endl;
+    }
 
     int alpha = reversi::INF_NEG, beta = reversi::INF_POS;
-    Move move(-1, -1, true);
-    MoveValue moveValue = minMax(0, alpha, beta, move, true);
+    MoveValue moveValue = minMax(0, alpha, beta, SQUARE_NONE, true);
     cout << formatMove(moveValue.move) << endl;
     if (!moveValue.move.empty()) {
-        Move move = moveValue.move;
-        makeMove(move, currentState, player);
+        makeMove(maxColor, makeSquare(moveValue.move.x, moveValue.move.y));
     }
     writeOutput();
 }
 
 void ReversiHWAgent::writeOutput() {
-    ofstream outputFile("output.txt");
-    if(!outputFile.is_open()) {
-        cout << "Failed to write output to: output.txt" << endl;
-        return;
+    if (!trace.close(board.blackPieces(), board.whitePieces())) {
+        cout << "Failed to write the traversal log" << endl;
     }
-    // Write the board state
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            outputFile << currentState[i][j];
-        }
-        outputFile << endl;
+    if (binaryTracePath.empty()) {
+        return;
     }
-    if(task != 1) {
-        for (int i = 0; i < traverseLog.size(); i++) {
-            vector<string> parameters = traverseLog[i];
-            string outputString = "";
-            for (int j = 0; j < traverseLogLength; j++) {
-                outputString += parameters[j];
-                if (j != traverseLogLength - 1) {
-                    outputString += ",";
-                }
-            }
-            outputFile << outputString << endl;
-        }
+    // The log went to the binary trace, output.txt only gets the board
+    ofstream outputFile(OUTPUT_PATH);
+    if(!outputFile.is_open()) {
+        cout << "Failed to write output to: " << OUTPUT_PATH << endl;
+        return;
     }
+    char boardText[TraceWriter::BOARD_TEXT_SIZE];
+    TraceWriter::formatBoard(board.blackPieces(), board.whitePieces(), boardText);
+    outputFile.write(boardText, sizeof(boardText));
     outputFile << endl;
     outputFile.close();
 }
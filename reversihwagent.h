@@ -1,7 +1,9 @@
 #ifndef REVERSIHWAGENT_H
 #define REVERSIHWAGENT_H
 
+#include "reversiboard.h"
 #include "reversicommon.h"
+#include "tracewriter.h"
 
 #include <string>
 #include <vector>
@@ -13,10 +15,31 @@ public:
     ReversiHWAgent(int cutoffDepth, vector<vector<char> > &currentState, char player, char opponent, int task);
     void play();
 
+    /**
+     * Writes the traversal log to a binary trace instead of output.txt, see tracedecode
+     */
+    void setBinaryTrace(const string &path);
+
 private:
     int cutoffDepth;
+    int traceColumns;
+    string binaryTracePath;
+    TraceWriter trace;
+
+    ReversiBoard board;
+    int maxColor;
+    int minColor;
+    int discs[2];
+    // POS_WEIGHTS_HW summed over X discs minus O discs, kept in step with the board
+    int positionalScore;
+
+    MoveValue minMax(int depth, int alpha, int beta, Square move, bool max);
+
+    ullint makeMove(int color, Square square);
+
+    void undoMove(int color, Square square, ullint flipped);
 
-    MoveValue minMax(int depth, int alpha, int beta, Move move, bool max);
+    bool terminalTest(int depth, ullint moves);
 
     void writeOutput();
 };
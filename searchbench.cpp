@@ -0,0 +1,193 @@
+#include "interleavedsearch.h"
+#include "position.h"
+#include "reversicompetitionagent.h"
+#include "transpositiontable.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Half of the default positions come from games with at most this many empty squares
+static const int ENDGAME_EMPTIES = 30;
+
+/**
+ * Options of "searchbench key=value ..."
+ */
+class BenchOptions {
+public:
+    // Position::parse lines; without a file the positions of random games, half of them from the endgame
+    string positionsPath;
+    int positions;
+    int depth;
+    // log2 of the table entries, 24 is 16M entries of 24 bytes
+    int tableBits;
+    // Searches in flight per interleaved run
+    vector<int> widths;
+    // Every mode runs this many times, taking turns, and its fastest run counts
+    int samples;
+    EngineConfig engine;
+
+    BenchOptions(): positions(200), depth(6), tableBits(24), widths({2, 4, 8, 16}), samples(3) {
+        engine.name = "searchbench";
+    }
+
+    bool parse(const string &key, const string &value) {
+        if (key == "positions") {
+            if (atoi(value.c_str()) > 0) {
+                positions = atoi(value.c_str());
+            } else {
+                positionsPath = value;
+            }
+        } else if (key == "depth") {
+            depth = max(1, atoi(value.c_str()));
+        } else if (key == "table") {
+            tableBits = min(30, max(10, atoi(value.c_str())));
+        } else if (key == "interleave") {
+            widths.clear();
+            istringstream list(value);
+            string width;
+            while (getline(list, width, ',')) {
+                if (atoi(width.c_str()) < 1) {
+                    cout << "Invalid interleave width: " << width << endl;
+                    return false;
+                }
+                widths.push_back(atoi(width.c_str()));
+            }
+        } else if (key == "samples") {
+            samples = max(1, atoi(value.c_str()));
+        } else if (key == "engine") {
+            return EngineConfig::parseAlphaBeta(value, engine);
+        } else {
+            cout << "Unknown searchbench option: " << key << endl;
+            return false;
+        }
+        return true;
+    }
+};
+
+class Run {
+public:
+    string mode;
+    long long nodes;
+    double seconds;
+    vector<double> values;
+};
+
+/**
+ * Every position one after the other with ReversiCompetitionAgent::analyse, as a batch or scheduler thread does
+ */
+static Run plainRun(const vector<Position> &positions, const EngineConfig &engine, TranspositionTable &table) {
+    Run run;
+    run.mode = "plain";
+    run.nodes = 0;
+    table.setConcurrentSearches(1);
+    chrono::time_point<chrono::steady_clock> start = chrono::steady_clock::now();
+    for (const Position &position: positions) {
+        EngineConfig config = engine;
+        ReversiBoard board = position.board;
+        config.depth = EngineConfig::lastDepth(engine.depth, popCount(board.blankBoard()));
+        ReversiCompetitionAgent agent(position.board, position.player, config);
+        table.newSearch();
+        vector<AnalysedMove> analysed = agent.analyse(1, table);
+        run.values.push_back(analysed.empty() ? 0.0 : analysed[0].value);
+        run.nodes += agent.nodes();
+    }
+    run.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return run;
+}
+
+static Run interleavedRun(const vector<Position> &positions, const EngineConfig &engine, TranspositionTable &table,
+                          int width) {
+    Run run;
+    run.mode = "interleave=" + to_string(width);
+    run.nodes = 0;
+    run.values.resize(positions.size());
+    chrono::time_point<chrono::steady_clock> start = chrono::steady_clock::now();
+    InterleavedSearch search(engine, table, width);
+    size_t added = 0;
+    long long id;
+    SearchInfo info;
+    while (true) {
+        while (added < positions.size() && search.inFlight() < search.width()) {
+            search.add(added, positions[added]);
+            added++;
+        }
+        if (!search.next(id, info)) {
+            break;
+        }
+        run.values[id] = info.value;
+        run.nodes += info.nodes;
+    }
+    run.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return run;
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions options;
+    for (int i = 1; i < argc; i++) {
+        string argument(argv[i]);
+        size_t separator = argument.find('=');
+        if (separator == string::npos) {
+            cout << "Expected key=value, got: " << argument << endl;
+            return 1;
+        }
+        if (!options.parse(argument.substr(0, separator), argument.substr(separator + 1))) {
+            return 1;
+        }
+    }
+
+    vector<Position> positions;
+    if (!options.positionsPath.empty()) {
+        if (!Position::loadPositions(options.positionsPath, positions)) {
+            return 1;
+        }
+    } else {
+        // The second half runs from the middle game to the end. Searches of consecutive positions share most
+        // of their subtrees, for both root sides, so they exercise the table the way a batch of games does.
+        positions = Position::randomGamePositions(options.positions - options.positions / 2, 1);
+        vector<Position> games = Position::randomGamePositions(options.positions / 2, 2, ENDGAME_EMPTIES);
+        positions.insert(positions.end(), games.begin(), games.end());
+    }
+    options.engine.depth = options.depth;
+    TranspositionTable table((size_t) 1 << options.tableBits);
+
+    cout << positions.size() << " positions to depth " << options.depth << ", table of " << table.size()
+         << " entries (" << table.size() * 24 / (1 << 20) << " MB), one thread, best of " << options.samples
+         << endl;
+    cout << setw(16) << left << "mode" << right << setw(12) << "nodes" << setw(10) << "seconds" << setw(10)
+         << "knps" << setw(12) << "positions/s" << setw(10) << "speedup" << setw(12) << "mismatches" << endl;
+    vector<Run> runs(options.widths.size() + 1);
+    for (int sample = 0; sample < options.samples; sample++) {
+        for (size_t i = 0; i < runs.size(); i++) {
+            table.clear();
+            Run run = i == 0 ? plainRun(positions, options.engine, table)
+                             : interleavedRun(positions, options.engine, table, options.widths[i - 1]);
+            if (sample == 0 || run.seconds < runs[i].seconds) {
+                runs[i] = run;
+            }
+        }
+    }
+
+    int failures = 0;
+    for (const Run &run: runs) {
+        // Table replacements differ from run to run, the values at a fixed depth must not
+        int mismatches = 0;
+        for (size_t i = 0; i < positions.size(); i++) {
+            mismatches += fabs(run.values[i] - runs[0].values[i]) > 1e-9;
+        }
+        failures += mismatches;
+        cout << setw(16) << left << run.mode << right << fixed << setw(12) << run.nodes << setprecision(3)
+             << setw(10) << run.seconds << setprecision(0) << setw(10) << run.nodes / run.seconds / 1e3
+             << setprecision(1) << setw(12) << positions.size() / run.seconds << setprecision(2) << setw(10)
+             << runs[0].seconds / run.seconds << setw(12) << mismatches << endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+#include "searchengine.h"
+#include "profiler.h"
+
+#include <sstream>
+
+using namespace std;
+
+string SearchInfo::toString() const {
+    ostringstream ss;
+    ss << "depth " << depth << " value " << value << " nodes " << nodes << " seconds " << seconds << " pv";
+    for (Square square: pv) {
+        ss << ' ' << squareToString(square);
+    }
+    if (pv.empty()) {
+        ss << ' ' << squareToString(move);
+    }
+    return ss.str();
+}
+
+SearchEngine::SearchEngine(const EngineConfig &config): config(config), running(false) {
+}
+
+SearchEngine::~SearchEngine() {
+    stop();
+    wait();
+}
+
+future<SearchInfo> SearchEngine::start(const Position &position, const SearchLimits &limits,
+                                       const ProgressCallback &progress) {
+    lock_guard<mutex> lock(threadMutex);
+    {
+        lock_guard<mutex> stopLock(stopMutex);
+        if (searchStop) {
+            *searchStop = true;
+        }
+    }
+    if (worker.joinable()) {
+        worker.join();
+    }
+    shared_ptr<atomic<bool> > stopFlag = make_shared<atomic<bool> >(false);
+    {
+        lock_guard<mutex> stopLock(stopMutex);
+        searchStop = stopFlag;
+    }
+    running = true;
+    promise<SearchInfo> result;
+    future<SearchInfo> pending = result.get_future();
+    worker = thread(&SearchEngine::run, this, position, limits, progress, move(result), stopFlag);
+    return pending;
+}
+
+void SearchEngine::stop() {
+    lock_guard<mutex> lock(stopMutex);
+    if (searchStop) {
+        *searchStop = true;
+    }
+}
+
+void SearchEngine::wait() {
+    lock_guard<mutex> lock(threadMutex);
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+bool SearchEngine::searching() const {
+    return running;
+}
+
+void SearchEngine::clearTable() {
+    wait();
+    table.clear();
+}
+
+void SearchEngine::run(Position position, SearchLimits limits, ProgressCallback progress,
+                       promise<SearchInfo> result, shared_ptr<atomic<bool> > stopFlag) {
+    chrono::time_point<chrono::steady_clock> start = chrono::steady_clock::now();
+    SearchControl control;
+    control.stopFlag = stopFlag.get();
+    control.cancelFlag = limits.cancel;
+    if (limits.time > 0.0) {
+        control.hasDeadline = true;
+        control.deadline = start + chrono::duration_cast<chrono::steady_clock::duration>(
+                chrono::duration<double>(limits.time));
+    }
+
+    SearchInfo best;
+    ullint moves = position.board.legalMoves(position.player);
+    if (moves) {
+        // Something legal to fall back on if even the first iteration is cut short
+        best.move = firstSquare(moves);
+    }
+    int lastDepth = EngineConfig::lastDepth(limits.depth, popCount(position.board.blankBoard()));
+
+    // One table generation per search, its iterations keep each other's entries
+    table.newSearch();
+    EngineConfig iterationConfig = config;
+    for (int depth = 1; moves && depth <= lastDepth; depth++) {
+        if (control.expired(0)) {
+            best.stopped = true;
+            break;
+        }
+        if (limits.nodes > 0) {
+            if (best.nodes >= limits.nodes) {
+                best.stopped = true;
+                break;
+            }
+            control.nodeLimit = limits.nodes - best.nodes;
+        }
+        iterationConfig.depth = depth;
+        ReversiCompetitionAgent agent(position.board, position.player, iterationConfig);
+        agent.setControl(&control);
+        vector<AnalysedMove> analysed = agent.analyse(1, table);
+        best.nodes += agent.nodes();
+        if (agent.stopped() || analysed.empty()) {
+            best.stopped = true;
+            break;
+        }
+
+        best.move = analysed[0].move;
+        best.value = analysed[0].value;
+        best.pv = analysed[0].pv;
+        best.depth = depth;
+        best.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (progress) {
+            progress(best);
+        }
+    }
+    best.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    PROFILE_REPORT(cerr);
+    {
+        // Done before the result is set: whoever waits for it may stop or start again straight away
+        lock_guard<mutex> lock(stopMutex);
+        if (searchStop == stopFlag) {
+            searchStop.reset();
+        }
+    }
+    running = false;
+    result.set_value(best);
+}
@@ -0,0 +1,117 @@
+#ifndef SEARCHENGINE_H
+#define SEARCHENGINE_H
+
+#include "engineconfig.h"
+#include "position.h"
+#include "reversicompetitionagent.h"
+#include "transpositiontable.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * How far a search may go. Every limit is optional, 0 means none; with no limit at all the search runs to the
+ * last empty square or until it is stopped.
+ */
+class SearchLimits {
+public:
+    int depth;
+    // Seconds, the iteration that is running when they run out is abandoned
+    double time;
+    // Checked every few thousand nodes, so it may be overrun by that much
+    long long nodes;
+    // Stops the search when set, also when it was set before the search started. Unlike SearchEngine::stop()
+    // it belongs to the caller, who decides which search it applies to.
+    const atomic<bool> *cancel;
+
+    SearchLimits(): depth(0), time(0.0), nodes(0), cancel(NULL) {
+    }
+};
+
+/**
+ * Result of one completed iteration, which is also what the search returns in the end
+ */
+class SearchInfo {
+public:
+    Square move;
+    double value;
+    int depth;
+    // Starts with move
+    vector<Square> pv;
+    // Over all iterations so far
+    long long nodes;
+    double seconds;
+    // Set on the final result when a stop request or a limit cut the search short
+    bool stopped;
+
+    SearchInfo(): move(SQUARE_PASS), value(0.0), depth(0), nodes(0), seconds(0.0), stopped(false) {
+    }
+
+    string toString() const;
+};
+
+typedef function<void(const SearchInfo &)> ProgressCallback;
+
+/**
+ * Iterative deepening search that runs on a thread of its own, for embedding the engine in a service.
+ * start() returns at once with a future for the result, stop() may be called from any thread and the
+ * progress callback hears about every completed depth, on the search thread. Only the iterations
+ * that finish count, so a stopped search returns the best move of the deepest one. The transposition
+ * table is kept from one search to the next.
+ *
+ * One search runs at a time: starting another stops the one in progress first. It always runs the alpha-beta
+ * search, so its callers parse their configs with EngineConfig::parseAlphaBeta.
+ */
+class SearchEngine {
+public:
+    explicit SearchEngine(const EngineConfig &config = EngineConfig());
+
+    // Stops the search in progress and waits for it
+    ~SearchEngine();
+
+    future<SearchInfo> start(const Position &position, const SearchLimits &limits,
+                             const ProgressCallback &progress = ProgressCallback());
+
+    /**
+     * Asks the search in progress to return as soon as it can. With none in progress it does nothing, so a
+     * stop that comes late never cuts the next search short; to cancel a search before it has started, pass
+     * a flag in SearchLimits::cancel.
+     */
+    void stop();
+
+    /**
+     * Blocks until the search in progress, if any, has returned
+     */
+    void wait();
+
+    bool searching() const;
+
+    /**
+     * Forgets everything the earlier searches left in the table
+     */
+    void clearTable();
+
+private:
+    EngineConfig config;
+    TranspositionTable table;
+    // Each search has its own stop flag. stopMutex guards the flag of the search in progress, NULL from
+    // before its result is set, so a stop() either reaches a search that has not answered yet or none.
+    mutex stopMutex;
+    shared_ptr<atomic<bool> > searchStop;
+    atomic<bool> running;
+    // Serialises start, wait and the destructor, the search thread does not take it
+    mutex threadMutex;
+    thread worker;
+
+    void run(Position position, SearchLimits limits, ProgressCallback progress, promise<SearchInfo> result,
+             shared_ptr<atomic<bool> > stopFlag);
+};
+
+#endif // SEARCHENGINE_H
@@ -0,0 +1,147 @@
+#ifndef SEARCHTASK_H
+#define SEARCHTASK_H
+
+#include "transpositiontable.h"
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+using namespace std;
+
+/**
+ * A search written as a coroutine that returns a T. It starts suspended and runs when it is awaited, by
+ * another SearchTask or through its handle; once it returns it resumes whoever awaited it. A chain of
+ * nested tasks therefore suspends as a whole, and resuming its innermost task continues all of it.
+ */
+template<typename T>
+class SearchTask {
+public:
+    class promise_type;
+    typedef coroutine_handle<promise_type> Handle;
+
+    class promise_type {
+    public:
+        T value;
+        // Resumed on return, none for the outermost task
+        coroutine_handle<> continuation;
+
+        SearchTask get_return_object() {
+            return SearchTask(Handle::from_promise(*this));
+        }
+
+        suspend_always initial_suspend() noexcept {
+            return suspend_always();
+        }
+
+        auto final_suspend() noexcept {
+            struct Finished {
+                bool await_ready() noexcept {
+                    return false;
+                }
+
+                coroutine_handle<> await_suspend(Handle handle) noexcept {
+                    coroutine_handle<> next = handle.promise().continuation;
+                    return next ? next : noop_coroutine();
+                }
+
+                void await_resume() noexcept {
+                }
+            };
+            return Finished();
+        }
+
+        void return_value(T result) {
+            value = move(result);
+        }
+
+        // The search code does not throw
+        void unhandled_exception() {
+            terminate();
+        }
+    };
+
+    SearchTask(): handle(NULL) {
+    }
+
+    SearchTask(SearchTask &&other) noexcept: handle(other.handle) {
+        other.handle = NULL;
+    }
+
+    SearchTask &operator=(SearchTask &&other) noexcept {
+        swap(handle, other.handle);
+        return *this;
+    }
+
+    SearchTask(const SearchTask &) = delete;
+    SearchTask &operator=(const SearchTask &) = delete;
+
+    ~SearchTask() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool done() const {
+        return handle && handle.done();
+    }
+
+    coroutine_handle<> start() const {
+        return handle;
+    }
+
+    // Only once done()
+    T &result() {
+        return handle.promise().value;
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    // Runs the task straight away, in place of the one awaiting it
+    coroutine_handle<> await_suspend(coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume() {
+        return move(handle.promise().value);
+    }
+
+private:
+    Handle handle;
+
+    explicit SearchTask(Handle handle): handle(handle) {
+    }
+};
+
+/**
+ * co_await before probing the table: starts loading the slot of key and suspends the whole search, leaving
+ * the coroutine to resume in resumePoint. Whoever resumes the search runs others meanwhile.
+ */
+class TablePrefetch {
+public:
+    TablePrefetch(const TranspositionTable &table, ullint key, coroutine_handle<> &resumePoint):
+            table(table), key(key), resumePoint(resumePoint) {
+    }
+
+    bool await_ready() const noexcept {
+        table.prefetch(key);
+        return false;
+    }
+
+    void await_suspend(coroutine_handle<> handle) noexcept {
+        resumePoint = handle;
+    }
+
+    void await_resume() const noexcept {
+    }
+
+private:
+    const TranspositionTable &table;
+    ullint key;
+    coroutine_handle<> &resumePoint;
+};
+
+#endif // SEARCHTASK_H
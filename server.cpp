@@ -1,7 +1,12 @@
 #include "server.h"
+#include "gamearchive.h"
+#include "latencyreport.h"
 #include "reversicompetitionagent.h"
+#include "sprt.h"
+#include "tournament.h"
 
 #include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
 
@@ -44,7 +49,7 @@ void Server::generateInput(int task, double cpuTime, char player) {
 
     outputFile << task << endl;
     outputFile << player << endl;
-    outputFile << task << cpuTime << endl;
+    outputFile << cpuTime << endl;
 
     for (int i = 0; i < BOARD_SIZE; i++) {
         for (int j = 0; j < BOARD_SIZE; j++) {
@@ -57,12 +62,31 @@ void Server::generateInput(int task, double cpuTime, char player) {
     outputFile.close();
 }
 
+int Server::emptySquares() {
+    int empties = 0;
+    for (int i = 0; i < BOARD_SIZE; i++) {
+        for (int j = 0; j < BOARD_SIZE; j++) {
+            empties += boardState[i][j] == '*';
+        }
+    }
+    return empties;
+}
+
 void Server::makePlay() {
     char player1Symbol = 'X';
     char player2Symbol = 'O';
     double player1Time = 200.0;
     double player2Time = 200.0;
 
+    // Move times join those of earlier games in the latency report, under the settings of each side
+    LatencyReport latency;
+    bool reportLatency = latency.load(DEFAULT_LATENCY_REPORT);
+    EngineConfig player1Config, player2Config;
+    player1Config.name = string(1, player1Symbol);
+    player1Config.cpuTime = player1Time;
+    player2Config.name = string(1, player2Symbol);
+    player2Config.cpuTime = player2Time;
+
     int noOfPlayer1Moves = 0;
     int noOfPlayer2Moves = 0;
 
@@ -71,13 +95,15 @@ void Server::makePlay() {
 
     while(!bothPlayersPassed) {
         // Pass parameters to player 1 and get move
-        chrono::time_point<chrono::system_clock> player1Start, player1End;
+        chrono::time_point<chrono::steady_clock> player1Start, player1End;
         vector<vector<char> > player1Board = cloneBoard();
         ReversiCompetitionAgent player1Agent(player1Board, player1Symbol, player2Symbol, player1Time);
 
-        player1Start = chrono::system_clock::now();
+        int player1Empties = emptySquares();
+        double player1Budget = EngineConfig::moveTime(player1Time, player1Empties);
+        player1Start = chrono::steady_clock::now();
         player1Agent.play();
-        player1End = chrono::system_clock::now();
+        player1End = chrono::steady_clock::now();
         chrono::duration<double> player1Duration = player1End - player1Start;
         double player1Seconds = player1Duration.count();
         player1Time -= player1Seconds;
@@ -89,17 +115,20 @@ void Server::makePlay() {
 
         if (!player1Move.passMove()) {
             noOfPlayer1Moves += 1;
+            latency.record(player1Config.toString(), player1Empties, player1Seconds, player1Budget);
         }
         ReversiCommon::makeMove(player1Move, boardState, player1Symbol);
 
         // Pass parameters to player 2 and get move
-        chrono::time_point<chrono::system_clock> player2Start, player2End;
+        chrono::time_point<chrono::steady_clock> player2Start, player2End;
         vector<vector<char> > player2Board = cloneBoard();
         ReversiCompetitionAgent player2Agent(player2Board, player2Symbol, player1Symbol, player2Time);
 
-        player2Start = chrono::system_clock::now();
+        int player2Empties = emptySquares();
+        double player2Budget = EngineConfig::moveTime(player2Time, player2Empties);
+        player2Start = chrono::steady_clock::now();
         player2Agent.play();
-        player2End = chrono::system_clock::now();
+        player2End = chrono::steady_clock::now();
         chrono::duration<double> player2Duration = player2End - player2Start;
         double player2Seconds = player2Duration.count();
         player2Time -= player2Seconds;
@@ -110,6 +139,7 @@ void Server::makePlay() {
 
         if (!player2Move.passMove()) {
             noOfPlayer2Moves += 1;
+            latency.record(player2Config.toString(), player2Empties, player2Seconds, player2Budget);
         }
         ReversiCommon::makeMove(player2Move, boardState, player2Symbol);
 
@@ -129,6 +159,9 @@ void Server::makePlay() {
     cout << "Discs\t" << noOfDiscs[player1Symbol] << '\t' << noOfDiscs[player2Symbol] << endl;
 
     saveLog();
+    if (reportLatency && latency.save(DEFAULT_LATENCY_REPORT)) {
+        cout << "Move times added to " << DEFAULT_LATENCY_REPORT << endl;
+    }
 }
 
 ReversiCommon::Move Server::readMove() {
@@ -140,98 +173,181 @@ ReversiCommon::Move Server::readMove() {
     return move;
 }
 
+void Server::ReplayGame::load(const ArchivedGame &archivedGame, const string &gameTitle) {
+    game = archivedGame;
+    title = gameTitle;
+    positions.resize(game.moves.size() + 1);
+    positions[0] = game.start;
+    int player = game.startPlayer;
+    for (size_t i = 0; i < game.moves.size(); i++) {
+        positions[i + 1] = positions[i];
+        positions[i + 1].makeMove(player, game.moves[i]);
+        player = 1 - player;
+    }
+}
+
+int Server::ReplayGame::plies() const {
+    return game.moves.size();
+}
+
+int Server::ReplayGame::playerOfPly(int ply) const {
+    return (ply - 1) % 2 == 0 ? game.startPlayer : 1 - game.startPlayer;
+}
+
+ArchivedGame Server::currentGame() {
+    ArchivedGame game;
+    game.startPlayer = gameLog.empty() || gameLog[0].player == 'X' ? ReversiBoard::BLACK : ReversiBoard::WHITE;
+    for (int i = 0; i < gameLog.size(); i++) {
+        ReversiCommon::Move move = gameLog[i].move;
+        game.moves.push_back(move.passMove() ? SQUARE_PASS : makeSquare(move.x, move.y));
+        game.times.push_back(gameLog[i].time);
+    }
+    game.computeDiscs();
+    return game;
+}
+
 void Server::replay() {
     WINDOW *win = initscr();
     noecho();
-    refresh();
-    char ch = '0';
-    int currentIndex = -1;
-    int gameSize = gameLog.size();
-    initBoard();
-    ReversiCommon::Move emptyMove(-2, -2, true);
-    PlayerMoveTime emptyMoveTime('*', emptyMove, 0.0);
+    keypad(stdscr, TRUE);
+    ReplayGame game;
+    game.load(currentGame(), "Game just played");
+    replayGame(game, win, false);
+    endwin();
+}
+
+bool Server::replayArchive(const string &path, long long game) {
+    GameArchiveReader reader;
+    if (!reader.open(path)) {
+        return false;
+    }
+    if (reader.size() == 0) {
+        cout << "No games in archive: " << path << endl;
+        return false;
+    }
+    if (game < 0) {
+        game += reader.size();
+    }
+    game = min(max(game, 0LL), reader.size() - 1);
 
+    WINDOW *win = initscr();
+    noecho();
+    keypad(stdscr, TRUE);
+    int ch = 0;
     while (ch != 'q') {
-        if (currentIndex == -1) {
-            showBoardCurses(emptyMoveTime, win, true);
-        } else {
-            PlayerMoveTime currentMoveTime = gameLog[currentIndex];
-            showBoardCurses(currentMoveTime, win);
-        }
-        ch = getch();
-        if (ch == 'f') {
-            currentIndex = min(currentIndex + 1, gameSize - 1);
-        } else if (ch == 'b') {
-            currentIndex = max(-1, currentIndex - 1);
+        ArchivedGame archivedGame;
+        ReplayGame replay;
+        string title = "Game " + to_string(game + 1) + " of " + to_string(reader.size());
+        if (!reader.read(game, archivedGame)) {
+            title += " (corrupt)";
         }
-        initBoard();
-        for (int i = 0; i <= currentIndex; i++) {
-            PlayerMoveTime playerMoveTime = gameLog[i];
-            ReversiCommon::makeMove(playerMoveTime.move, boardState, playerMoveTime.player);
+        replay.load(archivedGame, title);
+        ch = replayGame(replay, win, true);
+        if (ch == 'n') {
+            game = min(game + 1, reader.size() - 1);
+        } else if (ch == 'p') {
+            game = max(0LL, game - 1);
         }
     }
     endwin();
+    return true;
 }
 
-void Server::saveLog() {
-    ofstream outputFile("gamelog.txt");
-
-    for (int i = 0; i < gameLog.size(); i++) {
-        PlayerMoveTime playerMoveTime = gameLog[i];
-        char player = playerMoveTime.player;
-        ReversiCommon::Move move = playerMoveTime.move;
-        double time = playerMoveTime.time;
-
-        outputFile << player << ' ' << ReversiCommon::formatMove(move) << ' ' << time << endl;
+int Server::replayGame(ReplayGame &replayGame, WINDOW *win, bool browsing) {
+    int ply = 0;
+    while (true) {
+        showBoardCurses(replayGame, ply, win);
+        int ch = getch();
+        if (ch == 'f' || ch == KEY_RIGHT) {
+            ply = min(ply + 1, replayGame.plies());
+        } else if (ch == 'b' || ch == KEY_LEFT) {
+            ply = max(0, ply - 1);
+        } else if (ch == 's' || ch == KEY_HOME) {
+            ply = 0;
+        } else if (ch == 'e' || ch == KEY_END) {
+            ply = replayGame.plies();
+        } else if (ch == 'q' || (browsing && (ch == 'n' || ch == 'p'))) {
+            return ch;
+        }
     }
-    outputFile << endl;
+}
 
-    outputFile.close();
+void Server::saveLog() {
+    ArchivedGame game = currentGame();
+    GameArchiveWriter writer;
+    if (!writer.open(GAME_ARCHIVE) || !writer.append(game) || !writer.close()) {
+        cout << "Failed to save the game to: " << GAME_ARCHIVE << endl;
+        return;
+    }
+    cout << "Saved as game " << writer.size() - 1 << " of " << GAME_ARCHIVE << endl;
 }
 
 
-void Server::showBoardCurses(PlayerMoveTime &playerMoveTime, WINDOW *win, bool initState) {
-    refresh();
-    vector<ReversiCommon::Move> possibleMoves;
-    if (!initState) {
-        char opponentSymbol = playerMoveTime.player == 'X' ? 'O' : 'X';
-        possibleMoves = ReversiCommon::validMoves(boardState, opponentSymbol);
-        for (int i = 0; i < possibleMoves.size(); i++) {
-            ReversiCommon::Move move = possibleMoves[i];
-            boardState[move.x][move.y] = 'o';
-        }
-    }
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            char piece = boardState[i][j];
-            if (piece == '*') {
-                mvwaddch(win, i * 2, j * 2, piece | A_DIM);
-            } else if (boardState[i][j] == 'o') {
-                mvwaddch(win, i * 2, j * 2, piece | A_STANDOUT);
-            } else if (!initState && (i == playerMoveTime.move.x && j == playerMoveTime.move.y)) {
-                mvwaddch(win, i * 2, j * 2, piece | A_UNDERLINE);
-            } else {
-                mvwaddch(win, i * 2, j * 2, piece | A_BOLD);
-            }
+void Server::showBoardCurses(const ReplayGame &replayGame, int ply, WINDOW *win) {
+    ReversiBoard board = replayGame.positions[ply];
+    int nextPlayer = ply == 0 ? replayGame.game.startPlayer : 1 - replayGame.playerOfPly(ply);
+    ullint possibleMoves = board.legalMoves(nextPlayer);
+    Square lastMove = ply == 0 ? SQUARE_NONE : replayGame.game.moves[ply - 1];
+
+    for (Square square = 0; square < NO_OF_SQUARES; square++) {
+        ullint bit = squareBit(square);
+        int y = squareRow(square) * 2, x = squareColumn(square) * 2;
+        if (board.pieces[ReversiBoard::BLACK] & bit || board.pieces[ReversiBoard::WHITE] & bit) {
+            char piece = board.pieces[ReversiBoard::BLACK] & bit ? 'X' : 'O';
+            mvwaddch(win, y, x, piece | (square == lastMove ? A_UNDERLINE : A_BOLD));
+        } else if (possibleMoves & bit) {
+            mvwaddch(win, y, x, 'o' | A_STANDOUT);
+        } else {
+            mvwaddch(win, y, x, '*' | A_DIM);
         }
     }
 
-    if (!initState) {
-        char player = playerMoveTime.player;
-        string playerString = player == 'X'? "X" : "O";
-        ReversiCommon::Move move = playerMoveTime.move;
-        double time = playerMoveTime.time;
-        string formattedString = playerString + " made move: " + ReversiCommon::formatMove(move) + " with time " + to_string(time);
-        mvwaddstr(win, BOARD_SIZE * 2 + 2, 0, formattedString.c_str());
-        for (int i = 0; i < possibleMoves.size(); i++) {
-            ReversiCommon::Move move = possibleMoves[i];
-            boardState[move.x][move.y] = '*';
+    string status = replayGame.title + ", ply " + to_string(ply) + " of " + to_string(replayGame.plies());
+    mvwaddstr(win, BOARD_SIZE * 2, 0, status.c_str());
+    wclrtoeol(win);
+    string moveString;
+    if (ply > 0) {
+        string playerString = replayGame.playerOfPly(ply) == ReversiBoard::BLACK ? "X" : "O";
+        moveString = playerString + " made move: " + squareToString(lastMove);
+        if (ply <= replayGame.game.times.size()) {
+            moveString += " with time " + to_string(replayGame.game.times[ply - 1]);
         }
     }
+    mvwaddstr(win, BOARD_SIZE * 2 + 2, 0, moveString.c_str());
+    wclrtoeol(win);
+    mvwaddstr(win, BOARD_SIZE * 2 + 4, 0, "f/b: step  s/e: start/end  n/p: next/previous game  q: quit");
+    wclrtoeol(win);
     refresh();
 }
 
 int main(int argc, char *argv[]) {
+    if (argc > 1 && string(argv[1]) == "tournament") {
+        // Headless self-play: server tournament games=1000 threads=8 a=depth=4 b=depth=5
+        return runTournament(argc - 2, argv + 2);
+    }
+    if (argc > 1 && string(argv[1]) == "sprt") {
+        // Stops once decided: server sprt elo0=0 elo1=10 a=depth=5 b=depth=4 state=sprt.state
+        return runSprt(argc - 2, argv + 2);
+    }
+    if (argc > 1 && string(argv[1]) == "latency") {
+        // Move time percentiles kept by the server and matches: server latency [latency.state]
+        LatencyReport latency;
+        string path = argc > 2 ? argv[2] : DEFAULT_LATENCY_REPORT;
+        if (!latency.load(path)) {
+            return 1;
+        }
+        if (latency.empty()) {
+            cout << "No moves in latency report: " << path << endl;
+            return 1;
+        }
+        cout << latency.summary();
+        return 0;
+    }
+    if (argc > 2 && string(argv[1]) == "replay") {
+        // Browse archived games: server replay games.rga [game]
+        Server server;
+        return server.replayArchive(argv[2], argc > 3 ? atoll(argv[3]) : 0) ? 0 : 1;
+    }
     Server server;
     server.makePlay();
     return 0;
@@ -1,6 +1,7 @@
 #ifndef SERVER_H
 #define SERVER_H
 
+#include "gamearchive.h"
 #include "reversicommon.h"
 
 #include <ncurses.h>
@@ -19,12 +20,20 @@ char INIT_BOARD_STATE[BOARD_SIZE][BOARD_SIZE] = {
     {'*', '*', '*', '*', '*', '*', '*', '*'}
 };
 
+// Every game played through the server is appended here, see archivetool for reading it
+static const char GAME_ARCHIVE[] = "games.rga";
+
 class Server
 {
 public:
     Server();
     void makePlay();
 
+    /**
+     * Browse the games of an archive, starting at the given game (negative counts from the end)
+     */
+    bool replayArchive(const string &path, long long game);
+
 private:
     struct PlayerMoveTime {
         char player;
@@ -35,6 +44,24 @@ private:
         }
     };
 
+    /**
+     * A game prepared for replay with the position after every ply, 16 bytes each,
+     * so any ply can be shown without replaying the moves before it
+     */
+    struct ReplayGame {
+        ArchivedGame game;
+        // positions[i] is the board after i plies
+        vector<ReversiBoard> positions;
+        string title;
+
+        void load(const ArchivedGame &archivedGame, const string &gameTitle);
+
+        int plies() const;
+
+        // Player who made the given ply, counting from 1
+        int playerOfPly(int ply) const;
+    };
+
     int task;
 
     vector<vector<char> > boardState;
@@ -43,6 +70,8 @@ private:
 
     vector<vector<char> > cloneBoard();
 
+    int emptySquares();
+
     /**
      * Generate input for the next player as input.txt
      */
@@ -53,26 +82,37 @@ private:
      */
     ReversiCommon::Move readMove();
 
+    /**
+     * The game played so far in archive form
+     */
+    ArchivedGame currentGame();
+
     /**
      * Replay the whole game after it has ended
      */
     void replay();
 
+    /**
+     * Step through the plies of a game, returns the key that ended the replay:
+     * 'q' to quit, 'n' and 'p' to move to the next and previous game
+     */
+    int replayGame(ReplayGame &replayGame, WINDOW *win, bool browsing);
+
     /**
      * Initialize the game state to the default start state
      */
     void initBoard();
 
     /**
-     * Save the game log for scientific purposes
+     * Append the game to the archive for scientific purposes
      */
     void saveLog();
 
     /**
-     * Display the current state with the move and time taken for the move
-     * for the current player
+     * Display the position after the given ply with the last move, its time and the moves
+     * available to the player whose turn it is
      */
-    void showBoardCurses(Server::PlayerMoveTime& playerMoveTime, WINDOW* win, bool initState=false);
+    void showBoardCurses(const ReplayGame &replayGame, int ply, WINDOW *win);
 };
 
 #endif // SERVER_H
@@ -0,0 +1,557 @@
+#ifndef SIZEDBOARD_H
+#define SIZEDBOARD_H
+
+#include "boardgeometry.h"
+
+#include <algorithm>
+#include <climits>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Bitboard for the variant sizes, N x N with the same layout and move generation as ReversiBoard.
+ * The shift distances and masks are compile time constants, so SizedBoard<6> works on 36 bit masks
+ * in a 64 bit word and SizedBoard<10> on 100 bit masks in a 128 bit word. The 8x8 games keep using
+ * the hand written ReversiBoard.
+ */
+template <int N>
+class SizedBoard {
+public:
+    typedef BoardGeometry<N> Geometry;
+    typedef typename Geometry::Bits Bits;
+
+    static const int BLACK = 0;
+    static const int WHITE = 1;
+    // Moves that are not squares on the board
+    static const int PASS = Geometry::SQUARES;
+    static const int NONE = Geometry::SQUARES + 1;
+
+    Bits pieces[2];
+
+    SizedBoard() {
+        pieces[BLACK] = Geometry::INITIAL_BLACK;
+        pieces[WHITE] = Geometry::INITIAL_WHITE;
+    }
+
+    SizedBoard(Bits black, Bits white) {
+        pieces[BLACK] = black;
+        pieces[WHITE] = white;
+    }
+
+    /**
+     * Parses N * N board characters (X for black, O for white, * or - for empty), whitespace ignored
+     */
+    static bool parse(const string &text, SizedBoard &board) {
+        board.pieces[BLACK] = board.pieces[WHITE] = 0;
+        int square = 0;
+        for (char ch: text) {
+            if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r') {
+                continue;
+            }
+            if (square == Geometry::SQUARES) {
+                return false;
+            }
+            if (ch == 'X') {
+                board.pieces[BLACK] |= Geometry::bit(square);
+            } else if (ch == 'O') {
+                board.pieces[WHITE] |= Geometry::bit(square);
+            } else if (ch != '*' && ch != '-') {
+                return false;
+            }
+            square++;
+        }
+        return square == Geometry::SQUARES;
+    }
+
+    Bits empty() const {
+        return ~(pieces[BLACK] | pieces[WHITE]) & Geometry::ALL;
+    }
+
+    int numberOfPieces(int player) const {
+        return Geometry::popCount(pieces[player]);
+    }
+
+    int numberOfEmpties() const {
+        return Geometry::popCount(empty());
+    }
+
+    static Bits generateMoves(Bits own, Bits opponent) {
+        Bits empty = ~(own | opponent) & Geometry::ALL;
+        return movesInDirection<shiftUp>(own, opponent, empty)
+            | movesInDirection<shiftDown>(own, opponent, empty)
+            | movesInDirection<shiftLeft>(own, opponent, empty)
+            | movesInDirection<shiftRight>(own, opponent, empty)
+            | movesInDirection<shiftUpLeft>(own, opponent, empty)
+            | movesInDirection<shiftUpRight>(own, opponent, empty)
+            | movesInDirection<shiftDownLeft>(own, opponent, empty)
+            | movesInDirection<shiftDownRight>(own, opponent, empty);
+    }
+
+    Bits legalMoves(int player) const {
+        return generateMoves(pieces[player], pieces[1 - player]);
+    }
+
+    /**
+     * Discs the player would flip by moving to the empty square, none if the move is illegal
+     */
+    Bits flips(int player, int square) const {
+        Bits move = Geometry::bit(square);
+        Bits own = pieces[player], opponent = pieces[1 - player];
+        return flipsInDirection<shiftUp>(move, own, opponent)
+            | flipsInDirection<shiftDown>(move, own, opponent)
+            | flipsInDirection<shiftLeft>(move, own, opponent)
+            | flipsInDirection<shiftRight>(move, own, opponent)
+            | flipsInDirection<shiftUpLeft>(move, own, opponent)
+            | flipsInDirection<shiftUpRight>(move, own, opponent)
+            | flipsInDirection<shiftDownLeft>(move, own, opponent)
+            | flipsInDirection<shiftDownRight>(move, own, opponent);
+    }
+
+    /**
+     * Plays a legal move and returns the flipped discs, which undoMove takes back
+     */
+    Bits makeMove(int player, int square) {
+        Bits move = Geometry::bit(square);
+        Bits flipped = flips(player, square);
+        pieces[player] |= flipped | move;
+        pieces[1 - player] &= ~flipped;
+        return flipped;
+    }
+
+    void undoMove(int player, int square, Bits flipped) {
+        pieces[player] &= ~(flipped | Geometry::bit(square));
+        pieces[1 - player] |= flipped;
+    }
+
+    static string squareName(int square) {
+        if (square == PASS) {
+            return "pass";
+        } else if (square < 0 || square >= Geometry::SQUARES) {
+            return "none";
+        }
+        return string(1, (char) ('a' + square % N)) + to_string(square / N + 1);
+    }
+
+    string toString() const {
+        string text;
+        for (int square = 0; square < Geometry::SQUARES; square++) {
+            Bits bit = Geometry::bit(square);
+            text += pieces[BLACK] & bit ? 'X' : pieces[WHITE] & bit ? 'O' : '*';
+            if (square % N == N - 1) {
+                text += '\n';
+            }
+        }
+        return text;
+    }
+
+private:
+    typedef Bits (*Shift)(Bits);
+
+    // Towards lower square indices, the higher bits, as on the 8x8 board
+    static Bits shiftUp(Bits bits) {
+        return (bits << N) & Geometry::ALL;
+    }
+
+    static Bits shiftDown(Bits bits) {
+        return bits >> N;
+    }
+
+    static Bits shiftLeft(Bits bits) {
+        return (bits << 1) & ~Geometry::RIGHT_COLUMN & Geometry::ALL;
+    }
+
+    static Bits shiftRight(Bits bits) {
+        return (bits >> 1) & ~Geometry::LEFT_COLUMN;
+    }
+
+    static Bits shiftUpLeft(Bits bits) {
+        return (bits << (N + 1)) & ~Geometry::RIGHT_COLUMN & Geometry::ALL;
+    }
+
+    static Bits shiftUpRight(Bits bits) {
+        return (bits << (N - 1)) & ~Geometry::LEFT_COLUMN & Geometry::ALL;
+    }
+
+    static Bits shiftDownLeft(Bits bits) {
+        return (bits >> (N - 1)) & ~Geometry::RIGHT_COLUMN;
+    }
+
+    static Bits shiftDownRight(Bits bits) {
+        return (bits >> (N + 1)) & ~Geometry::LEFT_COLUMN;
+    }
+
+    /**
+     * Opponent runs are at most N - 2 discs long, the loop has a constant trip count and unrolls
+     */
+    template <Shift Step>
+    static Bits opponentRun(Bits start, Bits opponent) {
+        Bits run = Step(start) & opponent;
+        for (int i = 1; i < N - 2; i++) {
+            run |= Step(run) & opponent;
+        }
+        return run;
+    }
+
+    template <Shift Step>
+    static Bits movesInDirection(Bits own, Bits opponent, Bits empty) {
+        return Step(opponentRun<Step>(own, opponent)) & empty;
+    }
+
+    template <Shift Step>
+    static Bits flipsInDirection(Bits move, Bits own, Bits opponent) {
+        Bits run = opponentRun<Step>(move, opponent);
+        return Step(run) & own ? run : 0;
+    }
+};
+
+/**
+ * Exact solver for the variant boards, alpha-beta on the final disc difference like EndgameSolver.
+ * Far enough from the end to need it, it orders moves by a shallow search, keeps the bounds it proved
+ * in a transposition table and narrows in on the value with null window searches. That solves 6x6
+ * from the start position in minutes and from 24 empties in seconds.
+ */
+template <int N>
+class SizedEndgameSolver {
+public:
+    typedef SizedBoard<N> Board;
+    typedef typename Board::Bits Bits;
+    typedef typename Board::Geometry Geometry;
+
+    SizedEndgameSolver(size_t tableEntries = 1 << 20): table(max((size_t) 2, tableEntries)), nodeCount(0) {
+    }
+
+    /**
+     * Final disc difference, player minus opponent, when both sides play perfectly from here
+     */
+    int solve(const Board &position, int player) {
+        board = position;
+        // Null window tests converge on the value, the table carries the bounds from one test to the next
+        int lower = -Geometry::SQUARES, upper = Geometry::SQUARES;
+        int value = 0;
+        while (lower < upper) {
+            int beta = lower + (upper - lower + 1) / 2;
+            value = negamax(player, beta - 1, beta, false);
+            if (value < beta) {
+                upper = value;
+            } else {
+                lower = value;
+            }
+        }
+        return value;
+    }
+
+    /**
+     * Best move for the player along with its exact value, Board::PASS if the player has to pass
+     */
+    int bestMove(const Board &position, int player, int &value) {
+        value = solve(position, player);
+        Bits moves = board.legalMoves(player);
+        if (!moves) {
+            return Board::PASS;
+        }
+        // With the value known a single null window test picks out a move that keeps it, usually the first one
+        int squares[Geometry::SQUARES];
+        int count = orderMoves(player, moves, tableMove(player), squares);
+        for (int i = 0; i < count - 1; i++) {
+            Bits flipped = board.makeMove(player, squares[i]);
+            int score = -negamax(1 - player, -value, -value + 1, false);
+            board.undoMove(player, squares[i], flipped);
+            if (score >= value) {
+                return squares[i];
+            }
+        }
+        return squares[count - 1];
+    }
+
+    long long nodes() const {
+        return nodeCount;
+    }
+
+    void clear() {
+        fill(table.begin(), table.end(), Entry());
+    }
+
+private:
+    // Below this many empties move ordering and the table cost more than the cutoffs they buy
+    static const int ORDERING_EMPTIES = 7;
+    // From here on moves are ordered by a two ply search, from DEEPER_EMPTIES by a three ply one
+    static const int SHALLOW_EMPTIES = 14;
+    static const int DEEPER_EMPTIES = 20;
+    // Positions this close to the start share table entries with their mirror images
+    static const int SYMMETRY_PLIES = 10;
+
+    /**
+     * Bounds on the exact value of a position, which hold whatever the search window was
+     */
+    struct Entry {
+        Bits own;
+        Bits opponent;
+        int8_t lower;
+        int8_t upper;
+        uint8_t best;
+        uint8_t empties;
+
+        Entry(): own(0), opponent(0), lower(-Geometry::SQUARES), upper(Geometry::SQUARES), best(Board::NONE),
+                empties(0) {
+        }
+
+        bool matches(Bits player, Bits other) const {
+            return own == player && opponent == other;
+        }
+    };
+
+    Board board;
+    vector<Entry> table;
+    long long nodeCount;
+
+    static uint64_t mix(uint64_t value) {
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+        return value ^ (value >> 31);
+    }
+
+    /**
+     * First of the two entries the position may be stored in. The first keeps whichever position had more
+     * empties, the solves near the root that are expensive to redo, the second always takes the newest.
+     */
+    size_t bucket(Bits own, Bits opponent) const {
+        uint64_t hash = mix((uint64_t) own ^ mix((uint64_t) opponent));
+        if constexpr (sizeof(Bits) > 8) {
+            hash = mix(hash ^ (uint64_t) (own >> 64) ^ mix((uint64_t) (opponent >> 64) + 1));
+        }
+        return hash % (table.size() / 2) * 2;
+    }
+
+    /**
+     * Position as it is stored in the table. Near the root it is the least of the 8 symmetric forms, so the
+     * mirrored openings, which are only ever searched there, share their entries.
+     */
+    struct Key {
+        Bits own;
+        Bits opponent;
+        int transform;
+    };
+
+    Key key(int player, int empties) const {
+        Key key = {board.pieces[player], board.pieces[1 - player], 0};
+        if (Geometry::SQUARES - 4 - empties > SYMMETRY_PLIES) {
+            return key;
+        }
+        for (int transform = 1; transform < 8; transform++) {
+            Bits own = Geometry::transform(board.pieces[player], transform);
+            Bits opponent = Geometry::transform(board.pieces[1 - player], transform);
+            if (own < key.own || (own == key.own && opponent < key.opponent)) {
+                key = {own, opponent, transform};
+            }
+        }
+        return key;
+    }
+
+    Entry *find(const Key &key) {
+        size_t first = bucket(key.own, key.opponent);
+        for (size_t i = first; i < first + 2; i++) {
+            if (table[i].matches(key.own, key.opponent)) {
+                return &table[i];
+            }
+        }
+        return NULL;
+    }
+
+    Entry &replace(const Key &key, int empties) {
+        size_t first = bucket(key.own, key.opponent);
+        Entry *entry = &table[first + 1];
+        if (table[first].empties <= empties) {
+            table[first + 1] = table[first];
+            entry = &table[first];
+        }
+        *entry = Entry();
+        entry->own = key.own;
+        entry->opponent = key.opponent;
+        entry->empties = (uint8_t) empties;
+        return *entry;
+    }
+
+    /**
+     * Best move of the entry on the actual board
+     */
+    static int entryMove(const Entry &entry, const Key &key) {
+        if (entry.best >= Geometry::SQUARES) {
+            return entry.best;
+        }
+        return Geometry::transformSquare(entry.best, Geometry::inverseTransform(key.transform));
+    }
+
+    int tableMove(int player) {
+        Key position = key(player, board.numberOfEmpties());
+        Entry *entry = find(position);
+        return entry ? entryMove(*entry, position) : Board::NONE;
+    }
+
+    /**
+     * Mobility and corners, enough to tell the promising moves from the rest in the shallow searches
+     */
+    int evaluate(int player) const {
+        Bits own = board.legalMoves(player), opponent = board.legalMoves(1 - player);
+        return (Geometry::popCount(own) + Geometry::popCount(own & Geometry::CORNERS)) * 4
+            - (Geometry::popCount(opponent) + Geometry::popCount(opponent & Geometry::CORNERS)) * 4
+            + (Geometry::popCount(board.pieces[player] & Geometry::CORNERS)
+               - Geometry::popCount(board.pieces[1 - player] & Geometry::CORNERS)) * 8;
+    }
+
+    int shallowSearch(int player, int depth, int alpha, int beta) {
+        Bits moves = board.legalMoves(player);
+        if (depth == 0 || !moves) {
+            return evaluate(player);
+        }
+        int best = INT_MIN + 1;
+        while (moves) {
+            int square = Geometry::firstSquare(moves);
+            moves ^= Geometry::bit(square);
+            Bits flipped = board.makeMove(player, square);
+            int score = -shallowSearch(1 - player, depth - 1, -beta, -max(alpha, best));
+            board.undoMove(player, square, flipped);
+            if (score > best) {
+                best = score;
+                if (best >= beta) {
+                    break;
+                }
+            }
+        }
+        return best;
+    }
+
+    int orderMoves(int player, Bits moves, int hashMove, int squares[]) {
+        int count = 0;
+        while (moves) {
+            int square = Geometry::firstSquare(moves);
+            moves ^= Geometry::bit(square);
+            squares[count++] = square;
+        }
+        int empties = board.numberOfEmpties();
+        if (empties < ORDERING_EMPTIES) {
+            return count;
+        }
+        // Far from the end a shallow search orders the moves, closer in fastest first with corners ahead of
+        // equally mobile moves. The move that was best last time goes before all of them.
+        int weight[Geometry::SQUARES];
+        for (int i = 0; i < count; i++) {
+            Bits flipped = board.makeMove(player, squares[i]);
+            if (empties >= SHALLOW_EMPTIES) {
+                weight[squares[i]] = shallowSearch(1 - player, empties >= DEEPER_EMPTIES ? 3 : 2, INT_MIN + 1, INT_MAX);
+            } else {
+                Bits replies = board.legalMoves(1 - player);
+                weight[squares[i]] = (Geometry::popCount(replies) + Geometry::popCount(replies & Geometry::CORNERS)) * 4
+                                     - (Geometry::bit(squares[i]) & Geometry::CORNERS ? 2 : 0);
+            }
+            board.undoMove(player, squares[i], flipped);
+        }
+        if (hashMove < Geometry::SQUARES) {
+            weight[hashMove] = INT_MIN;
+        }
+        stable_sort(squares, squares + count, [&weight](int a, int b) {
+            return weight[a] < weight[b];
+        });
+        return count;
+    }
+
+    /**
+     * Final score with a single empty square left, which whoever can takes
+     */
+    int lastMove(int player) {
+        int square = Geometry::firstSquare(board.empty());
+        int own = board.numberOfPieces(player), opponent = board.numberOfPieces(1 - player);
+        int flipped = Geometry::popCount(board.flips(player, square));
+        if (flipped) {
+            return own - opponent + 2 * flipped + 1;
+        }
+        flipped = Geometry::popCount(board.flips(1 - player, square));
+        if (flipped) {
+            return own - opponent - 2 * flipped - 1;
+        }
+        return own - opponent;
+    }
+
+    int negamax(int player, int alpha, int beta, bool passed) {
+        nodeCount++;
+        int empties = board.numberOfEmpties();
+        if (empties <= 1) {
+            return empties ? lastMove(player) : board.numberOfPieces(player) - board.numberOfPieces(1 - player);
+        }
+        Bits moves = board.legalMoves(player);
+        if (!moves) {
+            if (passed) {
+                return board.numberOfPieces(player) - board.numberOfPieces(1 - player);
+            }
+            return -negamax(1 - player, -beta, -alpha, true);
+        }
+
+        bool useTable = empties >= ORDERING_EMPTIES;
+        int hashMove = Board::NONE;
+        Key position;
+        if (useTable) {
+            position = key(player, empties);
+            Entry *entry = find(position);
+            if (entry) {
+                if (entry->lower >= beta) {
+                    return entry->lower;
+                }
+                if (entry->upper <= alpha) {
+                    return entry->upper;
+                }
+                alpha = max(alpha, (int) entry->lower);
+                beta = min(beta, (int) entry->upper);
+                hashMove = entryMove(*entry, position);
+            }
+        }
+
+        int squares[Geometry::SQUARES];
+        int count = orderMoves(player, moves, hashMove, squares);
+        int originalAlpha = alpha;
+        int best = INT_MIN;
+        int bestSquare = squares[0];
+        for (int i = 0; i < count; i++) {
+            Bits flipped = board.makeMove(player, squares[i]);
+            int score;
+            if (i == 0) {
+                score = -negamax(1 - player, -beta, -alpha, false);
+            } else {
+                // Later moves only have to be shown no better than the best so far
+                score = -negamax(1 - player, -alpha - 1, -alpha, false);
+                if (alpha < score && score < beta) {
+                    score = -negamax(1 - player, -beta, -score, false);
+                }
+            }
+            board.undoMove(player, squares[i], flipped);
+            if (score > best) {
+                best = score;
+                bestSquare = squares[i];
+                if (score > alpha) {
+                    alpha = score;
+                    if (alpha >= beta) {
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (useTable) {
+            // The subtree may have pushed the entry out in the meantime
+            Entry *entry = find(position);
+            if (!entry) {
+                entry = &replace(position, empties);
+            }
+            if (best < beta) {
+                entry->upper = (int8_t) best;
+            }
+            if (best > originalAlpha) {
+                entry->lower = (int8_t) best;
+            }
+            entry->best = (uint8_t) Geometry::transformSquare(bestSquare, position.transform);
+        }
+        return best;
+    }
+};
+
+#endif // SIZEDBOARD_H
@@ -0,0 +1,251 @@
+#include "sprt.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+// Half a pair in every bucket keeps the variance, and so the LLR, sane over the first few pairs
+static const double PENTANOMIAL_PRIOR = 0.5;
+
+static double eloToScore(double elo) {
+    return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+PentanomialStatistics::PentanomialStatistics() {
+    for (int i = 0; i < 5; i++) {
+        counts[i] = 0;
+    }
+}
+
+void PentanomialStatistics::add(const GameResult &first, const GameResult &second) {
+    int halfPoints = (int) ((first.scoreForEngine(0) + second.scoreForEngine(0)) * 2.0 + 0.5);
+    counts[halfPoints]++;
+}
+
+long long PentanomialStatistics::pairs() const {
+    long long total = 0;
+    for (int i = 0; i < 5; i++) {
+        total += counts[i];
+    }
+    return total;
+}
+
+Sprt::Sprt(double elo0, double elo1, double alpha, double beta): elo0(elo0), elo1(elo1), alpha(alpha), beta(beta) {
+}
+
+double Sprt::llr(const PentanomialStatistics &statistics) const {
+    long long pairs = statistics.pairs();
+    if (pairs == 0) {
+        return 0.0;
+    }
+    double total = pairs + 5 * PENTANOMIAL_PRIOR;
+    double mean = 0.0;
+    for (int i = 0; i < 5; i++) {
+        mean += (statistics.counts[i] + PENTANOMIAL_PRIOR) / total * (i / 4.0);
+    }
+    double variance = 0.0;
+    for (int i = 0; i < 5; i++) {
+        double deviation = i / 4.0 - mean;
+        variance += (statistics.counts[i] + PENTANOMIAL_PRIOR) / total * deviation * deviation;
+    }
+    double score0 = eloToScore(elo0);
+    double score1 = eloToScore(elo1);
+    return pairs * (score1 - score0) * (2.0 * mean - score0 - score1) / (2.0 * variance);
+}
+
+double Sprt::lowerBound() const {
+    return log(beta / (1.0 - alpha));
+}
+
+double Sprt::upperBound() const {
+    return log((1.0 - beta) / alpha);
+}
+
+int Sprt::decision(double llr) const {
+    if (llr <= lowerBound()) {
+        return -1;
+    } else if (llr >= upperBound()) {
+        return 1;
+    }
+    return 0;
+}
+
+string Sprt::toString() const {
+    ostringstream ss;
+    ss << elo0 << ' ' << elo1 << ' ' << alpha << ' ' << beta;
+    return ss.str();
+}
+
+SprtMatch::SprtMatch(const EngineConfig &engineA, const EngineConfig &engineB, const vector<Position> &openings,
+                     int maxGames, int threads, const string &resultsPath, const Sprt &sprt, const string &statePath):
+        Tournament(engineA, engineB, openings, maxGames, threads, resultsPath), sprt(sprt), statePath(statePath),
+        decision(0), firstUnfinished(0) {
+}
+
+bool SprtMatch::resume() {
+    ifstream stateFile(statePath.c_str());
+    if (!stateFile.is_open()) {
+        return true;
+    }
+    string key, engineA, engineB, bounds;
+    while (stateFile >> key) {
+        if (key == "a") {
+            stateFile >> engineA;
+        } else if (key == "b") {
+            stateFile >> engineB;
+        } else if (key == "sprt") {
+            getline(stateFile, bounds);
+            bounds.erase(0, bounds.find_first_not_of(' '));
+        } else if (key == "next_pair") {
+            stateFile >> firstUnfinished;
+        } else if (key == "finished_pairs") {
+            int count = 0, pair;
+            stateFile >> count;
+            for (int i = 0; i < count && stateFile >> pair; i++) {
+                finishedPairs.insert(pair);
+            }
+        } else if (key == "pentanomial") {
+            for (int i = 0; i < 5; i++) {
+                stateFile >> pentanomial.counts[i];
+            }
+        } else if (key == "wdl") {
+            stateFile >> statistics.wins >> statistics.draws >> statistics.losses
+                      >> statistics.marginSum >> statistics.marginSquares;
+        }
+    }
+    if (engineA != engines[0].toString() || engineB != engines[1].toString() || bounds != sprt.toString()) {
+        cout << "State file " << statePath << " belongs to a different match" << endl;
+        return false;
+    }
+    nextPair = firstUnfinished;
+    playedPairs = finishedPairs;
+    appendResults = true;
+    decision = sprt.decision(sprt.llr(pentanomial));
+    cout << "Resuming at pair " << firstUnfinished << ": " << progress() << endl;
+    return true;
+}
+
+int SprtMatch::result() const {
+    return decision;
+}
+
+string SprtMatch::progress() const {
+    ostringstream ss;
+    ss.setf(ios::fixed);
+    ss.precision(2);
+    ss << "Pairs " << pentanomial.pairs() << " LLR " << sprt.llr(pentanomial)
+       << " [" << sprt.lowerBound() << ", " << sprt.upperBound() << "] " << statistics.summary();
+    return ss.str();
+}
+
+bool SprtMatch::pairFinished(int pair, const GameResult &first, const GameResult &second) {
+    pentanomial.add(first, second);
+    finishedPairs.insert(pair);
+    while (!finishedPairs.empty() && *finishedPairs.begin() == firstUnfinished) {
+        finishedPairs.erase(finishedPairs.begin());
+        firstUnfinished++;
+    }
+    if (decision == 0) {
+        decision = sprt.decision(sprt.llr(pentanomial));
+    }
+    saveState();
+    if (decision != 0 || pentanomial.pairs() % 10 == 0) {
+        string line = progress();
+        cout << line << endl;
+        resultsFile << "# " << line << endl;
+    }
+    return decision == 0;
+}
+
+void SprtMatch::saveState() {
+    // Written next to the state file and renamed over it, so an interruption never leaves half a file
+    string temporaryPath = statePath + ".tmp";
+    ofstream stateFile(temporaryPath.c_str());
+    if (!stateFile.is_open()) {
+        cout << "Failed to write state to: " << temporaryPath << endl;
+        return;
+    }
+    stateFile << "a " << engines[0].toString() << endl;
+    stateFile << "b " << engines[1].toString() << endl;
+    stateFile << "sprt " << sprt.toString() << endl;
+    // Not nextPair, which also counts the pairs still being played
+    stateFile << "next_pair " << firstUnfinished << endl;
+    stateFile << "finished_pairs " << finishedPairs.size();
+    for (int pair: finishedPairs) {
+        stateFile << ' ' << pair;
+    }
+    stateFile << endl;
+    stateFile << "pentanomial";
+    for (int i = 0; i < 5; i++) {
+        stateFile << ' ' << pentanomial.counts[i];
+    }
+    stateFile << endl;
+    stateFile << "wdl " << statistics.wins << ' ' << statistics.draws << ' ' << statistics.losses << ' '
+              << statistics.marginSum << ' ' << statistics.marginSquares << endl;
+    stateFile.close();
+    rename(temporaryPath.c_str(), statePath.c_str());
+}
+
+int runSprt(int argc, char *argv[]) {
+    MatchOptions options;
+    options.games = 40000;
+    options.resultsPath = "sprt.csv";
+    double elo0 = 0.0, elo1 = 10.0, alpha = 0.05, beta = 0.05;
+    string statePath = "sprt.state";
+
+    for (int i = 0; i < argc; i++) {
+        string argument(argv[i]);
+        size_t separator = argument.find('=');
+        if (separator == string::npos) {
+            cout << "Expected key=value, got: " << argument << endl;
+            return 1;
+        }
+        string key = argument.substr(0, separator);
+        string value = argument.substr(separator + 1);
+        if (key == "elo0") {
+            elo0 = atof(value.c_str());
+        } else if (key == "elo1") {
+            elo1 = atof(value.c_str());
+        } else if (key == "alpha") {
+            alpha = atof(value.c_str());
+        } else if (key == "beta") {
+            beta = atof(value.c_str());
+        } else if (key == "state") {
+            statePath = value;
+        } else if (!options.parse(key, value)) {
+            return 1;
+        }
+    }
+
+    vector<Position> openings = options.openings();
+    if (openings.empty()) {
+        cout << "No openings to play" << endl;
+        return 1;
+    }
+
+    Sprt sprt(elo0, elo1, alpha, beta);
+    SprtMatch match(options.engineA, options.engineB, openings, options.games, options.threads,
+                    options.resultsPath, sprt, statePath);
+    match.setArchivePath(options.archivePath);
+    match.setLatencyPath(options.latencyPath);
+    if (!match.resume()) {
+        return 1;
+    }
+    if (match.result() == 0) {
+        match.run();
+    }
+    cout << match.progress() << endl;
+    if (match.result() > 0) {
+        cout << "H1 accepted: A is at least " << elo1 << " Elo stronger" << endl;
+    } else if (match.result() < 0) {
+        cout << "H0 accepted: A is not " << elo1 << " Elo stronger" << endl;
+    } else {
+        cout << "Inconclusive after " << options.games << " games" << endl;
+    }
+    return 0;
+}
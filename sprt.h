@@ -0,0 +1,91 @@
+#ifndef SPRT_H
+#define SPRT_H
+
+#include "tournament.h"
+
+#include <set>
+#include <string>
+
+using namespace std;
+
+/**
+ * Game pair outcomes for engine A: counts[i] holds the pairs where it scored i half points out of 4
+ */
+class PentanomialStatistics {
+public:
+    long long counts[5];
+
+    PentanomialStatistics();
+
+    void add(const GameResult &first, const GameResult &second);
+
+    long long pairs() const;
+};
+
+/**
+ * Sequential probability ratio test of H0: elo = elo0 against H1: elo = elo1,
+ * using the normal approximation of the generalized SPRT on pentanomial pair scores
+ */
+class Sprt {
+public:
+    double elo0;
+    double elo1;
+    double alpha;
+    double beta;
+
+    Sprt(double elo0, double elo1, double alpha, double beta);
+
+    double llr(const PentanomialStatistics &statistics) const;
+
+    double lowerBound() const;
+
+    double upperBound() const;
+
+    /**
+     * -1 accepts H0, 1 accepts H1 and 0 asks for more pairs
+     */
+    int decision(double llr) const;
+
+    string toString() const;
+};
+
+/**
+ * A match that stops as soon as the SPRT is decided, keeping its state in a file so it can be resumed
+ */
+class SprtMatch : public Tournament {
+public:
+    SprtMatch(const EngineConfig &engineA, const EngineConfig &engineB, const vector<Position> &openings,
+              int maxGames, int threads, const string &resultsPath, const Sprt &sprt, const string &statePath);
+
+    /**
+     * Picks up an interrupted match from the state file. Returns false if the file
+     * exists but belongs to a different match.
+     */
+    bool resume();
+
+    int result() const;
+
+    string progress() const;
+
+protected:
+    virtual bool pairFinished(int pair, const GameResult &first, const GameResult &second);
+
+private:
+    Sprt sprt;
+    string statePath;
+    PentanomialStatistics pentanomial;
+    int decision;
+    // Pairs run in parallel and finish out of order: every pair below firstUnfinished is done, and so are
+    // the ones in finishedPairs
+    int firstUnfinished;
+    set<int> finishedPairs;
+
+    void saveState();
+};
+
+/**
+ * Entry point for "server sprt key=value ...", returns the process exit code
+ */
+int runSprt(int argc, char *argv[]);
+
+#endif // SPRT_H
@@ -0,0 +1,169 @@
+#ifndef SQUARE_H
+#define SQUARE_H
+
+#include "boardgeometry.h"
+#include "coordinate.h"
+
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+typedef unsigned long long int ullint;
+
+/**
+ * A square is its row-major index on the board: a1 = 0, b1 = 1, ..., h8 = 63.
+ * The bitboards keep a1 in the most significant bit, so square s maps to bit 63 - s.
+ */
+typedef uint8_t Square;
+
+static const int NO_OF_SQUARES = BOARD_SIZE * BOARD_SIZE;
+
+// Moves that are not squares on the board
+static const Square SQUARE_PASS = 64;
+static const Square SQUARE_NONE = 65;
+
+/**
+ * Directions in the same order as reversi::DIRECTIONS. The first four move
+ * towards lower square indices (higher bits), the last four towards higher ones.
+ */
+static const int SQUARE_DIRECTIONS[8][2] = {
+    {-1, -1}, {-1, 0}, {-1, 1},
+    {0, -1}, {0, 1},
+    {1, -1}, {1, 0}, {1, 1}
+};
+
+struct SquareTables {
+    ullint bit[NO_OF_SQUARES];
+    int8_t row[NO_OF_SQUARES];
+    int8_t column[NO_OF_SQUARES];
+    ullint neighbours[NO_OF_SQUARES];
+    // rays[d][s] holds every square reached from s in direction d, s excluded
+    ullint rays[8][NO_OF_SQUARES];
+};
+
+constexpr SquareTables makeSquareTables() {
+    SquareTables tables = {};
+    for (int s = 0; s < NO_OF_SQUARES; s++) {
+        tables.bit[s] = 1ULL << (NO_OF_SQUARES - 1 - s);
+        tables.row[s] = s / BOARD_SIZE;
+        tables.column[s] = s % BOARD_SIZE;
+    }
+    for (int s = 0; s < NO_OF_SQUARES; s++) {
+        for (int d = 0; d < 8; d++) {
+            int i = s / BOARD_SIZE + SQUARE_DIRECTIONS[d][0];
+            int j = s % BOARD_SIZE + SQUARE_DIRECTIONS[d][1];
+            if (0 <= i && i < BOARD_SIZE && 0 <= j && j < BOARD_SIZE) {
+                tables.neighbours[s] |= tables.bit[i * BOARD_SIZE + j];
+            }
+            while (0 <= i && i < BOARD_SIZE && 0 <= j && j < BOARD_SIZE) {
+                tables.rays[d][s] |= tables.bit[i * BOARD_SIZE + j];
+                i += SQUARE_DIRECTIONS[d][0];
+                j += SQUARE_DIRECTIONS[d][1];
+            }
+        }
+    }
+    return tables;
+}
+
+inline constexpr SquareTables SQUARE_TABLES = makeSquareTables();
+
+inline ullint squareBit(Square square) {
+    return SQUARE_TABLES.bit[square];
+}
+
+inline int squareRow(Square square) {
+    return SQUARE_TABLES.row[square];
+}
+
+inline int squareColumn(Square square) {
+    return SQUARE_TABLES.column[square];
+}
+
+inline ullint squareNeighbours(Square square) {
+    return SQUARE_TABLES.neighbours[square];
+}
+
+inline ullint squareRay(int direction, Square square) {
+    return SQUARE_TABLES.rays[direction][square];
+}
+
+inline Square makeSquare(int row, int column) {
+    return (Square) (row * BOARD_SIZE + column);
+}
+
+inline int popCount(ullint bits) {
+    return __builtin_popcountll(bits);
+}
+
+/**
+ * Lowest square index present in bits, which must not be empty
+ */
+inline Square firstSquare(ullint bits) {
+    return (Square) __builtin_clzll(bits);
+}
+
+/**
+ * Highest square index present in bits, which must not be empty
+ */
+inline Square lastSquare(ullint bits) {
+    return (Square) (NO_OF_SQUARES - 1 - __builtin_ctzll(bits));
+}
+
+/**
+ * Removes the lowest square from bits and returns it. Iterates in row-major order.
+ */
+inline Square popFirstSquare(ullint &bits) {
+    Square square = firstSquare(bits);
+    bits ^= squareBit(square);
+    return square;
+}
+
+// Conversions used at the I/O boundary only
+
+inline Coordinate squareToCoordinate(Square square) {
+    if (square == SQUARE_PASS) {
+        return Coordinate(-2, -2);
+    } else if (square == SQUARE_NONE) {
+        return Coordinate();
+    }
+    return Coordinate(squareRow(square), squareColumn(square));
+}
+
+inline Square coordinateToSquare(const Coordinate &coordinate) {
+    if (coordinate.x == -2 && coordinate.y == -2) {
+        return SQUARE_PASS;
+    } else if (coordinate.m_empty || coordinate.x < 0 || coordinate.y < 0) {
+        return SQUARE_NONE;
+    }
+    return makeSquare(coordinate.x, coordinate.y);
+}
+
+inline string squareToString(Square square) {
+    if (square == SQUARE_PASS) {
+        return string("pass");
+    } else if (square == SQUARE_NONE) {
+        return string("root");
+    }
+    char formatted[2] = {(char) ('a' + squareColumn(square)), (char) ('1' + squareRow(square))};
+    return string(formatted, 2);
+}
+
+/**
+ * Parses "e3" style notation, "pass" and "root". Anything else maps to SQUARE_NONE.
+ */
+inline Square parseSquare(const string &moveString) {
+    if (moveString == "pass") {
+        return SQUARE_PASS;
+    }
+    if (moveString.size() != 2) {
+        return SQUARE_NONE;
+    }
+    int column = moveString[0] - 'a', row = moveString[1] - '1';
+    if (column < 0 || column >= BOARD_SIZE || row < 0 || row >= BOARD_SIZE) {
+        return SQUARE_NONE;
+    }
+    return makeSquare(row, column);
+}
+
+#endif // SQUARE_H
@@ -0,0 +1,404 @@
+#include "tournament.h"
+#include "mctsengine.h"
+#include "reversicompetitionagent.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+GameResult::GameResult(): game(0), opening(0), blackEngine(0), plies(0) {
+    discs[0] = discs[1] = 0;
+    time[0] = time[1] = 0.0;
+}
+
+double GameResult::scoreForEngine(int engine) const {
+    int margin = marginForEngine(engine);
+    if (margin > 0) {
+        return 1.0;
+    } else if (margin < 0) {
+        return 0.0;
+    }
+    return 0.5;
+}
+
+int GameResult::marginForEngine(int engine) const {
+    int color = engine == blackEngine ? ReversiBoard::BLACK : ReversiBoard::WHITE;
+    return discs[color] - discs[1 - color];
+}
+
+MatchStatistics::MatchStatistics(): wins(0), draws(0), losses(0), marginSum(0), marginSquares(0.0) {
+}
+
+void MatchStatistics::add(const GameResult &result) {
+    double score = result.scoreForEngine(0);
+    if (score == 1.0) {
+        wins++;
+    } else if (score == 0.0) {
+        losses++;
+    } else {
+        draws++;
+    }
+    int margin = result.marginForEngine(0);
+    marginSum += margin;
+    marginSquares += (double) margin * margin;
+}
+
+int MatchStatistics::games() const {
+    return wins + draws + losses;
+}
+
+double MatchStatistics::score() const {
+    if (games() == 0) {
+        return 0.5;
+    }
+    return (wins + 0.5 * draws) / games();
+}
+
+double MatchStatistics::averageMargin() const {
+    if (games() == 0) {
+        return 0.0;
+    }
+    return (double) marginSum / games();
+}
+
+double MatchStatistics::scoreToElo(double score) {
+    score = min(max(score, 1e-6), 1.0 - 1e-6);
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+double MatchStatistics::elo() const {
+    return scoreToElo(score());
+}
+
+double MatchStatistics::eloError() const {
+    int n = games();
+    if (n < 2) {
+        return INFINITY;
+    }
+    double s = score();
+    double variance = (wins * (1.0 - s) * (1.0 - s) + draws * (0.5 - s) * (0.5 - s) + losses * s * s) / n;
+    double deviation = 1.96 * sqrt(variance / n);
+    return (scoreToElo(s + deviation) - scoreToElo(s - deviation)) / 2.0;
+}
+
+string MatchStatistics::summary() const {
+    ostringstream ss;
+    ss.setf(ios::fixed);
+    ss.precision(1);
+    ss << "Games " << games() << " W " << wins << " D " << draws << " L " << losses
+       << " Margin " << averageMargin() << " Elo " << elo() << " +/- " << eloError();
+    return ss.str();
+}
+
+Tournament::Tournament(const EngineConfig &engineA, const EngineConfig &engineB, const vector<Position> &openings,
+                       int games, int threads, const string &resultsPath):
+        openings(openings), games(games), threads(max(1, threads)), resultsPath(resultsPath), appendResults(false),
+        nextPair(0), stopped(false) {
+    engines[0] = engineA;
+    engines[1] = engineB;
+}
+
+Tournament::~Tournament() {
+}
+
+void Tournament::setArchivePath(const string &path) {
+    archivePath = path;
+}
+
+void Tournament::setLatencyPath(const string &path) {
+    latencyPath = path;
+}
+
+MatchStatistics Tournament::run() {
+    resultsFile.open(resultsPath.c_str(), appendResults ? ios::app : ios::trunc);
+    if (!resultsFile.is_open()) {
+        cout << "Failed to open results file: " << resultsPath << endl;
+    }
+    if (!appendResults) {
+        resultsFile << "# A: " << engines[0].toString() << endl;
+        resultsFile << "# B: " << engines[1].toString() << endl;
+        resultsFile << "game,opening,black,white,black_discs,white_discs,margin_a,score_a,plies" << endl;
+    }
+    if (!archivePath.empty() && !archive.open(archivePath)) {
+        cout << "Games will not be archived" << endl;
+    }
+    if (!latencyPath.empty() && !latency.load(latencyPath)) {
+        cout << "Move times will not be reported" << endl;
+        latencyPath.clear();
+    }
+
+    vector<thread> workers;
+    for (int i = 0; i < threads; i++) {
+        workers.push_back(thread(&Tournament::worker, this));
+    }
+    for (thread &worker: workers) {
+        worker.join();
+    }
+
+    resultsFile << "# " << statistics.summary() << endl;
+    resultsFile.close();
+    archive.close();
+    if (!latencyPath.empty() && latency.save(latencyPath)) {
+        cout << latency.summary();
+    }
+    cout << statistics.summary() << endl;
+    return statistics;
+}
+
+bool Tournament::pairFinished(int, const GameResult &, const GameResult &) {
+    return true;
+}
+
+void Tournament::worker() {
+    int pairs = (games + 1) / 2;
+    for (int pair = nextPair++; pair < pairs && !stopped; pair = nextPair++) {
+        if (playedPairs.count(pair)) {
+            continue;
+        }
+        const Position &opening = openings[pair % openings.size()];
+        GameResult results[2];
+        int played = 0;
+        // Each opening is played twice with colours swapped
+        for (int swap = 0; swap < 2 && pair * 2 + swap < games; swap++) {
+            int blackEngine = swap;
+            results[swap] = playGame(opening, engines[blackEngine], engines[1 - blackEngine]);
+            results[swap].game = pair * 2 + swap;
+            results[swap].opening = pair % openings.size();
+            results[swap].blackEngine = blackEngine;
+            played++;
+        }
+
+        lock_guard<mutex> lock(resultsMutex);
+        for (int i = 0; i < played; i++) {
+            recordResult(results[i]);
+        }
+        if (played == 2 && !pairFinished(pair, results[0], results[1])) {
+            stopped = true;
+        }
+    }
+}
+
+void Tournament::recordResult(const GameResult &result) {
+    statistics.add(result);
+    resultsFile << result.game << ',' << result.opening << ','
+                << engines[result.blackEngine].name << ',' << engines[1 - result.blackEngine].name << ','
+                << result.discs[ReversiBoard::BLACK] << ',' << result.discs[ReversiBoard::WHITE] << ','
+                << result.marginForEngine(0) << ',' << result.scoreForEngine(0) << ',' << result.plies << endl;
+    if (!archivePath.empty()) {
+        const Position &opening = openings[result.opening];
+        ArchivedGame game;
+        game.start = opening.board;
+        game.startPlayer = opening.player;
+        game.moves = result.moves;
+        game.times = result.moveTimes;
+        game.discs[ReversiBoard::BLACK] = result.discs[ReversiBoard::BLACK];
+        game.discs[ReversiBoard::WHITE] = result.discs[ReversiBoard::WHITE];
+        archive.append(game);
+    }
+    if (!latencyPath.empty()) {
+        recordLatency(result);
+    }
+    if (statistics.games() % 100 == 0) {
+        cout << statistics.summary() << endl;
+        if (!latencyPath.empty()) {
+            latency.save(latencyPath);
+        }
+    }
+}
+
+void Tournament::recordLatency(const GameResult &result) {
+    const Position &opening = openings[result.opening];
+    int empties = NO_OF_SQUARES - popCount(opening.board.pieces[0] | opening.board.pieces[1]);
+    int player = opening.player;
+    for (size_t i = 0; i < result.moves.size(); i++) {
+        if (result.moves[i] != SQUARE_PASS) {
+            const EngineConfig &engine = engines[player == ReversiBoard::BLACK ? result.blackEngine
+                                                                               : 1 - result.blackEngine];
+            latency.record(engine.toString(), empties, result.moveTimes[i],
+                           EngineConfig::moveTime(engine.cpuTime, empties));
+            empties--;
+        }
+        player = 1 - player;
+    }
+}
+
+GameResult Tournament::playGame(const Position &opening, const EngineConfig &black, const EngineConfig &white) {
+    const EngineConfig *configs[2] = {&black, &white};
+    GameResult result;
+    ReversiBoard board = opening.board;
+    int player = opening.player;
+    int passes = 0;
+    // MCTS engines keep their tree from one move to the next, so they live as long as the game
+    unique_ptr<MctsEngine> mcts[2];
+    for (int side = 0; side < 2; side++) {
+        if (configs[side]->algorithm == "mcts") {
+            mcts[side].reset(new MctsEngine(*configs[side]));
+        }
+    }
+
+    while (passes < 2) {
+        ullint moves = board.legalMoves(player);
+        if (!moves) {
+            passes++;
+            player = 1 - player;
+            result.moves.push_back(SQUARE_PASS);
+            result.moveTimes.push_back(0.0);
+            continue;
+        }
+        passes = 0;
+
+        chrono::time_point<chrono::steady_clock> start = chrono::steady_clock::now();
+        Square move;
+        if (mcts[player]) {
+            move = mcts[player]->search(board, player).move;
+        } else {
+            ReversiCompetitionAgent agent(board, player, *configs[player]);
+            move = agent.search().move;
+        }
+        chrono::duration<double> duration = chrono::steady_clock::now() - start;
+        result.time[player] += duration.count();
+        result.moveTimes.push_back(duration.count());
+
+        if (move >= NO_OF_SQUARES || !(moves & squareBit(move))) {
+            // The agent must move when it can
+            move = firstSquare(moves);
+        }
+        board.makeMove(player, move);
+        result.moves.push_back(move);
+        result.plies++;
+        player = 1 - player;
+    }
+    while (!result.moves.empty() && result.moves.back() == SQUARE_PASS) {
+        result.moves.pop_back();
+        result.moveTimes.pop_back();
+    }
+
+    result.discs[ReversiBoard::BLACK] = board.numberOfPieces(ReversiBoard::BLACK);
+    result.discs[ReversiBoard::WHITE] = board.numberOfPieces(ReversiBoard::WHITE);
+    return result;
+}
+
+vector<Position> Tournament::generateOpenings(int plies) {
+    vector<Position> current(1, Position());
+    for (int ply = 0; ply < plies; ply++) {
+        set<pair<pair<ullint, ullint>, int> > seen;
+        vector<Position> next;
+        for (Position &position: current) {
+            ullint moves = position.board.legalMoves(position.player);
+            if (!moves) {
+                // Keep positions where the game ended early, the side to move simply passes
+                next.push_back(Position(position.board, 1 - position.player));
+                continue;
+            }
+            while (moves) {
+                Square move = popFirstSquare(moves);
+                ReversiBoard board = position.board;
+                board.makeMove(position.player, move);
+                if (seen.insert(make_pair(make_pair(board.pieces[0], board.pieces[1]), 1 - position.player)).second) {
+                    next.push_back(Position(board, 1 - position.player));
+                }
+            }
+        }
+        current.swap(next);
+    }
+    // A fixed shuffle so short matches still sample the whole suite
+    shuffle(current.begin(), current.end(), mt19937(0x5eed));
+    return current;
+}
+
+vector<Position> Tournament::loadOpenings(const string &path) {
+    vector<Position> positions;
+    ifstream inputFile(path.c_str());
+    if (!inputFile.is_open()) {
+        cout << "Couldn't open file: " << path << endl;
+        return positions;
+    }
+    string line;
+    while (getline(inputFile, line)) {
+        if (line.empty() || line[0] == '#' || line.find_first_not_of(" \t\r") == string::npos) {
+            continue;
+        }
+        Position position;
+        if (Position::parse(line, position)) {
+            positions.push_back(position);
+        } else {
+            cout << "Skipping invalid opening: " << line << endl;
+        }
+    }
+    return positions;
+}
+
+MatchOptions::MatchOptions(): games(1000), threads(max(1, (int) thread::hardware_concurrency())), plies(4),
+        resultsPath("tournament.csv"), latencyPath(DEFAULT_LATENCY_REPORT) {
+    engineA.name = "A";
+    engineB.name = "B";
+}
+
+bool MatchOptions::parse(const string &key, const string &value) {
+    if (key == "games") {
+        games = atoi(value.c_str());
+    } else if (key == "threads") {
+        threads = atoi(value.c_str());
+    } else if (key == "plies") {
+        plies = atoi(value.c_str());
+    } else if (key == "openings") {
+        openingsPath = value;
+    } else if (key == "results") {
+        resultsPath = value;
+    } else if (key == "archive") {
+        archivePath = value;
+    } else if (key == "latency") {
+        latencyPath = value;
+    } else if (key == "a" || key == "b") {
+        return EngineConfig::parse(value, key == "a" ? engineA : engineB);
+    } else {
+        cout << "Unknown match option: " << key << endl;
+        return false;
+    }
+    return true;
+}
+
+vector<Position> MatchOptions::openings() const {
+    if (openingsPath.empty()) {
+        return Tournament::generateOpenings(plies);
+    }
+    return Tournament::loadOpenings(openingsPath);
+}
+
+int runTournament(int argc, char *argv[]) {
+    MatchOptions options;
+    for (int i = 0; i < argc; i++) {
+        string argument(argv[i]);
+        size_t separator = argument.find('=');
+        if (separator == string::npos) {
+            cout << "Expected key=value, got: " << argument << endl;
+            return 1;
+        }
+        if (!options.parse(argument.substr(0, separator), argument.substr(separator + 1))) {
+            return 1;
+        }
+    }
+
+    vector<Position> openings = options.openings();
+    if (openings.empty()) {
+        cout << "No openings to play" << endl;
+        return 1;
+    }
+    cout << "Playing " << options.games << " games from " << openings.size() << " openings on "
+         << options.threads << " threads" << endl;
+
+    Tournament tournament(options.engineA, options.engineB, openings, options.games, options.threads,
+                          options.resultsPath);
+    tournament.setArchivePath(options.archivePath);
+    tournament.setLatencyPath(options.latencyPath);
+    tournament.run();
+    return 0;
+}
@@ -0,0 +1,188 @@
+#ifndef TOURNAMENT_H
+#define TOURNAMENT_H
+
+#include "engineconfig.h"
+#include "gamearchive.h"
+#include "latencyreport.h"
+#include "position.h"
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class GameResult {
+public:
+    int game;
+    int opening;
+    // Engine that played black: 0 for engine A, 1 for engine B
+    int blackEngine;
+    int discs[2];
+    int plies;
+    double time[2];
+    // Every ply including passes, the passes that end the game are left out
+    vector<Square> moves;
+    vector<double> moveTimes;
+
+    GameResult();
+
+    /**
+     * 1 for a win, 0.5 for a draw and 0 for a loss of the given engine
+     */
+    double scoreForEngine(int engine) const;
+
+    int marginForEngine(int engine) const;
+};
+
+/**
+ * Running W/D/L and disc margin totals, seen from engine A
+ */
+class MatchStatistics {
+public:
+    int wins;
+    int draws;
+    int losses;
+    long long marginSum;
+    double marginSquares;
+
+    MatchStatistics();
+
+    void add(const GameResult &result);
+
+    int games() const;
+
+    double score() const;
+
+    double averageMargin() const;
+
+    /**
+     * Elo difference of engine A over engine B implied by the score
+     */
+    double elo() const;
+
+    /**
+     * Half width of the 95% confidence interval of elo()
+     */
+    double eloError() const;
+
+    string summary() const;
+
+    static double scoreToElo(double score);
+};
+
+/**
+ * Options shared by every self-play match mode
+ */
+class MatchOptions {
+public:
+    EngineConfig engineA;
+    EngineConfig engineB;
+    int games;
+    int threads;
+    int plies;
+    string openingsPath;
+    string resultsPath;
+    // Optional game archive every finished game is appended to
+    string archivePath;
+    // Latency report the move times are added to, none if empty
+    string latencyPath;
+
+    MatchOptions();
+
+    /**
+     * Applies a key=value option, returns false after reporting an unknown key or invalid value
+     */
+    bool parse(const string &key, const string &value);
+
+    /**
+     * The opening file if one was given, generated openings otherwise
+     */
+    vector<Position> openings() const;
+};
+
+class Tournament {
+public:
+    Tournament(const EngineConfig &engineA, const EngineConfig &engineB, const vector<Position> &openings,
+               int games, int threads, const string &resultsPath);
+
+    virtual ~Tournament();
+
+    /**
+     * Plays all games, streaming one line per finished game to the results file
+     */
+    MatchStatistics run();
+
+    /**
+     * Also append every finished game, with its opening as the start position, to a game archive
+     */
+    void setArchivePath(const string &path);
+
+    /**
+     * Also add the time of every move to the latency report in path, kept across matches
+     */
+    void setLatencyPath(const string &path);
+
+    /**
+     * Plays a game from the opening to the end, with both agents invoked in memory
+     */
+    static GameResult playGame(const Position &opening, const EngineConfig &black, const EngineConfig &white);
+
+    /**
+     * Every distinct position reached after the given number of plies from the start position
+     */
+    static vector<Position> generateOpenings(int plies);
+
+    /**
+     * Reads one position per line in the Position::parse format, skipping blank lines and # comments
+     */
+    static vector<Position> loadOpenings(const string &path);
+
+protected:
+    EngineConfig engines[2];
+    vector<Position> openings;
+    int games;
+    int threads;
+    string resultsPath;
+    // Results of an earlier, interrupted run are kept rather than truncated
+    bool appendResults;
+    string archivePath;
+    string latencyPath;
+
+    atomic<int> nextPair;
+    // Pairs from nextPair on that an earlier run already played, the workers pass over them
+    set<int> playedPairs;
+    atomic<bool> stopped;
+    mutex resultsMutex;
+    ofstream resultsFile;
+    GameArchiveWriter archive;
+    MatchStatistics statistics;
+    LatencyReport latency;
+
+    /**
+     * Called with the results lock held once both games of a pair are recorded.
+     * Returning false stops the match once the pairs in flight are done.
+     */
+    virtual bool pairFinished(int pair, const GameResult &first, const GameResult &second);
+
+private:
+    void worker();
+
+    // Expects the results lock to be held
+    void recordResult(const GameResult &result);
+
+    /**
+     * Adds the moves of a game to the latency report, each against its share of the engine's clock
+     */
+    void recordLatency(const GameResult &result);
+};
+
+/**
+ * Entry point for "server tournament key=value ...", returns the process exit code
+ */
+int runTournament(int argc, char *argv[]);
+
+#endif // TOURNAMENT_H
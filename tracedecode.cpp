@@ -0,0 +1,77 @@
+#include "tracewriter.h"
+
+#include <cstdint>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ * Rebuilds the text output of the greedy/minimax/alpha-beta agent from a binary trace:
+ * tracedecode trace.bin [output.txt]
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        cout << "Usage: tracedecode <binary trace> [output file]" << endl;
+        return 1;
+    }
+    string outputPath = argc > 2 ? argv[2] : "output.txt";
+
+    int fd = open(argv[1], O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        cout << "Couldn't open file: " << argv[1] << endl;
+        return 1;
+    }
+    size_t headerSize = sizeof(TraceWriter::MAGIC) + 1;
+    size_t trailerSize = 2 * sizeof(ullint) + sizeof(TraceWriter::TRAILER_MAGIC);
+    size_t size = status.st_size;
+    if (size < headerSize + trailerSize) {
+        cout << "Not a complete trace: " << argv[1] << endl;
+        return 1;
+    }
+    const char *data = (const char *) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        cout << "Couldn't map file: " << argv[1] << endl;
+        return 1;
+    }
+    madvise((void *) data, size, MADV_SEQUENTIAL);
+
+    const char *trailer = data + size - trailerSize;
+    if (memcmp(data, TraceWriter::MAGIC, sizeof(TraceWriter::MAGIC)) != 0
+            || memcmp(trailer + 2 * sizeof(ullint), TraceWriter::TRAILER_MAGIC, sizeof(TraceWriter::TRAILER_MAGIC)) != 0
+            || (size - headerSize - trailerSize) % TraceWriter::RECORD_SIZE != 0) {
+        cout << "Not a complete trace: " << argv[1] << endl;
+        return 1;
+    }
+    int columns = data[sizeof(TraceWriter::MAGIC)];
+    ullint blackPieces, whitePieces;
+    memcpy(&blackPieces, trailer, sizeof(ullint));
+    memcpy(&whitePieces, trailer + sizeof(ullint), sizeof(ullint));
+
+    BufferedWriter out;
+    if (!out.open(outputPath)) {
+        cout << "Failed to write output to: " << outputPath << endl;
+        return 1;
+    }
+    char board[TraceWriter::BOARD_TEXT_SIZE];
+    TraceWriter::formatBoard(blackPieces, whitePieces, board);
+    out.write(board, sizeof(board));
+    if (columns > 0) {
+        TraceWriter::formatHeader(out, columns);
+    }
+    for (const char *record = data + headerSize; record < trailer; record += TraceWriter::RECORD_SIZE) {
+        int16_t depth;
+        int32_t values[3];
+        memcpy(&depth, record + 1, sizeof(depth));
+        memcpy(values, record + 3, sizeof(values));
+        TraceWriter::formatRecord(out, columns, (Square) record[0], depth, values[0], values[1], values[2]);
+    }
+    out.put('\n');
+    munmap((void *) data, size);
+    return out.close() ? 0 : 1;
+}
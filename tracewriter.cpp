@@ -0,0 +1,115 @@
+#include "tracewriter.h"
+#include "reversicommon.h"
+
+#include <cstdint>
+
+using namespace std;
+
+const char TraceWriter::MAGIC[4] = {'R', 'V', 'T', 'R'};
+const char TraceWriter::TRAILER_MAGIC[4] = {'R', 'V', 'T', 'E'};
+
+static const char *HEADERS[5] = {"Node", "Depth", "Value", "Alpha", "Beta"};
+
+TraceWriter::TraceWriter(): columns(0), binary(false) {
+}
+
+bool TraceWriter::open(const string &path, int columns, bool binary) {
+    this->columns = columns;
+    this->binary = binary;
+    if (!writer.open(path)) {
+        return false;
+    }
+    if (binary) {
+        writer.write(MAGIC, sizeof(MAGIC));
+        writer.put((char) columns);
+        return true;
+    }
+    char board[BOARD_TEXT_SIZE];
+    memset(board, ' ', sizeof(board));
+    writer.write(board, sizeof(board));
+    if (columns > 0) {
+        formatHeader(writer, columns);
+    }
+    return true;
+}
+
+bool TraceWriter::close(ullint blackPieces, ullint whitePieces) {
+    if (binary) {
+        char trailer[2 * sizeof(ullint) + sizeof(TRAILER_MAGIC)];
+        memcpy(trailer, &blackPieces, sizeof(ullint));
+        memcpy(trailer + sizeof(ullint), &whitePieces, sizeof(ullint));
+        memcpy(trailer + 2 * sizeof(ullint), TRAILER_MAGIC, sizeof(TRAILER_MAGIC));
+        writer.write(trailer, sizeof(trailer));
+    } else {
+        writer.put('\n');
+        char board[BOARD_TEXT_SIZE];
+        formatBoard(blackPieces, whitePieces, board);
+        writer.writeAt(0, board, sizeof(board));
+    }
+    return writer.close();
+}
+
+void TraceWriter::logBinary(Square move, int depth, int value, int alpha, int beta) {
+    // Host byte order; traces are decoded on the machine that wrote them
+    char record[RECORD_SIZE];
+    int16_t shortDepth = (int16_t) depth;
+    int32_t values[3] = {value, alpha, beta};
+    record[0] = (char) move;
+    memcpy(record + 1, &shortDepth, sizeof(shortDepth));
+    memcpy(record + 3, values, sizeof(values));
+    writer.write(record, sizeof(record));
+}
+
+void TraceWriter::formatBoard(ullint blackPieces, ullint whitePieces, char text[BOARD_TEXT_SIZE]) {
+    char *out = text;
+    for (int i = 0; i < BOARD_SIZE; i++) {
+        for (int j = 0; j < BOARD_SIZE; j++) {
+            ullint bit = squareBit(makeSquare(i, j));
+            *out++ = (blackPieces & bit) ? 'X' : (whitePieces & bit) ? 'O' : '*';
+        }
+        *out++ = '\n';
+    }
+}
+
+void TraceWriter::formatHeader(BufferedWriter &out, int columns) {
+    for (int j = 0; j < columns; j++) {
+        if (j > 0) {
+            out.put(',');
+        }
+        out.write(HEADERS[j], strlen(HEADERS[j]));
+    }
+    out.put('\n');
+}
+
+void TraceWriter::formatValue(BufferedWriter &out, int value) {
+    if (value == reversi::INF_POS) {
+        out.write("Infinity", 8);
+    } else if (value == reversi::INF_NEG) {
+        out.write("-Infinity", 9);
+    } else {
+        out.writeInt(value);
+    }
+}
+
+void TraceWriter::formatRecord(BufferedWriter &out, int columns, Square move, int depth, int value, int alpha,
+                               int beta) {
+    if (depth == 0 || move == SQUARE_NONE) {
+        out.write("root", 4);
+    } else if (move == SQUARE_PASS) {
+        out.write("pass", 4);
+    } else {
+        out.put((char) ('a' + squareColumn(move)));
+        out.put((char) ('1' + squareRow(move)));
+    }
+    out.put(',');
+    out.writeInt(depth);
+    out.put(',');
+    formatValue(out, value);
+    if (columns > 3) {
+        out.put(',');
+        formatValue(out, alpha);
+        out.put(',');
+        formatValue(out, beta);
+    }
+    out.put('\n');
+}
@@ -0,0 +1,66 @@
+#ifndef TRACEWRITER_H
+#define TRACEWRITER_H
+
+#include "bufferedwriter.h"
+#include "square.h"
+
+#include <string>
+
+using namespace std;
+
+/**
+ * Streams the Node,Depth,Value,Alpha,Beta traversal log as the search visits nodes, so memory stays
+ * bounded whatever the size of the tree.
+ *
+ * A text trace is the complete output file: room for the board is reserved at the start and filled
+ * in by close(). A binary trace holds fixed size records followed by the final board, and
+ * tracedecode turns it back into exactly the text output.
+ */
+class TraceWriter {
+public:
+    // Eight rows of eight squares and a newline
+    static const int BOARD_TEXT_SIZE = NO_OF_SQUARES + BOARD_SIZE;
+    static const int RECORD_SIZE = 15;
+    static const char MAGIC[4];
+    static const char TRAILER_MAGIC[4];
+
+    TraceWriter();
+
+    /**
+     * Columns is 3 for MiniMax, 5 for AlphaBeta and 0 when no log is kept
+     */
+    bool open(const string &path, int columns, bool binary);
+
+    void log(Square move, int depth, int value, int alpha, int beta) {
+        if (columns == 0) {
+            return;
+        }
+        if (binary) {
+            logBinary(move, depth, value, alpha, beta);
+        } else {
+            formatRecord(writer, columns, move, depth, value, alpha, beta);
+        }
+    }
+
+    /**
+     * Finishes the trace with the final board, returning false if anything failed to write
+     */
+    bool close(ullint blackPieces, ullint whitePieces);
+
+    static void formatBoard(ullint blackPieces, ullint whitePieces, char text[BOARD_TEXT_SIZE]);
+
+    static void formatHeader(BufferedWriter &out, int columns);
+
+    static void formatRecord(BufferedWriter &out, int columns, Square move, int depth, int value, int alpha, int beta);
+
+private:
+    BufferedWriter writer;
+    int columns;
+    bool binary;
+
+    void logBinary(Square move, int depth, int value, int alpha, int beta);
+
+    static void formatValue(BufferedWriter &out, int value);
+};
+
+#endif // TRACEWRITER_H
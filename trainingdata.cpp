@@ -0,0 +1,144 @@
+#include "trainingdata.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const int HALF_SQUARES = NO_OF_SQUARES / 2;
+static const int HALF_BITS = 51;
+static const int SCORE_SCALE = 8;
+
+TrainingPosition::TrainingPosition(): player(0), opponent(0), score(0.0), result(0) {
+}
+
+TrainingPosition::TrainingPosition(ullint player, ullint opponent, double score, int result):
+        player(player), opponent(opponent), score(score), result(result) {
+}
+
+void trainingdata::writeHeader(uint8_t header[HEADER_SIZE]) {
+    memset(header, 0, HEADER_SIZE);
+    memcpy(header, MAGIC, 4);
+    memcpy(header + 4, &VERSION, sizeof(VERSION));
+    uint32_t recordSize = RECORD_SIZE;
+    memcpy(header + 8, &recordSize, sizeof(recordSize));
+}
+
+bool trainingdata::checkHeader(const uint8_t *header, size_t length) {
+    uint32_t version, recordSize;
+    if (length < HEADER_SIZE || memcmp(header, MAGIC, 4) != 0) {
+        return false;
+    }
+    memcpy(&version, header + 4, sizeof(version));
+    memcpy(&recordSize, header + 8, sizeof(recordSize));
+    return version == VERSION && recordSize == RECORD_SIZE;
+}
+
+static uint64_t encodeHalf(ullint player, ullint opponent, int first) {
+    uint64_t value = 0;
+    for (int square = first + HALF_SQUARES - 1; square >= first; square--) {
+        ullint bit = squareBit(square);
+        value = value * 3 + ((player & bit) ? 1 : (opponent & bit) ? 2 : 0);
+    }
+    return value;
+}
+
+static void decodeHalf(uint64_t value, ullint &player, ullint &opponent, int first) {
+    for (int square = first; square < first + HALF_SQUARES; square++) {
+        int digit = value % 3;
+        value /= 3;
+        if (digit == 1) {
+            player |= squareBit(square);
+        } else if (digit == 2) {
+            opponent |= squareBit(square);
+        }
+    }
+}
+
+void trainingdata::pack(const TrainingPosition &position, uint8_t record[RECORD_SIZE]) {
+    unsigned __int128 board = encodeHalf(position.player, position.opponent, 0);
+    board |= (unsigned __int128) encodeHalf(position.player, position.opponent, HALF_SQUARES) << HALF_BITS;
+    for (int i = 0; i < 13; i++) {
+        record[i] = (uint8_t) (board >> (8 * i));
+    }
+    record[13] = (uint8_t) (int8_t) position.result;
+    double scaled = round(position.score * SCORE_SCALE);
+    int16_t score = (int16_t) max(-32767.0, min(32767.0, isnan(scaled) ? 0.0 : scaled));
+    memcpy(record + 14, &score, sizeof(score));
+}
+
+void trainingdata::unpack(const uint8_t *record, TrainingPosition &position) {
+    unsigned __int128 board = 0;
+    for (int i = 12; i >= 0; i--) {
+        board = (board << 8) | record[i];
+    }
+    const uint64_t halfMask = (1ULL << HALF_BITS) - 1;
+    position.player = position.opponent = 0;
+    decodeHalf((uint64_t) board & halfMask, position.player, position.opponent, 0);
+    decodeHalf((uint64_t) (board >> HALF_BITS) & halfMask, position.player, position.opponent, HALF_SQUARES);
+    position.result = (int8_t) record[13];
+    int16_t score;
+    memcpy(&score, record + 14, sizeof(score));
+    position.score = (double) score / SCORE_SCALE;
+}
+
+TrainingDataReader::TrainingDataReader(): data(NULL), length(0), records(0) {
+}
+
+TrainingDataReader::~TrainingDataReader() {
+    close();
+}
+
+void TrainingDataReader::close() {
+    if (data) {
+        munmap((void *) data, length);
+    }
+    data = NULL;
+    length = 0;
+    records = 0;
+}
+
+bool TrainingDataReader::open(const string &path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        cout << "Couldn't open file: " << path << endl;
+        return false;
+    }
+    length = status.st_size;
+    void *mapped = length > 0 ? mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        length = 0;
+        cout << "Couldn't map file: " << path << endl;
+        return false;
+    }
+    data = (const uint8_t *) mapped;
+    if (!trainingdata::checkHeader(data, length)) {
+        close();
+        cout << "Not a position file: " << path << endl;
+        return false;
+    }
+    // Records are read front to back by every pass of the tuner
+    madvise((void *) data, length, MADV_SEQUENTIAL);
+    records = (length - trainingdata::HEADER_SIZE) / trainingdata::RECORD_SIZE;
+    return true;
+}
+
+long long TrainingDataReader::size() const {
+    return records;
+}
+
+void TrainingDataReader::read(long long index, TrainingPosition &position) const {
+    trainingdata::unpack(data + trainingdata::HEADER_SIZE + index * trainingdata::RECORD_SIZE, position);
+}
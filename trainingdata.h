@@ -0,0 +1,73 @@
+#ifndef TRAININGDATA_H
+#define TRAININGDATA_H
+
+#include "square.h"
+
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+/**
+ * A labelled position seen from the side to move
+ */
+class TrainingPosition {
+public:
+    ullint player;
+    ullint opponent;
+    // Shallow search value of the competition agent
+    double score;
+    // Exact final disc difference, side to move minus opponent
+    int result;
+
+    TrainingPosition();
+    TrainingPosition(ullint player, ullint opponent, double score, int result);
+};
+
+/**
+ * Position files hold a 16 byte header followed by 16 byte records. A record packs the board in
+ * base 3 (0 empty, 1 side to move, 2 opponent) as two 51 bit halves for squares a1-h4 and a5-h8,
+ * stored little endian in the first 13 bytes, then the result as int8 and the score as int16 in
+ * eighths, saturating.
+ */
+namespace trainingdata {
+    static const char MAGIC[4] = {'R', 'V', 'P', 'D'};
+    static const uint32_t VERSION = 1;
+    static const size_t HEADER_SIZE = 16;
+    static const size_t RECORD_SIZE = 16;
+
+    void writeHeader(uint8_t header[HEADER_SIZE]);
+
+    bool checkHeader(const uint8_t *header, size_t length);
+
+    void pack(const TrainingPosition &position, uint8_t record[RECORD_SIZE]);
+
+    void unpack(const uint8_t *record, TrainingPosition &position);
+};
+
+/**
+ * Read-only mmap of a position file, records are decoded on demand
+ */
+class TrainingDataReader {
+public:
+    TrainingDataReader();
+    ~TrainingDataReader();
+
+    bool open(const string &path);
+
+    void close();
+
+    long long size() const;
+
+    void read(long long index, TrainingPosition &position) const;
+
+private:
+    const uint8_t *data;
+    size_t length;
+    long long records;
+
+    TrainingDataReader(const TrainingDataReader &);
+    TrainingDataReader &operator=(const TrainingDataReader &);
+};
+
+#endif // TRAININGDATA_H
@@ -0,0 +1,108 @@
+#include "transpositiontable.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+TranspositionTable::TranspositionTable(size_t size): generation(0), liveGenerations(1) {
+    size_t rounded = 1;
+    while (rounded * 2 <= size) {
+        rounded *= 2;
+    }
+    slots.reset(new Slot[rounded]);
+    mask = rounded - 1;
+    clear();
+}
+
+// splitmix64 finalizer
+static inline ullint mix(ullint x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static inline ullint doubleBits(double value) {
+    ullint bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline ullint packData(int remaining, uint8_t bound, uint8_t generation, Square best) {
+    return (ullint) (uint16_t) remaining | ((ullint) bound << 16) | ((ullint) generation << 24)
+           | ((ullint) (uint8_t) best << 32);
+}
+
+static inline int16_t dataRemaining(ullint data) {
+    return (int16_t) (data & 0xFFFF);
+}
+
+static inline uint8_t dataGeneration(ullint data) {
+    return (uint8_t) (data >> 24);
+}
+
+ullint TranspositionTable::hash(const ReversiBoard &board, int player, Square move, int root) {
+    ullint sides = ((ullint) root << 9) | ((ullint) player << 8) | move;
+    ullint h = mix(board.pieces[ReversiBoard::BLACK] + mix(board.pieces[ReversiBoard::WHITE] + mix(sides)));
+    // 0 marks an empty slot
+    return h ? h : 1;
+}
+
+bool TranspositionTable::probe(ullint key, TranspositionEntry &entry) const {
+    PROFILE_SCOPE(PROFILE_TABLE_PROBE);
+    const Slot &slot = slots[key & mask];
+    ullint value = slot.value.load(memory_order_relaxed);
+    ullint data = slot.data.load(memory_order_relaxed);
+    if ((slot.check.load(memory_order_relaxed) ^ value ^ data) != key) {
+        return false;
+    }
+    entry.key = key;
+    memcpy(&entry.value, &value, sizeof(value));
+    entry.remaining = dataRemaining(data);
+    entry.bound = (uint8_t) (data >> 16);
+    entry.generation = dataGeneration(data);
+    entry.best = (Square) (data >> 32);
+    return true;
+}
+
+void TranspositionTable::store(ullint key, double value, int remaining, uint8_t bound, Square best) {
+    Slot &slot = slots[key & mask];
+    uint8_t current = generation.load(memory_order_relaxed);
+    ullint oldValue = slot.value.load(memory_order_relaxed);
+    ullint oldData = slot.data.load(memory_order_relaxed);
+    ullint oldKey = slot.check.load(memory_order_relaxed) ^ oldValue ^ oldData;
+    uint8_t age = current - dataGeneration(oldData);
+    if (oldKey != key && age < liveGenerations.load(memory_order_relaxed) && dataRemaining(oldData) > remaining) {
+        return;
+    }
+    ullint bits = doubleBits(value);
+    ullint data = packData(remaining, bound, current, best);
+    slot.value.store(bits, memory_order_relaxed);
+    slot.data.store(data, memory_order_relaxed);
+    slot.check.store(key ^ bits ^ data, memory_order_relaxed);
+}
+
+void TranspositionTable::newSearch() {
+    generation.fetch_add(1, memory_order_relaxed);
+}
+
+void TranspositionTable::setConcurrentSearches(int searches) {
+    liveGenerations.store((uint8_t) min(255, max(1, searches)), memory_order_relaxed);
+}
+
+void TranspositionTable::clear() {
+    // An empty slot holds key 0 and remaining -1, so it loses to any real result
+    ullint empty = packData(-1, EXACT, 0, SQUARE_NONE);
+    for (size_t i = 0; i <= mask; i++) {
+        slots[i].value.store(0, memory_order_relaxed);
+        slots[i].data.store(empty, memory_order_relaxed);
+        slots[i].check.store(empty, memory_order_relaxed);
+    }
+}
+
+size_t TranspositionTable::size() const {
+    return mask + 1;
+}
@@ -0,0 +1,97 @@
+#ifndef TRANSPOSITIONTABLE_H
+#define TRANSPOSITIONTABLE_H
+
+#include "reversiboard.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+using namespace std;
+
+class TranspositionEntry {
+public:
+    ullint key;
+    double value;
+    // Plies searched below the position
+    int16_t remaining;
+    uint8_t bound;
+    uint8_t generation;
+    Square best;
+};
+
+/**
+ * Fixed size hash table of search results. Entries are keyed on the position, the side to move and
+ * the move that led to it, because the competition evaluation depends on that last move, and on the
+ * side to move at the root, because values are scored from that side's point of view.
+ *
+ * Searches on different threads may share a table. Slots are written without locks and store the key
+ * xored with the data, so a slot torn by two threads writing at once no longer matches either key and
+ * reads as a miss.
+ */
+class TranspositionTable {
+public:
+    static const uint8_t EXACT = 0;
+    // The value is at least / at most the stored one
+    static const uint8_t LOWER = 1;
+    static const uint8_t UPPER = 2;
+
+    /**
+     * Rounds the number of entries down to a power of two
+     */
+    TranspositionTable(size_t entries = 1 << 18);
+
+    static ullint hash(const ReversiBoard &board, int player, Square move, int root);
+
+    /**
+     * Copies the entry stored for key into entry, returns false if there is none
+     */
+    bool probe(ullint key, TranspositionEntry &entry) const;
+
+    /**
+     * Keeps the entry from the current search with the deepest result, replacing entries of older searches
+     */
+    void store(ullint key, double value, int remaining, uint8_t bound, Square best);
+
+    /**
+     * Starts loading the slot of key into the cache, for a probe of it a little later
+     */
+    void prefetch(ullint key) const {
+        // A slot may straddle two cache lines
+        const char *slot = (const char *) &slots[key & mask];
+        __builtin_prefetch(slot);
+        __builtin_prefetch(slot + sizeof(Slot) - 1);
+    }
+
+    /**
+     * Starts a new search: entries of earlier searches are still probed but replaced first
+     */
+    void newSearch();
+
+    /**
+     * For a table that several searches use at once: entries of the last searches started (1 to 255) are
+     * all kept over shallower ones, not only those of the latest
+     */
+    void setConcurrentSearches(int searches);
+
+    void clear();
+
+    size_t size() const;
+
+private:
+    struct Slot {
+        // key ^ value ^ data
+        atomic<ullint> check;
+        // Bits of the double
+        atomic<ullint> value;
+        // remaining, bound, generation and best, 16 + 8 + 8 + 8 bits
+        atomic<ullint> data;
+    };
+
+    unique_ptr<Slot[]> slots;
+    size_t mask;
+    atomic<uint8_t> generation;
+    atomic<uint8_t> liveGenerations;
+};
+
+#endif // TRANSPOSITIONTABLE_H
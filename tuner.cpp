@@ -0,0 +1,688 @@
+#include "boardfeatures.h"
+#include "engineconfig.h"
+#include "nnue.h"
+#include "trainingdata.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Squares that map onto each other under the 8 symmetries of the board share a weight
+static const int WEIGHT_CLASSES = 10;
+
+struct SymmetryClasses {
+    int classes[NO_OF_SQUARES];
+};
+
+static constexpr SymmetryClasses makeSymmetryClasses() {
+    SymmetryClasses table = {};
+    for (int square = 0; square < NO_OF_SQUARES; square++) {
+        int row = square / BOARD_SIZE, column = square % BOARD_SIZE;
+        row = min(row, BOARD_SIZE - 1 - row);
+        column = min(column, BOARD_SIZE - 1 - column);
+        int low = min(row, column), high = max(row, column);
+        // Index into the triangle low <= high < 4: (0,0) (0,1) .. (0,3) (1,1) .. (3,3)
+        table.classes[square] = low * 4 - low * (low - 1) / 2 + (high - low);
+    }
+    return table;
+}
+
+static constexpr SymmetryClasses SYMMETRY_CLASSES = makeSymmetryClasses();
+
+static const char DEFAULT_NETWORK_PATH[] = "network.nnue";
+// Least squares fits the result in units of a full board, so the weights start out of the right size
+static const double RESULT_SCALE = 64.0;
+// The weights have converged once no weight moves by more than this share of the largest in an epoch,
+// well below the rounding of the written weights
+static const double MIN_CHANGE = 1e-3;
+
+/**
+ * Settings of a tuning run, given as key=value arguments
+ */
+class TunerOptions {
+public:
+    string dataPath;
+    string outputPath;
+    int threads;
+    // 0 picks the model's default: the weights train until they converge, for at most 200 epochs, in batches
+    // of 1024; the network trains for 20 epochs in batches of 16384
+    int epochs;
+    int batchSize;
+    double learningRate;
+    // Least squares on the disc difference, or logistic regression on win/draw/loss
+    bool logistic;
+    // Trains a network for nnue.h instead of the square weights
+    bool network;
+    unsigned int seed;
+
+    TunerOptions(): threads(max(1, (int) thread::hardware_concurrency())), epochs(0), batchSize(0),
+            learningRate(0.01), logistic(false), network(false), seed(1) {
+    }
+
+    bool parse(const string &key, const string &value) {
+        if (key == "data") {
+            dataPath = value;
+        } else if (key == "out") {
+            outputPath = value;
+        } else if (key == "threads") {
+            threads = max(1, atoi(value.c_str()));
+        } else if (key == "epochs") {
+            epochs = max(1, atoi(value.c_str()));
+        } else if (key == "batch") {
+            batchSize = max(1, atoi(value.c_str()));
+        } else if (key == "rate") {
+            learningRate = atof(value.c_str());
+        } else if (key == "loss") {
+            if (value != "lsq" && value != "logistic") {
+                cout << "Unknown loss: " << value << endl;
+                return false;
+            }
+            logistic = value == "logistic";
+        } else if (key == "model") {
+            if (value != "weights" && value != "nnue") {
+                cout << "Unknown model: " << value << endl;
+                return false;
+            }
+            network = value == "nnue";
+        } else if (key == "seed") {
+            seed = strtoul(value.c_str(), NULL, 10);
+        } else {
+            cout << "Unknown tuner option: " << key << endl;
+            return false;
+        }
+        return true;
+    }
+};
+
+/**
+ * Reusable rendezvous point for a fixed number of threads
+ */
+class Barrier {
+public:
+    Barrier(int count): count(count), waiting(0), generation(0) {
+    }
+
+    void wait() {
+        unique_lock<mutex> lock(barrierMutex);
+        long long arrived = generation;
+        if (++waiting == count) {
+            waiting = 0;
+            generation++;
+            released.notify_all();
+            return;
+        }
+        released.wait(lock, [this, arrived] { return generation != arrived; });
+    }
+
+private:
+    mutex barrierMutex;
+    condition_variable released;
+    int count;
+    int waiting;
+    long long generation;
+};
+
+/**
+ * Fits one weight per symmetry class to the labelled positions with mini-batch gradient descent (Adam).
+ * Each batch is split across the worker threads, the main thread sums their gradients and updates.
+ *
+ * The model is the competition agent's evaluation: the weight of the square of the move that led to the
+ * position times the disc, stable disc and mobility ratios of the side to move. Records are written a game
+ * at a time, so the move is the square that the previous record lacks; a position without one, the first of
+ * a game or one after a record dropped as a duplicate, is left out. So is a position after a pass: records
+ * are seen from the side to move, and the move must have been made by the side to move of the previous
+ * record, now the opponent. After a pass the same side is to move in both records, the placed disc is its
+ * own and the result would have the wrong sign.
+ */
+class Tuner {
+public:
+    Tuner(const TunerOptions &options, const TrainingDataReader &reader): options(options), reader(reader),
+            barrier(options.threads + 1), batchStart(0), batchEnd(0), finished(false), hasConverged(false),
+            gradients(options.threads, vector<double>(WEIGHT_CLASSES)), losses(options.threads),
+            counts(options.threads) {
+        weights.assign(WEIGHT_CLASSES, 0.0);
+    }
+
+    void run() {
+        vector<thread> workers;
+        for (int i = 0; i < options.threads; i++) {
+            workers.push_back(thread(&Tuner::worker, this, i));
+        }
+
+        long long batches = (reader.size() + options.batchSize - 1) / options.batchSize;
+        vector<long long> order(batches);
+        iota(order.begin(), order.end(), 0);
+        vector<double> firstMoment(WEIGHT_CLASSES, 0.0), secondMoment(WEIGHT_CLASSES, 0.0);
+        const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+        long long step = 0;
+        double previousLoss = 0.0;
+        // Halved whenever an epoch does not lower the loss, so that the steps shrink around the optimum
+        double rate = options.learningRate;
+
+        for (int epoch = 0; epoch < options.epochs && !hasConverged; epoch++) {
+            // Records are grouped by game, shuffling whole batches keeps reads sequential within a batch
+            shuffle(order.begin(), order.end(), mt19937(options.seed + epoch));
+            double epochLoss = 0.0;
+            long long used = 0;
+            vector<double> startWeights = weights;
+            for (long long batch: order) {
+                batchStart = batch * options.batchSize;
+                batchEnd = min(reader.size(), batchStart + options.batchSize);
+                barrier.wait();
+                barrier.wait();
+
+                long long count = 0;
+                for (int t = 0; t < options.threads; t++) {
+                    epochLoss += losses[t];
+                    count += counts[t];
+                }
+                used += count;
+                if (count == 0) {
+                    continue;
+                }
+                step++;
+                for (int k = 0; k < WEIGHT_CLASSES; k++) {
+                    double gradient = 0.0;
+                    for (int t = 0; t < options.threads; t++) {
+                        gradient += gradients[t][k];
+                    }
+                    gradient /= count;
+                    firstMoment[k] = beta1 * firstMoment[k] + (1.0 - beta1) * gradient;
+                    secondMoment[k] = beta2 * secondMoment[k] + (1.0 - beta2) * gradient * gradient;
+                    double corrected = firstMoment[k] / (1.0 - pow(beta1, step));
+                    double scale = sqrt(secondMoment[k] / (1.0 - pow(beta2, step))) + epsilon;
+                    weights[k] -= rate * corrected / scale;
+                }
+            }
+            if (used == 0) {
+                cout << "No position follows another of its game" << endl;
+                break;
+            }
+            double meanLoss = epochLoss / used;
+            cout << "Epoch " << epoch + 1 << " loss " << meanLoss << " on " << used << " positions" << endl;
+            double change = 0.0, largest = 0.0;
+            for (int k = 0; k < WEIGHT_CLASSES; k++) {
+                change = max(change, fabs(weights[k] - startWeights[k]));
+                largest = max(largest, fabs(weights[k]));
+            }
+            hasConverged = change <= MIN_CHANGE * largest;
+            if (epoch > 0 && meanLoss >= previousLoss) {
+                rate /= 2.0;
+            }
+            previousLoss = meanLoss;
+        }
+
+        finished = true;
+        barrier.wait();
+        for (thread &worker: workers) {
+            worker.join();
+        }
+    }
+
+    /**
+     * Whether the last epoch hardly moved the weights; weights that have not settled are not worth writing
+     */
+    bool converged() const {
+        return hasConverged;
+    }
+
+    bool writeWeights(const string &path) const {
+        double largest = 0.0;
+        for (double weight: weights) {
+            largest = max(largest, fabs(weight));
+        }
+        ofstream outputFile(path.c_str());
+        if (!outputFile.is_open()) {
+            cout << "Couldn't open file: " << path << endl;
+            return false;
+        }
+        // The engine multiplies by these, only their ratios and signs matter, so they are scaled to +/-100
+        double scale = largest > 0.0 ? 100.0 / largest : 0.0;
+        outputFile << "# Fitted by tuner (" << (options.logistic ? "logistic" : "lsq") << ") on " << reader.size()
+                   << " positions from " << options.dataPath << endl;
+        outputFile << "# Unscaled:";
+        for (double weight: weights) {
+            outputFile << ' ' << weight;
+        }
+        outputFile << endl;
+        for (int row = 0; row < BOARD_SIZE; row++) {
+            for (int column = 0; column < BOARD_SIZE; column++) {
+                int weight = (int) lround(weights[SYMMETRY_CLASSES.classes[row * BOARD_SIZE + column]] * scale);
+                outputFile << (column ? " " : "") << weight;
+            }
+            outputFile << endl;
+        }
+        return true;
+    }
+
+private:
+    const TunerOptions &options;
+    const TrainingDataReader &reader;
+    Barrier barrier;
+    long long batchStart;
+    long long batchEnd;
+    bool finished;
+    bool hasConverged;
+    vector<double> weights;
+    vector<vector<double> > gradients;
+    vector<double> losses;
+    // Positions of the batch each thread could use
+    vector<long long> counts;
+
+    void worker(int index) {
+        TrainingPosition position, previous;
+        while (true) {
+            barrier.wait();
+            if (finished) {
+                return;
+            }
+            long long size = batchEnd - batchStart;
+            long long first = batchStart + size * index / options.threads;
+            long long last = batchStart + size * (index + 1) / options.threads;
+            vector<double> &gradient = gradients[index];
+            fill(gradient.begin(), gradient.end(), 0.0);
+            double loss = 0.0;
+            long long count = 0;
+
+            if (first > 0 && first < last) {
+                reader.read(first - 1, previous);
+            }
+            for (long long i = first; i < last; i++, previous = position) {
+                reader.read(i, position);
+                ullint occupied = position.player | position.opponent;
+                ullint previousOccupied = previous.player | previous.opponent;
+                ullint placed = occupied & ~previousOccupied;
+                if (i == 0 || (previousOccupied & ~occupied) || popCount(placed) != 1) {
+                    continue;
+                }
+                // The mover keeps its discs and owns the new one, otherwise the other side passed in between
+                if (!(placed & position.opponent) || (previous.player & ~position.opponent)) {
+                    continue;
+                }
+                int weightClass = SYMMETRY_CLASSES.classes[firstSquare(placed)];
+                ReversiBoard board(position.player, position.opponent);
+                double ratios = features::competitionEvaluation(board, ReversiBoard::BLACK,
+                                                                board.legalMoves(ReversiBoard::BLACK), 1.0);
+                double prediction = weights[weightClass] * ratios;
+                // The search takes the evaluation as good for whoever made the last move
+                int result = -position.result;
+                count++;
+
+                double error;
+                if (options.logistic) {
+                    double target = result > 0 ? 1.0 : result < 0 ? 0.0 : 0.5;
+                    double probability = 1.0 / (1.0 + exp(-prediction));
+                    error = probability - target;
+                    probability = min(max(probability, 1e-12), 1.0 - 1e-12);
+                    loss -= target * log(probability) + (1.0 - target) * log(1.0 - probability);
+                } else {
+                    error = prediction - result / RESULT_SCALE;
+                    loss += error * error;
+                    error *= 2.0;
+                }
+                gradient[weightClass] += error * ratios;
+            }
+            losses[index] = loss;
+            counts[index] = count;
+            barrier.wait();
+        }
+    }
+};
+
+/**
+ * Trains the network of nnue.h in floating point on the exact results, with the clipped activations and
+ * weight ranges of its quantised form so that rounding costs little. Batches are split across the worker
+ * threads as in Tuner. Each position is seen under a different one of the 8 symmetries every epoch.
+ */
+class NetworkTuner {
+public:
+    NetworkTuner(const TunerOptions &options, const TrainingDataReader &reader): options(options), reader(reader),
+            barrier(options.threads + 1), batchStart(0), batchEnd(0), epoch(0), finished(false),
+            gradients(options.threads, vector<float>(PARAMETERS)), losses(options.threads) {
+        parameters.assign(PARAMETERS, 0.0f);
+        mt19937 random(options.seed);
+        initialise(random, FEATURE_WEIGHTS, nnue::INPUTS * nnue::ACCUMULATOR, 0.05);
+        fill(&parameters[FEATURE_BIASES], &parameters[FEATURE_BIASES] + nnue::ACCUMULATOR, 0.5f);
+        initialise(random, HIDDEN1_WEIGHTS, nnue::HIDDEN1 * 2 * nnue::ACCUMULATOR, 1.0 / sqrt(2.0 * nnue::ACCUMULATOR));
+        fill(&parameters[HIDDEN1_BIASES], &parameters[HIDDEN1_BIASES] + nnue::HIDDEN1, 0.5f);
+        initialise(random, HIDDEN2_WEIGHTS, nnue::HIDDEN2 * nnue::HIDDEN1, 1.0 / sqrt((double) nnue::HIDDEN1));
+        fill(&parameters[HIDDEN2_BIASES], &parameters[HIDDEN2_BIASES] + nnue::HIDDEN2, 0.5f);
+        initialise(random, OUTPUT_WEIGHTS, nnue::HIDDEN2, 1.0 / sqrt((double) nnue::HIDDEN2));
+    }
+
+    void run() {
+        vector<thread> workers;
+        for (int i = 0; i < options.threads; i++) {
+            workers.push_back(thread(&NetworkTuner::worker, this, i));
+        }
+
+        long long batches = (reader.size() + options.batchSize - 1) / options.batchSize;
+        vector<long long> order(batches);
+        iota(order.begin(), order.end(), 0);
+        vector<double> firstMoment(PARAMETERS, 0.0), secondMoment(PARAMETERS, 0.0);
+        const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+        long long step = 0;
+
+        for (epoch = 0; epoch < options.epochs; epoch++) {
+            shuffle(order.begin(), order.end(), mt19937(options.seed + epoch));
+            double epochLoss = 0.0;
+            for (long long batch: order) {
+                batchStart = batch * options.batchSize;
+                batchEnd = min(reader.size(), batchStart + options.batchSize);
+                barrier.wait();
+                barrier.wait();
+
+                step++;
+                double count = (double) (batchEnd - batchStart);
+                double firstCorrection = 1.0 - pow(beta1, step), secondCorrection = 1.0 - pow(beta2, step);
+                for (int k = 0; k < PARAMETERS; k++) {
+                    double gradient = 0.0;
+                    for (int t = 0; t < options.threads; t++) {
+                        gradient += gradients[t][k];
+                    }
+                    gradient /= count;
+                    firstMoment[k] = beta1 * firstMoment[k] + (1.0 - beta1) * gradient;
+                    secondMoment[k] = beta2 * secondMoment[k] + (1.0 - beta2) * gradient * gradient;
+                    double scale = sqrt(secondMoment[k] / secondCorrection) + epsilon;
+                    parameters[k] -= (float) (options.learningRate * firstMoment[k] / firstCorrection / scale);
+                }
+                clampWeights();
+                for (int t = 0; t < options.threads; t++) {
+                    epochLoss += losses[t];
+                }
+            }
+            double meanLoss = epochLoss / reader.size();
+            cout << "Epoch " << epoch + 1 << " loss " << meanLoss << " (rms error "
+                 << sqrt(meanLoss) * nnue::OUTPUT_SCALE << " discs)" << endl;
+        }
+
+        finished = true;
+        barrier.wait();
+        for (thread &worker: workers) {
+            worker.join();
+        }
+    }
+
+    bool writeNetwork(const string &path) const {
+        unique_ptr<NnueNetwork> network(new NnueNetwork());
+        const double activation = nnue::ACTIVATION_ONE, weight = nnue::WEIGHT_ONE;
+        for (int f = 0; f < nnue::INPUTS; f++) {
+            for (int i = 0; i < nnue::ACCUMULATOR; i++) {
+                network->featureWeights[f][i] = (int16_t) lround(featureWeight(f, i) * activation);
+            }
+        }
+        for (int i = 0; i < nnue::ACCUMULATOR; i++) {
+            network->featureBiases[i] = (int16_t) lround(parameters[FEATURE_BIASES + i] * activation);
+        }
+        for (int j = 0; j < nnue::HIDDEN1; j++) {
+            for (int i = 0; i < 2 * nnue::ACCUMULATOR; i++) {
+                network->hidden1Weights[j][i] = quantised(parameters[HIDDEN1_WEIGHTS + j * 2 * nnue::ACCUMULATOR + i]);
+            }
+            network->hidden1Biases[j] = (int32_t) lround(parameters[HIDDEN1_BIASES + j] * activation * weight);
+        }
+        for (int j = 0; j < nnue::HIDDEN2; j++) {
+            for (int i = 0; i < nnue::HIDDEN1; i++) {
+                network->hidden2Weights[j][i] = quantised(parameters[HIDDEN2_WEIGHTS + j * nnue::HIDDEN1 + i]);
+            }
+            network->hidden2Biases[j] = (int32_t) lround(parameters[HIDDEN2_BIASES + j] * activation * weight);
+        }
+        for (int i = 0; i < nnue::HIDDEN2; i++) {
+            network->outputWeights[i] = quantised(parameters[OUTPUT_WEIGHTS + i]);
+        }
+        network->outputBias = (int32_t) lround(parameters[OUTPUT_BIAS] * activation * weight);
+        return network->write(path);
+    }
+
+private:
+    // Offsets of each layer in the flat parameter vector, laid out as in NnueNetwork
+    static const int FEATURE_WEIGHTS = 0;
+    static const int FEATURE_BIASES = FEATURE_WEIGHTS + nnue::INPUTS * nnue::ACCUMULATOR;
+    static const int HIDDEN1_WEIGHTS = FEATURE_BIASES + nnue::ACCUMULATOR;
+    static const int HIDDEN1_BIASES = HIDDEN1_WEIGHTS + nnue::HIDDEN1 * 2 * nnue::ACCUMULATOR;
+    static const int HIDDEN2_WEIGHTS = HIDDEN1_BIASES + nnue::HIDDEN1;
+    static const int HIDDEN2_BIASES = HIDDEN2_WEIGHTS + nnue::HIDDEN2 * nnue::HIDDEN1;
+    static const int OUTPUT_WEIGHTS = HIDDEN2_BIASES + nnue::HIDDEN2;
+    static const int OUTPUT_BIAS = OUTPUT_WEIGHTS + nnue::HIDDEN2;
+    static const int PARAMETERS = OUTPUT_BIAS + 1;
+
+    // A full board of the largest first layer weights must still fit the int16 accumulator
+    static constexpr float MAX_FEATURE_WEIGHT = 32767.0f / nnue::ACTIVATION_ONE / (NO_OF_SQUARES + 1);
+    static constexpr float MAX_DENSE_WEIGHT = 127.0f / nnue::WEIGHT_ONE;
+
+    const TunerOptions &options;
+    const TrainingDataReader &reader;
+    Barrier barrier;
+    long long batchStart;
+    long long batchEnd;
+    int epoch;
+    bool finished;
+    vector<float> parameters;
+    vector<vector<float> > gradients;
+    vector<double> losses;
+
+    void initialise(mt19937 &random, int offset, int count, double deviation) {
+        normal_distribution<double> distribution(0.0, deviation);
+        for (int i = 0; i < count; i++) {
+            parameters[offset + i] = (float) distribution(random);
+        }
+    }
+
+    float featureWeight(int feature, int index) const {
+        return parameters[FEATURE_WEIGHTS + feature * nnue::ACCUMULATOR + index];
+    }
+
+    static int8_t quantised(float weight) {
+        return (int8_t) max(-127L, min(127L, lround(weight * nnue::WEIGHT_ONE)));
+    }
+
+    void clampWeights() {
+        for (int k = FEATURE_WEIGHTS; k < HIDDEN1_WEIGHTS; k++) {
+            parameters[k] = max(-MAX_FEATURE_WEIGHT, min(MAX_FEATURE_WEIGHT, parameters[k]));
+        }
+        for (int k = HIDDEN1_WEIGHTS; k < OUTPUT_BIAS; k++) {
+            if (k < HIDDEN1_BIASES || (k >= HIDDEN2_WEIGHTS && k < HIDDEN2_BIASES) || k >= OUTPUT_WEIGHTS) {
+                parameters[k] = max(-MAX_DENSE_WEIGHT, min(MAX_DENSE_WEIGHT, parameters[k]));
+            }
+        }
+    }
+
+    static float clip(float value) {
+        return min(1.0f, max(0.0f, value));
+    }
+
+    // Derivative of clip, taken as 0 at the bends
+    static float passes(float value) {
+        return value > 0.0f && value < 1.0f ? 1.0f : 0.0f;
+    }
+
+    void worker(int index) {
+        TrainingPosition position;
+        const int A = nnue::ACCUMULATOR, H1 = nnue::HIDDEN1, H2 = nnue::HIDDEN2;
+        // Active features of the side to move's accumulator and of the other side's
+        vector<int> active[2];
+        float accumulators[2 * A], input[2 * A], sums1[H1], hidden1[H1], sums2[H2], hidden2[H2];
+        float inputGradient[2 * A], hidden1Gradient[H1], hidden2Gradient[H2];
+        while (true) {
+            barrier.wait();
+            if (finished) {
+                return;
+            }
+            long long size = batchEnd - batchStart;
+            long long first = batchStart + size * index / options.threads;
+            long long last = batchStart + size * (index + 1) / options.threads;
+            vector<float> &gradient = gradients[index];
+            fill(gradient.begin(), gradient.end(), 0.0f);
+            double loss = 0.0;
+
+            for (long long i = first; i < last; i++) {
+                reader.read(i, position);
+                int transform = (int) ((i + epoch) % ReversiBoard::SYMMETRIES);
+                ullint discs[2] = {ReversiBoard::transformPieces(position.player, transform),
+                                   ReversiBoard::transformPieces(position.opponent, transform)};
+                for (int side = 0; side < 2; side++) {
+                    active[side].clear();
+                    for (int colour = 0; colour < 2; colour++) {
+                        ullint pieces = discs[colour];
+                        while (pieces) {
+                            active[side].push_back(nnue::feature(side, colour, popFirstSquare(pieces)));
+                        }
+                    }
+                }
+
+                // Forward
+                for (int side = 0; side < 2; side++) {
+                    float *values = accumulators + side * A;
+                    copy(&parameters[FEATURE_BIASES], &parameters[FEATURE_BIASES] + A, values);
+                    for (int feature: active[side]) {
+                        const float *weights = &parameters[FEATURE_WEIGHTS + feature * A];
+                        for (int k = 0; k < A; k++) {
+                            values[k] += weights[k];
+                        }
+                    }
+                }
+                for (int k = 0; k < 2 * A; k++) {
+                    input[k] = clip(accumulators[k]);
+                }
+                for (int j = 0; j < H1; j++) {
+                    const float *weights = &parameters[HIDDEN1_WEIGHTS + j * 2 * A];
+                    float sum = parameters[HIDDEN1_BIASES + j];
+                    for (int k = 0; k < 2 * A; k++) {
+                        sum += weights[k] * input[k];
+                    }
+                    sums1[j] = sum;
+                    hidden1[j] = clip(sum);
+                }
+                for (int j = 0; j < H2; j++) {
+                    const float *weights = &parameters[HIDDEN2_WEIGHTS + j * H1];
+                    float sum = parameters[HIDDEN2_BIASES + j];
+                    for (int k = 0; k < H1; k++) {
+                        sum += weights[k] * hidden1[k];
+                    }
+                    sums2[j] = sum;
+                    hidden2[j] = clip(sum);
+                }
+                float output = parameters[OUTPUT_BIAS];
+                for (int k = 0; k < H2; k++) {
+                    output += parameters[OUTPUT_WEIGHTS + k] * hidden2[k];
+                }
+
+                float error = output - (float) (position.result / nnue::OUTPUT_SCALE);
+                loss += error * error;
+                float outputGradient = 2.0f * error;
+
+                // Backward
+                gradient[OUTPUT_BIAS] += outputGradient;
+                for (int k = 0; k < H2; k++) {
+                    gradient[OUTPUT_WEIGHTS + k] += outputGradient * hidden2[k];
+                    hidden2Gradient[k] = outputGradient * parameters[OUTPUT_WEIGHTS + k] * passes(sums2[k]);
+                }
+                fill(hidden1Gradient, hidden1Gradient + H1, 0.0f);
+                for (int j = 0; j < H2; j++) {
+                    if (hidden2Gradient[j] == 0.0f) {
+                        continue;
+                    }
+                    gradient[HIDDEN2_BIASES + j] += hidden2Gradient[j];
+                    float *weightGradient = &gradient[HIDDEN2_WEIGHTS + j * H1];
+                    const float *weights = &parameters[HIDDEN2_WEIGHTS + j * H1];
+                    for (int k = 0; k < H1; k++) {
+                        weightGradient[k] += hidden2Gradient[j] * hidden1[k];
+                        hidden1Gradient[k] += hidden2Gradient[j] * weights[k];
+                    }
+                }
+                fill(inputGradient, inputGradient + 2 * A, 0.0f);
+                for (int j = 0; j < H1; j++) {
+                    float upstream = hidden1Gradient[j] * passes(sums1[j]);
+                    if (upstream == 0.0f) {
+                        continue;
+                    }
+                    gradient[HIDDEN1_BIASES + j] += upstream;
+                    float *weightGradient = &gradient[HIDDEN1_WEIGHTS + j * 2 * A];
+                    const float *weights = &parameters[HIDDEN1_WEIGHTS + j * 2 * A];
+                    for (int k = 0; k < 2 * A; k++) {
+                        weightGradient[k] += upstream * input[k];
+                        inputGradient[k] += upstream * weights[k];
+                    }
+                }
+                for (int k = 0; k < 2 * A; k++) {
+                    inputGradient[k] *= passes(accumulators[k]);
+                }
+                for (int side = 0; side < 2; side++) {
+                    const float *upstream = inputGradient + side * A;
+                    for (int k = 0; k < A; k++) {
+                        gradient[FEATURE_BIASES + k] += upstream[k];
+                    }
+                    for (int feature: active[side]) {
+                        float *weightGradient = &gradient[FEATURE_WEIGHTS + feature * A];
+                        for (int k = 0; k < A; k++) {
+                            weightGradient[k] += upstream[k];
+                        }
+                    }
+                }
+            }
+            losses[index] = loss;
+            barrier.wait();
+        }
+    }
+};
+
+int main(int argc, char *argv[]) {
+    TunerOptions options;
+    for (int i = 1; i < argc; i++) {
+        string argument(argv[i]);
+        size_t separator = argument.find('=');
+        if (separator == string::npos
+                || !options.parse(argument.substr(0, separator), argument.substr(separator + 1))) {
+            cout << "Usage: tuner data=positions.bin [model=weights|nnue] [out=weights.txt|network.nnue]"
+                 << " [loss=lsq|logistic] [epochs=200|20] [batch=1024|16384] [rate=0.01] [threads=N] [seed=1]"
+                 << endl;
+            return 1;
+        }
+    }
+    if (options.dataPath.empty()) {
+        cout << "No position file given, use data=<file>" << endl;
+        return 1;
+    }
+
+    TrainingDataReader reader;
+    if (!reader.open(options.dataPath)) {
+        return 1;
+    }
+    if (reader.size() == 0) {
+        cout << "No positions in " << options.dataPath << endl;
+        return 1;
+    }
+    if (options.outputPath.empty()) {
+        options.outputPath = options.network ? DEFAULT_NETWORK_PATH : DEFAULT_WEIGHTS_PATH;
+    }
+    if (options.epochs == 0) {
+        options.epochs = options.network ? 20 : 200;
+    }
+    if (options.batchSize == 0) {
+        options.batchSize = options.network ? 16384 : 1024;
+    }
+    cout << "Tuning on " << reader.size() << " positions with " << options.threads << " threads" << endl;
+    if (options.network) {
+        NetworkTuner tuner(options, reader);
+        tuner.run();
+        return tuner.writeNetwork(options.outputPath) ? 0 : 1;
+    }
+    Tuner tuner(options, reader);
+    tuner.run();
+    if (!tuner.converged()) {
+        // The engine loads weights.txt on its own, half fitted weights must not end up there
+        cout << "The weights did not converge in " << options.epochs << " epochs, nothing written."
+             << " Try more epochs or a higher rate." << endl;
+        return 1;
+    }
+    return tuner.writeWeights(options.outputPath) ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+#include "sizedboard.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+/**
+ * Settings of a variant solve, given as key=value arguments
+ */
+class VariantOptions {
+public:
+    int size;
+    // Empty means the start position of the chosen size
+    string board;
+    int player;
+    // log2 of the transposition table entries
+    int tableBits;
+    // Also play out and print the whole line of perfect play
+    bool line;
+
+    VariantOptions(): size(6), player(0), tableBits(22), line(false) {
+    }
+
+    bool parse(const string &key, const string &value) {
+        if (key == "size") {
+            size = atoi(value.c_str());
+        } else if (key == "board") {
+            board = value;
+        } else if (key == "side") {
+            if (value != "X" && value != "O") {
+                cout << "Side must be X or O: " << value << endl;
+                return false;
+            }
+            player = value == "X" ? 0 : 1;
+        } else if (key == "table") {
+            tableBits = atoi(value.c_str());
+        } else if (key == "line") {
+            line = value == "1";
+        } else {
+            cout << "Unknown variant option: " << key << endl;
+            return false;
+        }
+        return true;
+    }
+};
+
+template <int N>
+int solveVariant(const VariantOptions &options) {
+    typedef SizedBoard<N> Board;
+    Board board;
+    if (!options.board.empty() && !Board::parse(options.board, board)) {
+        cout << "Board must have " << N * N << " squares of X, O and * or -" << endl;
+        return 1;
+    }
+    int player = options.player;
+    SizedEndgameSolver<N> solver((size_t) 1 << options.tableBits);
+
+    chrono::time_point<chrono::steady_clock> start = chrono::steady_clock::now();
+    int value;
+    int move = solver.bestMove(board, player, value);
+    chrono::duration<double> duration = chrono::steady_clock::now() - start;
+    cout << board.toString();
+    cout << "Side\t" << (player == Board::BLACK ? 'X' : 'O') << endl;
+    cout << "Value\t" << value << endl;
+    cout << "Move\t" << Board::squareName(move) << endl;
+    cout << "Nodes\t" << solver.nodes() << endl;
+    cout << "Seconds\t" << duration.count() << endl;
+
+    if (options.line) {
+        // Each later position is a subtree of the first solve, the table answers most of it
+        cout << "Line\t";
+        while (true) {
+            if (move == Board::PASS) {
+                if (!board.legalMoves(1 - player)) {
+                    break;
+                }
+            } else {
+                board.makeMove(player, move);
+            }
+            cout << Board::squareName(move) << ' ';
+            player = 1 - player;
+            move = solver.bestMove(board, player, value);
+        }
+        cout << endl << "Final\t" << board.numberOfPieces(Board::BLACK) << '-'
+             << board.numberOfPieces(Board::WHITE) << endl;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    VariantOptions options;
+    for (int i = 1; i < argc; i++) {
+        string argument(argv[i]);
+        size_t separator = argument.find('=');
+        if (separator == string::npos
+                || !options.parse(argument.substr(0, separator), argument.substr(separator + 1))) {
+            cout << "Usage: variant [size=4|6|8|10] [board=<size*size squares>] [side=X|O] [table=22] [line=1]"
+                 << endl;
+            return 1;
+        }
+    }
+    switch (options.size) {
+        case 4:
+            return solveVariant<4>(options);
+        case 6:
+            return solveVariant<6>(options);
+        case 8:
+            return solveVariant<8>(options);
+        case 10:
+            return solveVariant<10>(options);
+        default:
+            cout << "Board sizes are 4, 6, 8 and 10" << endl;
+            return 1;
+    }
+}